@@ -0,0 +1,224 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <streambuf>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+#include <cstring>
+#include <StringPool.h>
+
+/**
+ * Calculates the CRC-32 (IEEE 802.3) checksum of a memory block. Archives and journal entries end with it.
+ */
+uint32_t archiveChecksum(const void* data, size_t size);
+
+/**
+ * Collects the content of a binary archive in memory, so that the archive can be written to disk
+ * with a single write call. All values are stored with their native (x86) representation.
+ */
+class ArchiveWriter {
+public:
+
+	template<class T>
+	void write(const T& value) {
+		write(&value, sizeof(T));
+	}
+
+	void write(const void* data, size_t size) {
+		if (mBuffer.size() - mSize < size) grow(size);
+		std::memcpy(mBuffer.data() + mSize, data, size);
+		mSize += size;
+	}
+
+	/**
+	 * Writes a string as a 32-bit length followed by the characters (without null terminator).
+	 */
+	void writeString(const std::string& str);
+
+	/**
+	 * Appends the content of another writer.
+	 */
+	void append(const ArchiveWriter& other);
+
+	/**
+	 * Makes room for 'size' bytes in total, so that the following writes don't reallocate.
+	 */
+	void reserve(size_t size);
+
+	const char* getData() const;
+	size_t getSize() const;
+
+private:
+
+	/**
+	 * Enlarges the buffer so that 'size' more bytes fit in.
+	 */
+	void grow(size_t size);
+
+	// the buffer is only resized when it is full; mSize is the number of bytes written
+	std::vector<char> mBuffer;
+	size_t mSize = 0;
+};
+
+/**
+ * Reads values from an archive loaded into memory. Reading beyond the end of the archive throws a std::runtime_error.
+ */
+class ArchiveReader {
+public:
+
+	ArchiveReader(const char* begin, const char* end);
+
+	template<class T>
+	void read(T& value) {
+		read(&value, sizeof(T));
+	}
+
+	void read(void* dest, size_t size);
+
+	/**
+	 * Reads a string written by ArchiveWriter::writeString
+	 */
+	void readString(std::string& str);
+
+	/**
+	 * Checks that at least 'size' bytes are left.
+	 */
+	void require(size_t size) const;
+
+	/**
+	 * Checks that at least 'count' values of type T are left. Unlike require(count * sizeof(T)), the check
+	 * can't overflow for counts read from the archive.
+	 */
+	template<class T>
+	void requireCount(size_t count) const {
+		requireCount(count, sizeof(T));
+	}
+
+	void requireCount(size_t count, size_t elementSize) const;
+
+	void skip(size_t size);
+
+	/**
+	 * \return The current read position.
+	 */
+	const char* getPosition() const;
+
+	size_t getRemaining() const;
+
+private:
+	const char* mCurrent;
+	const char* mEnd;
+};
+
+/**
+ * Collects the distinct strings of an archive and maps them to dense indices.
+ * Pool handles are mapped directly, so every distinct handle is hashed only once.
+ */
+class ArchiveStringTable {
+public:
+
+	static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+	uint32_t add(StringPool::Handle handle);
+	uint32_t add(const std::string& str);
+
+	/**
+	 * Adds a string without looking it up. For strings occurring only once, like the symbol names of the
+	 * instances, this saves hashing and copying them. The table refers to the string, so it has to outlive the table.
+	 */
+	uint32_t addUnique(const std::string& str);
+
+	/**
+	 * Makes room for 'count' distinct strings.
+	 */
+	void reserve(size_t count);
+
+	void write(ArchiveWriter& writer) const;
+
+	size_t getSize() const;
+
+	/**
+	 * \return The number of bytes write() writes.
+	 */
+	size_t getByteSize() const;
+
+	/**
+	 * Reads a string table written by write() and interns its strings. The result maps
+	 * archive string indices to pool handles.
+	 */
+	static void read(ArchiveReader& reader, uint32_t count, std::vector<StringPool::Handle>& handles);
+
+private:
+	std::unordered_map<std::string, uint32_t> mIndices;
+	std::vector<const std::string*> mStrings;
+	std::vector<uint32_t> mHandleIndices;
+	size_t mByteSize = 0;
+};
+
+/**
+ * Reads and writes the values of stream based archives (version 1.1). Strings are stored as their
+ * 32-bit length (the size_t of the game) followed by the characters.
+ */
+class StreamArchive {
+public:
+
+	template<class T>
+	static void readValue(std::istream& is, T& value) {
+		is.read(reinterpret_cast<char*>(&value), sizeof(T));
+	}
+
+	template<class T>
+	static void writeValue(std::ostream& os, const T& value) {
+		os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	/**
+	 * Reads a string written by writeString. Trailing spaces are removed.
+	 */
+	static void readString(std::istream& is, std::string& str);
+
+	/**
+	 * Writes a string up to its first null character.
+	 */
+	static void writeString(std::ostream& os, const std::string& str);
+};
+
+/**
+ * A read-only std::streambuf over a memory block. Used to read archives of older versions,
+ * which are parsed by stream based deserializers, without copying the loaded file content.
+ */
+class MemoryStreamBuffer : public std::streambuf {
+public:
+	MemoryStreamBuffer(const char* begin, const char* end);
+};
@@ -44,6 +44,44 @@ public:
 	static bool getLogToFile();
 	static bool getLogTozSpy();
 	static bool getLogToConsole();
+
+	/**
+	 * \return Should the log file be written in the binary format (see LogFormat)? It is decoded by the LogDecoder tool.
+	 */
+	static bool getLogBinary();
+
+	/**
+	 * \return When log file messages are committed to disk: "never", "batch" or "fatal" (see LogWriter::FlushPolicy).
+	 */
+	static const std::string& getLogFileFlush();
+
+	/**
+	 * \return The number of messages per second a single logging call site may log on average (see LogLimiter).
+	 * 0 disables the rate limit.
+	 */
+	static double getLogRateLimit();
+
+	/**
+	 * \return The number of messages a single logging call site may log at once, before the rate limit applies.
+	 */
+	static double getLogRateBurst();
+
+	/**
+	 * \return Should repeats of the previous message be folded into a "last message repeated N times" message?
+	 */
+	static bool getLogFoldRepeats();
+
+	/**
+	 * \return The size (in bytes) the DII savegame journal may reach before the DII archive is rewritten.
+	 */
+	static size_t getDIIJournalCompactionSize();
+
+	/**
+	 * \return Comma separated names of the static item instances whose initialization script result may be cached,
+	 * so that items of them are initialized without running the script again. Only instances whose script
+	 * has no side effects (apart from setting the item's fields) should be listed. The cache is disabled if empty.
+	 */
+	static const std::string& getDIIInitCacheInstances();
 private:
 
 	struct _Config
@@ -56,7 +94,14 @@ private:
 		bool logToConsole = false;
 		bool logToZSpy = false;
 		bool logToFile = true;
+		std::string logFileFlush = "batch";
+		bool logBinary = false;
+		double logRateLimit = 0;
+		double logRateBurst = 50;
+		bool logFoldRepeats = false;
 		bool debugEnabled = false;
+		size_t diiJournalCompactionSize = 512 * 1024;
+		std::string diiInitCacheInstances;
 	};
 
 	static _Config mConfig;
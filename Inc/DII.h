@@ -36,6 +36,8 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #include <ocgameExtended.h>
 #include <map>
 #include <list>
+#include <set>
+#include <unordered_set>
 
 typedef void(__thiscall* OCItemInsertEffect)(oCItem*);
 
@@ -136,7 +138,8 @@ public:
 
 	/**
 	 * Extends functionality of zCParser::createInstance(int, void*)
-	 * It is used for initializing an oCItem with a dynamic instance.
+	 * It is used for initializing an oCItem with a dynamic instance. Items of whitelisted static instances
+	 * are initialized from the cached script result (see ObjectManager::initByCachedScript()).
 	 * \param pThis A pointer to a valid zCParser object
 	 * \param instanceId The instance id to create an instance of.
 	 * \param source A pointer to a memory region of the size of an oCItem.
@@ -154,6 +157,99 @@ public:
 	 */
 	static void __thiscall oCGameLoadGameHook(void* pThis, int second, zSTRING const & worldName);
 
+	/**
+	 * Extends functionality of oCGame::LoadWorld(int, zSTRING const &)
+	 * The engine loads a world on new games, savegame loading and level changes. Invalidates the item index
+	 * and the container registry before the previous world is disposed and after the vobs of the new world
+	 * are unarchived.
+	 * Note: oCGame::ChangeLevel isn't hooked, as LeGo patches it.
+	 * \param pThis A pointer to a valid oCGame object.
+	 * \param saveGameSlotNumber The slot of the savegame the world is loaded from.
+	 * \param levelPath The path of the world.
+	 */
+	static void __thiscall oCGameLoadWorldHook(void* pThis, int saveGameSlotNumber, zSTRING const & levelPath);
+
+	/**
+	 * Extends functionality of oCItem::InitByScript(int, int)
+	 * Keeps the item index of the ObjectManager up to date.
+	 * \param pThis A pointer to a valid oCItem object.
+	 * \param instanceId The instance id the item is initialized with.
+	 * \param amount The amount of the item.
+	 */
+	static void __thiscall oCItemInitByScriptHook(void* pThis, int instanceId, int amount);
+
+	/**
+	 * Extends functionality of oCItem::~oCItem()
+	 * Removes the destroyed item from the item index of the ObjectManager.
+	 * \param pThis A pointer to a valid oCItem object.
+	 */
+	static void __thiscall oCItemDestructorHook(void* pThis);
+
+	/**
+	 * Extends functionality of zCWorld::AddVob(zCVob*)
+	 * Keeps the container registry of the ObjectManager up to date.
+	 * \param pThis A pointer to a valid zCWorld object.
+	 * \param vob The vob to add.
+	 * \return The vob tree node of the added vob.
+	 */
+	static void* __thiscall zCWorldAddVobHook(void* pThis, zCVob* vob);
+
+	/**
+	 * Extends functionality of oCWorld::RemoveVob(zCVob*)
+	 * Keeps the container registry of the ObjectManager up to date.
+	 * \param pThis A pointer to a valid oCWorld object.
+	 * \param vob The vob to remove.
+	 */
+	static void __thiscall oCWorldRemoveVobHook(void* pThis, zCVob* vob);
+
+	/**
+	 * Extends functionality of zCWorld::AddVobAsChild(zCVob*, zCTree<zCVob>*)
+	 * Keeps the container registry of the ObjectManager up to date for vobs inserted below other vobs or
+	 * while a world is unarchived, which doesn't call zCWorld::AddVob.
+	 * \param pThis A pointer to a valid zCWorld object.
+	 * \param vob The vob to add.
+	 * \param parent The vob tree node (zCTree<zCVob>*) the vob is added to.
+	 * \return The vob tree node of the added vob.
+	 */
+	static void* __thiscall zCWorldAddVobAsChildHook(void* pThis, zCVob* vob, void* parent);
+
+	/**
+	 * Extends functionality of the (scalar deleting) destructor of oCMobContainer
+	 * Removes the container from the container registry of the ObjectManager, as containers can be destroyed
+	 * without oCWorld::RemoveVob (e.g. when a world is disposed).
+	 * \param pThis A pointer to a valid oCMobContainer object.
+	 * \param flags Passed to the destructor; bit 0 frees the memory.
+	 */
+	static void* __thiscall oCMobContainerDestructorHook(void* pThis, unsigned int flags);
+
+	/**
+	 * Extends functionality of oCGame::Render()
+	 * Applies the instance updates queued during the last frame (see DII_ApplyInstanceChangesToAll).
+	 * \param pThis A pointer to a valid oCGame object.
+	 */
+	static void __thiscall oCGameRenderHook(void* pThis);
+
+	/**
+	 * Extends functionality of oCNpcInventory::Open(int, int, int)
+	 * Applies deferred item updates before the inventory is displayed.
+	 * \param pThis A pointer to a valid oCNpcInventory object.
+	 */
+	static void __thiscall oCNpcInventoryOpenHook(void* pThis, int x, int y, int mode);
+
+	/**
+	 * Extends functionality of oCNpcInventory::Close()
+	 * \param pThis A pointer to a valid oCNpcInventory object.
+	 */
+	static void __thiscall oCNpcInventoryCloseHook(void* pThis);
+
+	/**
+	 * Extends functionality of oCMobContainer::Open(oCNpc*)
+	 * Applies deferred item updates before the content of the container is displayed.
+	 * \param pThis A pointer to a valid oCMobContainer object.
+	 * \param npc The npc opening the container.
+	 */
+	static void __thiscall oCMobContainerOpenHook(void* pThis, void* npc);
+
 	/**
 	 * Provides an sublist of the given inventory. At its head position the list has an oCItem
 	 * which has an instance id equal to that one that was provided to this function.
@@ -185,6 +281,12 @@ public:
 	 */
 	static bool DII_AddProxy(const zSTRING& sourceInstanceName, const zSTRING& targetInstanceName);
 
+	/**
+	 * Reinitializes all items of the given instance with the current instance data.
+	 * The update is queued and applied once at the next frame, so that several changes of
+	 * an instance during a frame cost only one update of its items. Items in inventories that
+	 * aren't displayed are updated as soon as they are displayed or used.
+	 */
 	static void DII_ApplyInstanceChangesToAll(const zSTRING& instanceName);
 
 	/**
@@ -224,6 +326,18 @@ public:
 	static zSTRING* DII_CreateNewInstance(oCItem* item);
 	static int DII_CreateNewInstanceStr(oCItem* item, const zSTRING& instanceName);
 
+	/**
+	 * An external for creating new instance ids for several c_items at once. Ikarus is reinitialized
+	 * only once, so use it for creating many instances (e.g. random loot).
+	 * Daedalus syntax: Func int DII_CreateNewInstancesBatch(var int items, var int count, var int instanceIds)
+	 * \param items Pointer to 'count' oCItem pointers.
+	 * \param count The number of items.
+	 * \param instanceIds Pointer to 'count' integers receiving the ids of the created instances
+	 * (0 for items no instance could be created for). Can be NULL.
+	 * \return The number of created instances.
+	 */
+	static int DII_CreateNewInstancesBatch(oCItem** items, int count, int* instanceIds);
+
 	/**
 	 * An external for checking if a given c_item has a dynamic instance id.
 	 * Daedalus syntax: Func int DII_IsDynamic(C_Item item)
@@ -257,6 +371,7 @@ public:
 
 public:
 	static const std::string SAVE_ITEM_FILE_EXT;
+	static const std::string SAVE_ITEM_JOURNAL_EXT;
 	static const std::string SAVE_ITEM_INSTANCES;
 	static const std::string FILE_PATERN;
 
@@ -280,6 +395,17 @@ private:
 	static const int ZCPARSER_GETINDEX = 0x00793470;
 	static const int ZCPARSER_CREATE_INSTANCE = 0x00792FA0;
 	static const int OCGAME_LOAD_GAME_ADDRESS = 0x006C65A0;
+	static const int OCITEM_INIT_BY_SCRIPT_ADDRESS = 0x00711BD0;
+	static const int OCITEM_DESTRUCTOR_ADDRESS = 0x007116A0;
+	static const int ZCWORLD_ADD_VOB_ADDRESS = 0x00624810;
+	static const int OCWORLD_REMOVE_VOB_ADDRESS = 0x007800C0;
+	static const int ZCWORLD_ADD_VOB_AS_CHILD_ADDRESS = 0x00624830;
+
+	// zCObject's virtual functions: _GetClassDef, Archive, Unarchive, the destructor
+	static const int ZCOBJECT_VTABLE_DESTRUCTOR_SLOT = 3;
+	static const int OCGAME_RENDER_ADDRESS = 0x006C86A0;
+	static const int OCNPC_INVENTORY_OPEN_ADDRESS = 0x0070BF10;
+	static const int OCNPC_INVENTORY_CLOSE_ADDRESS = 0x0070C2F0;
 
 	static const int OCNPC_UNEQUIP_ITEM = 0x007326C0;
 	static const int OCGAME_CHANGE_LEVEL = 0x006C7290;
@@ -294,6 +420,33 @@ private:
 
 	static bool showExtendedDebugInfo;
 
+	// instance ids passed to DII_ApplyInstanceChangesToAll during the current frame
+	static std::set<int> mQueuedInstanceUpdates;
+
+	// items of the queued updates, which are in an inventory or container that isn't displayed
+	static std::unordered_set<oCItem*> mDeferredItemUpdates;
+
+	// currently displayed npc inventories
+	static std::unordered_set<void*> mOpenInventories;
+
+	/**
+	 * Applies all updates queued by DII_ApplyInstanceChangesToAll.
+	 */
+	static void applyQueuedInstanceUpdates();
+
+	/**
+	 * Applies the deferred update of the given item, if it has one.
+	 */
+	static void applyDeferredItemUpdate(oCItem* item);
+
+	static void applyDeferredItemUpdates();
+
+	/**
+	 * \return Can the update of the item be deferred? This is the case for items lying in an inventory
+	 * or container (i.e. not in the world), which isn't displayed, and that aren't equipped.
+	 */
+	static bool isItemUpdateDeferrable(oCItem* item);
+
 	class DII_InstanceNameNotFoundException : protected std::exception {
 	private:
 		std::string err_msg;
@@ -328,6 +481,11 @@ private:
 
 		static bool updateItem(void* obj, void* param, oCItem* itm);
 
+		/**
+		 * Like updateItem, but defers the update if possible (see isItemUpdateDeferrable).
+		 */
+		static bool updateOrDeferItem(void* obj, void* param, oCItem* itm);
+
 		static bool updateItemInstance(void* obj, void* param, oCItem* itm);
 
 	};
@@ -0,0 +1,214 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include "Archive.h"
+#include "DiiRecord.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * The savegame archive of the DIIs: the instances, the proxies and the state of the generated name allocator.
+ * Writes version 2 archives and journal entries and loads them as well as version 1.1 archives.
+ * The format doesn't depend on the engine; ObjectManager collects what is written and applies loaded
+ * archives to the parser.
+ */
+class DiiArchive {
+public:
+
+	struct ARCHIVE_HEADER {
+	public:
+
+		static constexpr float VERSION = 2.2f;
+
+		// Stream based format: instances and proxies serialized field by field. Still readable.
+		static constexpr float VERSION_1_1 = 1.1f;
+
+		static constexpr const char DESC[] = "ARCHIVE_VERSION";
+
+		ARCHIVE_HEADER() {
+			std::memcpy(desc, DESC, sizeof(DESC));
+		}
+
+		char desc[sizeof(DESC)];
+		float version = VERSION;
+	};
+
+	/**
+	 * Block structure of a version 2 archive. It follows directly the ARCHIVE_HEADER:
+	 *   ARCHIVE_LAYOUT
+	 *   string table:  stringCount x (uint32 length, characters)
+	 *   image block:   uint32 imageCount, imageCount x prototype field image (see DiiRecord::writeFieldImage)
+	 *   record block:  instanceCount x (delta record, userDataIntAmount ints, userDataStringAmount string indices).
+	 *                  The delta records refer to the image block (see DiiRecord::writeDeltaRecord).
+	 *   proxy block:   proxyCount x (source string index, target string index)
+	 *   name allocator block: uint32 next generated name number, uint32 free number count,
+	 *                  free number count x uint32
+	 *   uint32 CRC-32 of all preceding bytes (header included)
+	 */
+	struct ARCHIVE_LAYOUT {
+		uint32_t instanceCount = 0;
+		uint32_t intFieldCount = 0;
+		uint32_t stringFieldCount = 0;
+		uint32_t userDataIntAmount = 0;
+		uint32_t userDataStringAmount = 0;
+		uint32_t stringCount = 0;
+		uint32_t proxyCount = 0;
+	};
+
+	/**
+	 * Header of a journal entry. A journal is a sequence of entries, each followed by 'size' bytes of body and
+	 * the CRC-32 of the body. The body has the structure of a version 2 archive without header and checksum
+	 * (ARCHIVE_LAYOUT and the following blocks), but contains only the instances changed since the previous save.
+	 */
+	struct ARCHIVE_JOURNAL_ENTRY {
+
+		static constexpr uint32_t MAGIC = 0x4A494944; // "DIIJ"
+
+		enum Flags {
+			// the proxy block replaces all proxies
+			HAS_PROXIES = 1 << 0,
+
+			// the name allocator block follows the proxy block; always set
+			HAS_NAME_ALLOCATOR = 1 << 1,
+
+			// the body has an image block and delta records; always set
+			HAS_DELTA_RECORDS = 1 << 2,
+		};
+
+		uint32_t magic = MAGIC;
+		uint32_t flags = 0;
+
+		// checksum of the archive the entry applies to
+		uint32_t baseChecksum = 0;
+		uint32_t size = 0;
+	};
+
+	// <source instance name, target instance name>
+	using ProxyMap = std::unordered_map<std::string, std::string>;
+	using ProxyList = std::vector<std::pair<std::string, std::string>>;
+
+	/**
+	 * Creates the instances of a loaded archive.
+	 */
+	using InstanceFactory = std::function<std::unique_ptr<DiiRecord>()>;
+
+	/**
+	 * The content of an archive and its journal before it is applied to the parser.
+	 */
+	struct LoadedArchive {
+
+		/**
+		 * \param userDataIntAmount, userDataStringAmount The user data amounts defined by the scripts.
+		 */
+		LoadedArchive(InstanceFactory createInstance, uint32_t userDataIntAmount, uint32_t userDataStringAmount);
+
+		InstanceFactory createInstance;
+		uint32_t userDataIntAmount;
+		uint32_t userDataStringAmount;
+
+		std::vector<std::unique_ptr<DiiRecord>> instances;
+
+		// <symbol name, index into instances>
+		std::unordered_map<std::string, size_t> instanceIndices;
+		ProxyList proxies;
+
+		bool hasNameAllocator = false;
+		uint32_t nextGeneratedName = 0;
+		std::vector<uint32_t> freeGeneratedNames;
+
+		// the number of applied journal entries
+		int journalEntryCount = 0;
+
+		// problems that didn't prevent loading, e.g. an incomplete journal entry; they are logged by the caller
+		std::vector<std::string> warnings;
+
+		/**
+		 * Adds an instance or replaces the instance with the same symbol name.
+		 */
+		void addInstance(std::unique_ptr<DiiRecord> instance);
+	};
+
+	/**
+	 * Builds a version 2 archive in memory.
+	 */
+	static void writeArchive(ArchiveWriter& archive, const std::vector<const DiiRecord*>& instances, const ProxyMap& proxies,
+		uint32_t nextGeneratedName, const std::vector<uint32_t>& freeGeneratedNames);
+
+	/**
+	 * Builds a journal entry in memory.
+	 * \param baseChecksum The checksum of the archive the entry applies to.
+	 * \param proxies The proxies, if they changed since the previous save; otherwise nullptr.
+	 */
+	static void writeJournalEntry(ArchiveWriter& entry, uint32_t baseChecksum, const std::vector<const DiiRecord*>& instances,
+		const ProxyMap* proxies, uint32_t nextGeneratedName, const std::vector<uint32_t>& freeGeneratedNames);
+
+	/**
+	 * Writes the layout, string table, image, record, proxy and name allocator blocks of the given instances.
+	 * \param proxies The proxies to write or nullptr for an empty proxy block.
+	 */
+	static void writeArchiveBlocks(ArchiveWriter& writer, const std::vector<const DiiRecord*>& instances,
+		const ProxyMap* proxies, uint32_t nextGeneratedName, const std::vector<uint32_t>& freeGeneratedNames);
+
+	/**
+	 * Reads blocks written by writeArchiveBlocks. Throws a std::runtime_error if the blocks are corrupt.
+	 */
+	static void readArchiveBlocks(ArchiveReader& reader, LoadedArchive& archive, ProxyList& proxies);
+
+	/**
+	 * Loads an archive file of version 2 or 1.1. Throws a std::runtime_error if the archive is corrupt
+	 * or has another format.
+	 * \return The checksum of the archive or 0 for archives without checksum (version 1.1).
+	 */
+	static uint32_t loadArchive(const char* begin, const char* end, LoadedArchive& archive);
+
+	/**
+	 * Loads the body of a version 2 archive (the part following the ARCHIVE_HEADER).
+	 * \return The checksum of the archive.
+	 */
+	static uint32_t loadArchive_2(const char* begin, const char* end, LoadedArchive& archive);
+
+	/**
+	 * Loads the body of a version 1.1 archive. Archives of this version have no checksum.
+	 * \return 0
+	 */
+	static uint32_t loadArchive_1_1(const char* begin, const char* end, LoadedArchive& archive);
+
+	/**
+	 * Applies all entries of a journal that belong to the archive with the given checksum.
+	 * A truncated or corrupt entry ends the journal.
+	 */
+	static void applyJournal(const std::vector<char>& journal, uint32_t baseChecksum, LoadedArchive& archive);
+};
@@ -0,0 +1,405 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include "ISerialization.h"
+#include "StringPool.h"
+#include "Archive.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+/**
+ * The user data of a dynamic instance as it is stored in archives. DII_UserData implements it with engine
+ * strings, which makes the user data the only engine dependent part of an archived instance.
+ * serialize() and deserialize() use the stream format of version 1.1 archives.
+ */
+class IUserDataRecord : public ISerialization {
+public:
+
+	/**
+	 * Writes the user data as part of a fixed width archive record: 'intAmount' integers followed by
+	 * 'strAmount' string table indices. Missing values are written as zero / empty string.
+	 */
+	virtual void writeRecord(ArchiveWriter& writer, ArchiveStringTable& strings, int intAmount, int strAmount) const = 0;
+
+	/**
+	 * Reads user data written by writeRecord. Values exceeding the held amounts are skipped.
+	 * \param strings Maps archive string indices to pool handles.
+	 */
+	virtual void readRecord(ArchiveReader& reader, const std::vector<StringPool::Handle>& strings, int intAmount, int strAmount) = 0;
+
+	/**
+	 * \return The number of integers and strings the user data holds.
+	 */
+	virtual int getIntCount() const = 0;
+	virtual int getStringCount() const = 0;
+};
+
+/**
+ * The engine independent part of a dynamic instance: its parser symbol, its prototype and the values of
+ * its item fields. Together with the user data this is what savegame archives store (see DiiArchive),
+ * so archives can be written and loaded without the engine.
+ */
+class DiiRecord : public ISerialization {
+
+public:
+
+	DiiRecord();
+
+	virtual ~DiiRecord();
+
+	/**
+	 * Text fields are stored as handles into the StringPool, since most of them are shared
+	 * among all DIIs created from the same prototype.
+	 */
+	using StringHandle = StringPool::Handle;
+
+	/**
+	 * Integer fields of a FieldImage in the order of the oCItem members. Array members occupy consecutive fields.
+	 */
+	enum IntField {
+		FIELD_IDX, FIELD_HP, FIELD_HP_MAX, FIELD_MAINFLAGS, FIELD_FLAGS, FIELD_WEIGHT, FIELD_VALUE,
+		FIELD_DAMAGE_TYPE, FIELD_DAMAGE_TOTAL, FIELD_DAMAGE,
+		FIELD_WEAR = FIELD_DAMAGE + 8, FIELD_PROTECTION,
+		FIELD_NUTRITION = FIELD_PROTECTION + 8, FIELD_COND_ATR,
+		FIELD_COND_VALUE = FIELD_COND_ATR + 3,
+		FIELD_CHANGE_ATR = FIELD_COND_VALUE + 3,
+		FIELD_CHANGE_VALUE = FIELD_CHANGE_ATR + 3,
+		FIELD_OWNER_GUILD = FIELD_CHANGE_VALUE + 3, FIELD_DISGUISE_GUILD, FIELD_VISUAL_SKIN, FIELD_MATERIAL,
+		FIELD_SPELL, FIELD_RANGE, FIELD_MAG_CIRCLE, FIELD_TEXT_COUNT,
+		FIELD_INV_ZBIAS = FIELD_TEXT_COUNT + 6, FIELD_INV_ROTX, FIELD_INV_ROTY, FIELD_INV_ROTZ, FIELD_INV_ANIMATE,
+		FIELD_AMOUNT, FIELD_C_MANIPULATION, FIELD_LAST_MANIPULATION, FIELD_MAGIC_VALUE,
+		INT_FIELD_COUNT
+	};
+
+	/**
+	 * String fields of a FieldImage. The script function and instance fields (magic, on_equip, ..., munition)
+	 * hold symbol names.
+	 */
+	enum StringField {
+		FIELD_NAME, FIELD_NAME_ID, FIELD_MAGIC, FIELD_ON_EQUIP, FIELD_ON_UNEQUIP, FIELD_ON_STATE,
+		FIELD_OWNER = FIELD_ON_STATE + 4, FIELD_VISUAL, FIELD_VISUAL_CHANGE, FIELD_EFFECT, FIELD_SCEME_NAME,
+		FIELD_MUNITION, FIELD_DESCRIPTION, FIELD_TEXT,
+		STRING_FIELD_COUNT = FIELD_TEXT + 6
+	};
+
+	/**
+	 * Number of fields of a FieldImage. Where fields are addressed by a single index, the integer fields
+	 * come first and string field i has the index INT_FIELD_COUNT + i.
+	 */
+	static constexpr int FIELD_COUNT = INT_FIELD_COUNT + STRING_FIELD_COUNT;
+
+	static constexpr int OVERRIDE_MASK_WORDS = (FIELD_COUNT + 31) / 32;
+
+	/**
+	 * The values of all item fields stored by a dynamic instance.
+	 */
+	struct FieldImage {
+		int ints[INT_FIELD_COUNT];
+		StringHandle strings[STRING_FIELD_COUNT];
+	};
+
+	/**
+	 * A run of consecutive oCItem members of the same kind, which are mapped to consecutive fields of a FieldImage.
+	 * The member offsets are kept by DynInstance (see DynInstance::FIELD_OFFSETS).
+	 */
+	struct FieldRun {
+		enum Kind {
+			// int members stored as integer fields
+			INTS,
+
+			// zSTRING members stored as string fields
+			STRINGS,
+
+			// parser symbol indices stored as string fields holding the symbol names
+			SYMBOLS,
+		};
+
+		Kind kind;
+
+		// the first field (an IntField for INTS, a StringField otherwise)
+		int field;
+		int count;
+
+		// index of the first symbol in ResolvedIndices::indices and DynInstance::ItemImage::symbols (SYMBOLS only)
+		int symbol;
+
+		// Is the run applied to items? The stack amount of an item doesn't belong to its instance.
+		bool applied;
+	};
+
+	static constexpr int SYMBOL_FIELD_COUNT = 9;
+
+	/**
+	 * All fields of a FieldImage in oCItem member order. The table drives storing, initializing and copying
+	 * item fields as well as the stream serialization. Integer runs are copied with a single memcpy.
+	 */
+	static constexpr FieldRun FIELD_RUNS[] = {
+		{ FieldRun::INTS, FIELD_IDX, 1, -1, true },
+		{ FieldRun::STRINGS, FIELD_NAME, 2, -1, true },
+
+		// hp ... change_value
+		{ FieldRun::INTS, FIELD_HP, FIELD_CHANGE_VALUE + 3 - FIELD_HP, -1, true },
+
+		// magic, on_equip, on_unequip, on_state[4], owner
+		{ FieldRun::SYMBOLS, FIELD_MAGIC, FIELD_OWNER + 1 - FIELD_MAGIC, 0, true },
+		{ FieldRun::INTS, FIELD_OWNER_GUILD, 2, -1, true },
+
+		// visual, visual_change, effect
+		{ FieldRun::STRINGS, FIELD_VISUAL, 3, -1, true },
+		{ FieldRun::INTS, FIELD_VISUAL_SKIN, 1, -1, true },
+		{ FieldRun::STRINGS, FIELD_SCEME_NAME, 1, -1, true },
+		{ FieldRun::INTS, FIELD_MATERIAL, 1, -1, true },
+		{ FieldRun::SYMBOLS, FIELD_MUNITION, 1, FIELD_OWNER + 1 - FIELD_MAGIC, true },
+
+		// spell, range, mag_circle
+		{ FieldRun::INTS, FIELD_SPELL, 3, -1, true },
+
+		// description, text[6]
+		{ FieldRun::STRINGS, FIELD_DESCRIPTION, 7, -1, true },
+
+		// count[6], inventory presentation
+		{ FieldRun::INTS, FIELD_TEXT_COUNT, FIELD_INV_ANIMATE + 1 - FIELD_TEXT_COUNT, -1, true },
+		{ FieldRun::INTS, FIELD_AMOUNT, 1, -1, false },
+
+		// c_manipulation, last_manipulation, magic_value (the instance id member precedes them)
+		{ FieldRun::INTS, FIELD_C_MANIPULATION, 3, -1, true },
+	};
+
+	std::string mSymbolName;
+	int zCPar_Symbol_Bitfield = 0;
+	StringHandle mPrototypeSymbolName = {};
+
+	/**
+	 * \return The user data stored with the instance.
+	 */
+	virtual IUserDataRecord& getUserDataRecord() = 0;
+	virtual const IUserDataRecord& getUserDataRecord() const = 0;
+
+	/**
+	 * Provides the parent's instance id of this dynamic instance. The Parent instance id is the parser
+	 * index of the base class of this dynamic instance.
+	 */
+	const std::string& getPrototypeSymbolName();
+
+	/**
+	 * Sets this' parent instance id. The Parent instance id is the parser index of the base class of
+	 * this dynamic instance.
+	 */
+	void setPrototypeSymbolName(const std::string& symbolName);
+
+	/**
+	 * Assigns a new instance to its prototype before its fields are stored; the instance gets the fields of the
+	 * shared prototype image. If no image is shared for the prototype yet, 'prototypeImage' becomes the shared
+	 * image, so the overrides of the instances are taken relative to the prototype's own fields.
+	 */
+	void setPrototype(const std::string& symbolName, const FieldImage& prototypeImage);
+
+	/**
+	 * \return Is an image shared for the prototype yet?
+	 */
+	static bool hasPrototypeImage(const std::string& symbolName);
+
+	/**
+	 * \return The name of the zCPar_Symbol associated with this dynamic instance
+	 */
+	const std::string& getSymbolName();
+
+	/**
+	 * Sets the name of the zCPar_Symbol associated with this dynamic instance.
+	 * \param name The name of the zCPar_Symbol
+	 */
+	void setSymbolName(const std::string& symbolName);
+
+	/**
+	 * Writes / reads the instance in the stream format of version 1.1 archives: the symbol names, the bitfield,
+	 * all fields in FIELD_RUNS order and the user data.
+	 */
+	virtual void serialize(std::ostream&) const override;
+
+	virtual void deserialize(std::istream&) override;
+
+	/**
+	 * Number of integer and string fields of an instance in the block structured savegame archive
+	 * (user data excluded): the field image plus the bitfield, the symbol name and the prototype symbol name.
+	 */
+	static constexpr uint32_t ARCHIVE_INT_FIELD_COUNT = INT_FIELD_COUNT + 1;
+	static constexpr uint32_t ARCHIVE_STRING_FIELD_COUNT = STRING_FIELD_COUNT + 2;
+
+	/**
+	 * Writes the delta record of this instance: the bitfield, the string indices of the symbol name and the
+	 * prototype symbol name, the index of the prototype image, the override mask (OVERRIDE_MASK_WORDS integers)
+	 * and the values of the overridden fields. String fields are written as string table indices.
+	 * \param imageIndex The index of getPrototypeImage() in the image block of the archive.
+	 */
+	void writeDeltaRecord(ArchiveWriter& writer, ArchiveStringTable& strings, uint32_t imageIndex) const;
+
+	/**
+	 * \return The number of bytes writeDeltaRecord writes.
+	 */
+	size_t getDeltaRecordSize() const;
+
+	/**
+	 * Reads a record written by writeDeltaRecord.
+	 * \param images The images of the archive's image block.
+	 */
+	void readDeltaRecord(ArchiveReader& reader, const std::vector<StringHandle>& strings,
+		const std::vector<std::shared_ptr<const FieldImage>>& images);
+
+	/**
+	 * Writes a field image: INT_FIELD_COUNT integers followed by STRING_FIELD_COUNT string table indices.
+	 */
+	static void writeFieldImage(ArchiveWriter& writer, ArchiveStringTable& strings, const FieldImage& image);
+	static void readFieldImage(ArchiveReader& reader, const std::vector<StringHandle>& strings, FieldImage& image);
+
+	/**
+	 * Provides the values of all fields, i.e. the prototype image with the overrides of this instance applied.
+	 */
+	void getFieldImage(FieldImage& image) const;
+
+	/**
+	 * Sets the values of all fields. Only the fields differing from the prototype image are stored.
+	 * If setPrototype() didn't provide the shared image of the prototype, the first image set for the prototype
+	 * becomes the prototype image shared by all its instances.
+	 */
+	void setFieldImage(const FieldImage& image);
+
+	int getIntField(IntField field) const;
+	StringHandle getStringField(StringField field) const;
+
+	/**
+	 * \return The (shared) field image the overrides of this instance refer to.
+	 */
+	const std::shared_ptr<const FieldImage>& getPrototypeImage() const;
+
+	/**
+	 * \return The number of fields differing from the prototype image.
+	 */
+	size_t getOverrideCount() const;
+
+	/**
+	 * Forgets the shared prototype images. Instances keep the images they refer to.
+	 * Has to be called when the StringPool is cleared.
+	 */
+	static void releasePrototypeImages();
+
+	/**
+	 * \return The number of shared prototype images.
+	 */
+	static size_t getPrototypeImageCount();
+
+	/**
+	 * Marks the pool handles this instance refers to (see StringPool::beginCollection()).
+	 */
+	void markStrings(StringPool& pool) const;
+
+	static void markFieldImage(const FieldImage& image, StringPool& pool);
+
+	/**
+	 * Forgets the shared prototype images no instance refers to anymore and marks the handles of the others.
+	 */
+	static void markPrototypeImages(StringPool& pool);
+
+	/**
+	 * \return The content of the bitfield member of the parser symbol associated with this class.
+	 */
+	int getParserSymbolBitfield();
+
+	/**
+	 * Sets the parser symbol's bitfield meber associated with this class.
+	 * \param bitfield The bitefield parameter to be set
+	 */
+	void setParserSymbolBitfield(int bitfield);
+
+	bool getDoNotStore() const;
+	void setDoNotStore(bool doNotStore);
+
+	/**
+	 * An instance is dirty if it was changed since the last savegame. Only dirty instances are
+	 * written to the savegame journal (see ObjectManager::saveNewInstances).
+	 */
+	bool isDirty() const;
+	void setDirty(bool dirty);
+
+	/**
+	 * \return The number of bytes the text fields of this instance would occupy if they were stored as
+	 * std::string members, and the number of bytes the handles occupy. Used for memory reports.
+	 */
+	size_t getUnpooledStringByteSize() const;
+	size_t getPooledStringByteSize() const;
+
+
+protected:
+
+	/**
+	 * Parser symbol indices of the script function and instance fields (magic, on_equip, ..., munition).
+	 * They are resolved once per parser generation (see ObjectManager::getParserGeneration()), so that
+	 * initializing items doesn't need any symbol name lookups. Replacing the fields resets the generation.
+	 */
+	struct ResolvedIndices {
+		unsigned int parserGeneration = 0;
+
+		// in FIELD_RUNS order: magic, on_equip, on_unequip, on_state[4], owner, munition
+		int indices[SYMBOL_FIELD_COUNT] = {};
+	};
+
+	bool mDoNotStore = false;
+	bool mDirty = true;
+
+	ResolvedIndices mResolvedIndices;
+
+	// Copy on write field storage: the prototype image is never modified; fields set to other values
+	// are marked in the override mask and their values are stored in field order.
+	std::shared_ptr<const FieldImage> mPrototypeImage;
+	uint32_t mOverrideMask[OVERRIDE_MASK_WORDS] = {};
+	std::vector<int> mOverrides;
+
+	// <prototype symbol name, prototype image>
+	static std::unordered_map<StringHandle, std::shared_ptr<const FieldImage>> mPrototypeImages;
+
+	bool isOverridden(int field) const;
+
+	/**
+	 * Provides a field value. String fields are provided as pool handles.
+	 */
+	int getFieldValue(int field) const;
+
+	/**
+	 * \return The position of the value of an overridden field in mOverrides.
+	 */
+	size_t getOverridePosition(int field) const;
+
+	/**
+	 * \return The image of instances without any stored fields (all fields zero / empty).
+	 */
+	static const std::shared_ptr<const FieldImage>& getEmptyImage();
+};
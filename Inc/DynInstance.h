@@ -29,10 +29,15 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #ifndef __DYN_INSTANCE_H__
 #define __DYN_INSTANCE_H__
 
-#include "ISerialization.h"
+#include "DiiRecord.h"
 #include <api/g2/oCItemExtended.h>
 #include <sstream>
 #include <list>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
 
 
 class zCParser;
@@ -51,7 +56,7 @@ struct zSTRINGSerialized
  * Stores additional memory the user can use to give a dynamic instance additional attributes.
  * This class will be mainly used over the Daedalus script language.
  */
-class DII_UserData : public ISerialization {
+class DII_UserData : public IUserDataRecord {
 public:
 
 	static constexpr const char* INT_AMOUNT_DAEDALUS_VAR = "DII_USER_DATA_INTEGER_AMOUNT";
@@ -61,15 +66,27 @@ public:
 	//DII_UserData(zCParser* parser, int instance);
 	~DII_UserData();
 
+	// The memory block is owned exclusively
+	DII_UserData(const DII_UserData&) = delete;
+	DII_UserData& operator=(const DII_UserData&) = delete;
+
 	virtual void serialize(std::ostream&) const override;
 
 	virtual void deserialize(std::istream&) override;
 
+	virtual void writeRecord(ArchiveWriter& writer, ArchiveStringTable& strings, int intAmount, int strAmount) const override;
+
+	virtual void readRecord(ArchiveReader& reader, const std::vector<StringPool::Handle>& strings, int intAmount, int strAmount) override;
+
+	virtual int getIntCount() const override;
+	virtual int getStringCount() const override;
+
+	/**
+	 * \return The amounts of integers and strings defined by the scripts.
+	 */
 	static int getIntAmount();
 	static int getStringAmount();
 
-	void assertEqualAmounts();
-
 public:
 
 	struct MemoryData
@@ -83,18 +100,44 @@ public:
 			return (int*)pMemory;
 		}
 
-		zSTRINGSerialized* getStr(int index)
+		zSTRINGSerialized* getStr(int index) const
 		{
-			return (zSTRINGSerialized*)pMemory[intAmount * sizeof(int) + index * sizeof(zSTRINGSerialized)];
+			return (zSTRINGSerialized*)(pMemory + intAmount * sizeof(int) + index * sizeof(zSTRINGSerialized));
 		}
 	} userData;
 
+	/**
+	 * \return The content of the user data string at the given index.
+	 */
+	std::string getString(int index) const;
+
+	/**
+	 * Sets the user data string at the given index.
+	 */
+	void setString(int index, const char* content);
+
 
 private:
 
-	static void* __cdecl gothic2OperatorNew(std::size_t size);
+	/**
+	 * \return The size of a user data memory block with the given amounts.
+	 */
+	static size_t getByteSize(int intAmount, int strAmount);
+
+	/**
+	 * Releases the character data of a user data string and empties it.
+	 */
+	static void releaseString(zSTRINGSerialized* str);
 
+	/**
+	 * Allocates the memory block from the UserDataArena.
+	 */
 	void createMemory(int intAmount, int strAmount);
+
+	/**
+	 * Releases the strings and returns the memory block to the UserDataArena.
+	 */
+	void releaseMemory();
 };
 
 
@@ -102,8 +145,9 @@ private:
 /**
  * A class for representing a dynamic instance of an oCItem. It contains all relevant information for 
  * initializing and storing oCItems and additional memory which can be freely used by the user.
+ * The fields and the archive records are kept by DiiRecord; this class connects them to items and the parser.
  */
-class DynInstance : public ISerialization {
+class DynInstance : public DiiRecord {
 
 public:
 
@@ -123,139 +167,71 @@ public:
 	~DynInstance();
 
 public:
-	std::string mSymbolName;
-	int zCPar_Symbol_Bitfield;
-	std::string mPrototypeSymbolName;
-	int		idx;
-	std::string name;
-	std::string nameID;
-	int		hp;
-	int		hp_max;
-	int     mainflags;
-	int		flags;
-	int		weight;
-	int     value;
-
-	// -- weapons		
-	int     damageType;
-	int     damageTotal;
-	int     damage[8];
-
-	// -- armor 
-	int     wear;	
-	int     protection[8];
-
-	// -- food
-	int     nutrition;
-
-	// -- use attributes
-	int     cond_atr[3];
-	int     cond_value[3];
-
-	// -- attributes that will be changed on equip
-	int     change_atr[3];
-	int     change_value[3];		//51
-
-	// -- parser functions
-	std::string     magic;
-	std::string     on_equip;
-	std::string     on_unequip;
-	std::string     on_state[4];
-
-	// -- owner									
-	std::string		owner;			//	owner: npc instance
-	int		ownerGuild;		//	owner: guild
-	int		disguiseGuild;
-
-	// -- visual
-	std::string	visual;
-
-	// -- change of mesh on equip
-	std::string visual_change;	//	ASC file
-	std::string effect;			//  Effect instance
-
-	int		visual_skin;
-
-	std::string	scemeName;
-	int		material;	
-	std::string		munition;		//	Instance of ammunition
-
-	int 	spell;			
-	int		range;			//85		
-
-	int		mag_circle;
-
-	std::string	description;
-	std::string	text[6];
-	int		count[6];
-
-	// -- inventory presentation
-	int	    inv_zbias;								//  far plane (how far the item goes into the room by the z-axis)
-	int		inv_rotx;								//  rotation around x-axis (in degrees)
-	int 	inv_roty;								//  rotation around y-axis (in degrees)
-	int 	inv_rotz;								//  rotation around z-axis (in degrees)
-	int 	inv_animate;							//  rotate the item
-
-	int amount;
-	//int instanz;						//int Symbolindex
-	int c_manipulation;					//int ?
-	int last_manipulation;				//zREAL ?
-	int magic_value;					//int ?
-	//int next;							//138
-	DII_UserData dii_userData;
-
-
-	/**
-	 * Initializes this dynamic instance with the given oCItem.
-	 * \param item The oCItem used to initialize this dynamic instance.
-	 */
-	void store(oCItem& item);
 
 	/**
-	 * Inits the provided oCItem with this dynamic instance and sets the oCItem's instance id 
-	 * to the second parameter.
-	 * \param item The item to be initialized
-	 * \param instanceParserSymbolID The symbol index of the dynamic instance.
+	 * Offsets of the first oCItem member of each run of FIELD_RUNS.
 	 */
-	void init(oCItem* item, int instanceParserSymbolID);
+	static constexpr size_t FIELD_OFFSETS[] = {
+		offsetof(oCItem, idx),
+		offsetof(oCItem, name),
+		offsetof(oCItem, hp),
+		offsetof(oCItem, magic),
+		offsetof(oCItem, ownerGuild),
+		offsetof(oCItem, visual),
+		offsetof(oCItem, visual_skin),
+		offsetof(oCItem, scemeName),
+		offsetof(oCItem, material),
+		offsetof(oCItem, munition),
+		offsetof(oCItem, spell),
+		offsetof(oCItem, description),
+		offsetof(oCItem, count),
+		offsetof(oCItem, amount),
+		offsetof(oCItem, c_manipulation),
+	};
 
 	/**
-	 * Provides the parent's instance id of this dynamic instance. The Parent instance id is the parser 
-	 * index of the base class of this dynamic instance.
+	 * The fields of an item as they are applied to items: Unlike a FieldImage, symbol fields are kept as
+	 * parser symbol indices, so applying the image needs no symbol lookups. The symbol name fields of
+	 * 'fields' are unused.
 	 */
-	const std::string& getPrototypeSymbolName();
+	struct ItemImage {
+		FieldImage fields;
+		int symbols[SYMBOL_FIELD_COUNT];
+	};
 
 	/**
-	 * Sets this' parent instance id. The Parent instance id is the parser index of the base class of
-	 * this dynamic instance.
+	 * Captures the fields of an item. Strings are interned into the StringPool.
 	 */
-	void setPrototypeSymbolName(const std::string& symbolName);
+	static void captureItemImage(oCItem& item, ItemImage& image);
 
 	/**
-	 * \return The name of the zCPar_Symbol associated with this dynamic instance
+	 * Assigns the fields of an item image to an item. The item keeps its instance id and stack amount.
 	 */
-	const std::string& getSymbolName();
+	static void applyItemImage(const ItemImage& image, oCItem* item);
 
 	/**
-	 * Sets the name of the zCPar_Symbol associated with this dynamic instance.
-	 * \param name The name of the zCPar_Symbol
+	 * Converts an item image to a field image: the symbol fields are set to the names of the symbols.
 	 */
-	void setSymbolName(const std::string& symbolName);
+	static void toFieldImage(const ItemImage& image, FieldImage& fields);
 
-	virtual void serialize(std::ostream&) const override;
+	DII_UserData dii_userData;
 
-	virtual void deserialize(std::istream&) override;
+	virtual IUserDataRecord& getUserDataRecord() override;
+	virtual const IUserDataRecord& getUserDataRecord() const override;
 
 	/**
-	 * \return The content of the bitfield member of the parser symbol associated with this class. 
+	 * Initializes this dynamic instance with the given oCItem.
+	 * \param item The oCItem used to initialize this dynamic instance.
 	 */
-	int getParserSymbolBitfield();
+	void store(oCItem& item);
 
 	/**
-	 * Sets the parser symbol's bitfield meber associated with this class. 
-	 * \param bitfield The bitefield parameter to be set
+	 * Inits the provided oCItem with this dynamic instance and sets the oCItem's instance id 
+	 * to the second parameter.
+	 * \param item The item to be initialized
+	 * \param instanceParserSymbolID The symbol index of the dynamic instance.
 	 */
-	void setParserSymbolBitfield(int bitfield);
+	void init(oCItem* item, int instanceParserSymbolID);
 
 	/**
 	 * Provides access to the user data member of this class.
@@ -269,14 +245,21 @@ public:
 	 */
 	//void copyUserData(DynInstance& source);
 
-	bool getDoNotStore() const;
-	void setDoNotStore(bool doNotStore);
-
 
 private:
+
 	static std::stringstream mLogStream;
 
-	bool mDoNotStore = false;
+	/**
+	 * Provides the resolved symbol indices and resolves them if the cache is outdated.
+	 */
+	const ResolvedIndices& getResolvedIndices();
+
+	/**
+	 * Provides the symbol name of a parser symbol index. The lookup is skipped if the index matches
+	 * the cached index of the currently stored name.
+	 */
+	static StringHandle internSymbolName(int index, int cachedIndex, StringHandle cachedName, bool cacheValid);
 };
 
 #endif __DYN_INSTANCE_H__
\ No newline at end of file
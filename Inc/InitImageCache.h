@@ -0,0 +1,142 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <cstddef>
+
+/**
+ * Caches the result of instance scripts for a whitelist of instances: the first item created from a
+ * whitelisted instance runs the script and its fields are captured as an image; later items of the same
+ * script generation get the image instead of running the script again. All other instances always run
+ * their script, since it might have side effects.
+ * The images and the whitelist belong to a script generation (see ObjectManager::invalidateScriptCaches()):
+ * images of older generations are never applied, and the whitelist (instance ids) has to be resolved again.
+ */
+template<class Image>
+class InitImageCache {
+public:
+
+	/**
+	 * \return Has the whitelist to be resolved (again) for the given script generation?
+	 */
+	bool needsWhitelist(unsigned int scriptGeneration) const
+	{
+		return mWhitelistGeneration != scriptGeneration;
+	}
+
+	/**
+	 * Sets the whitelisted instance ids of a script generation. The cached images are released.
+	 */
+	void setWhitelist(std::unordered_set<int> instanceIds, unsigned int scriptGeneration)
+	{
+		mWhitelist = std::move(instanceIds);
+		mWhitelistGeneration = scriptGeneration;
+		mImages.clear();
+	}
+
+	bool isWhitelisted(int instanceId) const
+	{
+		return mWhitelist.find(instanceId) != mWhitelist.end();
+	}
+
+	/**
+	 * \return The image of the instance stored in the given script generation or nullptr.
+	 */
+	const Image* find(int instanceId, unsigned int scriptGeneration) const
+	{
+		auto it = mImages.find(instanceId);
+		if (it == mImages.end() || it->second.first != scriptGeneration) return nullptr;
+		return &it->second.second;
+	}
+
+	/**
+	 * Provides the image of the instance to be captured in the given script generation.
+	 */
+	Image& store(int instanceId, unsigned int scriptGeneration)
+	{
+		auto& entry = mImages[instanceId];
+		entry.first = scriptGeneration;
+		return entry.second;
+	}
+
+	/**
+	 * Initializes an item from an instance: whitelisted instances are initialized from their image, if one is
+	 * cached. Otherwise the script runs, and the result of whitelisted instances is captured.
+	 * \param runScript int(): Runs the instance script; returns 0 on failure.
+	 * \param capture void(Image&): Captures the initialized item.
+	 * \param apply void(const Image&): Initializes the item from a cached image.
+	 * \return The result of the script or 1 if the cached image was applied.
+	 */
+	template<class RunScript, class Capture, class Apply>
+	int initialize(int instanceId, unsigned int scriptGeneration, RunScript runScript, Capture capture, Apply apply)
+	{
+		if (!isWhitelisted(instanceId)) return runScript();
+
+		if (const auto* image = find(instanceId, scriptGeneration)) {
+			apply(*image);
+			return 1;
+		}
+
+		const int result = runScript();
+		if (result) capture(store(instanceId, scriptGeneration));
+		return result;
+	}
+
+	void clear()
+	{
+		mImages.clear();
+	}
+
+	/**
+	 * Calls function(const Image&) for all cached images.
+	 */
+	template<class Function>
+	void forEachImage(Function function) const
+	{
+		for (auto& entry : mImages) function(entry.second.second);
+	}
+
+	size_t getImageCount() const
+	{
+		return mImages.size();
+	}
+
+private:
+
+	std::unordered_set<int> mWhitelist;
+
+	// Note: Generation 0 is never used by the script generations, so the whitelist is resolved on first use.
+	unsigned int mWhitelistGeneration = 0;
+
+	// <instance id, <script generation, image>>
+	std::unordered_map<int, std::pair<unsigned int, Image>> mImages;
+};
@@ -0,0 +1,74 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <LogFormat.h>
+#include <chrono>
+#include <mutex>
+#include <ctime>
+#include <cstdint>
+
+/**
+ * Provides the time stamps of log messages. A time stamp consists of the local wall clock time in seconds and
+ * a monotonic microsecond counter, which shows the order of messages and the time between them.
+ * The wall clock time is only converted and formatted once per second.
+ */
+class LogClock {
+public:
+
+	struct TimeStamp {
+		// local time in seconds since midnight
+		uint32_t secondsOfDay = 0;
+
+		// monotonic time since the clock was created
+		uint64_t microseconds = 0;
+
+		// secondsOfDay formatted by LogFormat::formatWallClock()
+		char wallClock[LogFormat::WALL_CLOCK_SIZE] = {};
+	};
+
+	LogClock();
+
+	/**
+	 * \return The current time.
+	 */
+	TimeStamp now();
+
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	const Clock::time_point mStart;
+
+	// guards the cached wall clock time
+	std::mutex mMutex;
+	time_t mCachedTime = -1;
+	uint32_t mCachedSecondsOfDay = 0;
+	char mCachedWallClock[LogFormat::WALL_CLOCK_SIZE] = {};
+};
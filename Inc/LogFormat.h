@@ -0,0 +1,245 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * Encoding of structured log messages, shared by the Logger and the offline log decoder. Thus this file
+ * mustn't depend on the engine or on Windows.
+ *
+ * A structured message consists of a format string and its arguments. Each '{}' in the format is replaced
+ * by the next argument. Arguments are encoded as a type tag followed by the raw value.
+ *
+ * Binary log file layout (all values in native x86 representation):
+ *   FILE_HEADER
+ *   records, each starting with a uint8 RecordType:
+ *     FORMAT:  uint32 format id, uint32 length, characters
+ *     MESSAGE: uint8 level (see Logger::LogLevel; 0 for Logger::logAlways), uint32 local time in seconds
+ *              since midnight, uint64 monotonic time in microseconds (see LogClock), uint32 format id,
+ *              uint32 argument size, encoded arguments
+ * A FORMAT record precedes all messages using its id. TEXT_FORMAT_ID is predefined and has the format "{}".
+ */
+class LogFormat {
+public:
+
+	struct FILE_HEADER {
+		char magic[6] = { 'N', 'E', 'C', 'L', 'O', 'G' };
+		uint16_t version = 2;
+	};
+
+	enum RecordType : uint8_t {
+		FORMAT = 1,
+		MESSAGE = 2,
+	};
+
+	enum ArgType : uint8_t {
+		INT = 'i',
+		UINT = 'u',
+		INT64 = 'I',
+		UINT64 = 'U',
+		DOUBLE = 'd',
+		STRING = 's',
+		POINTER = 'p',
+	};
+
+	enum : uint32_t {
+		// format id of preformatted text messages
+		TEXT_FORMAT_ID = 0,
+	};
+
+	enum : size_t {
+		// buffer size for formatWallClock()
+		WALL_CLOCK_SIZE = 16,
+	};
+
+	static void appendArg(std::string& out, int value) { appendValue(out, INT, static_cast<int32_t>(value)); }
+	static void appendArg(std::string& out, long value) { appendValue(out, INT, static_cast<int32_t>(value)); }
+	static void appendArg(std::string& out, unsigned value) { appendValue(out, UINT, static_cast<uint32_t>(value)); }
+	static void appendArg(std::string& out, unsigned long value) { appendValue(out, UINT, static_cast<uint32_t>(value)); }
+	static void appendArg(std::string& out, long long value) { appendValue(out, INT64, static_cast<int64_t>(value)); }
+	static void appendArg(std::string& out, unsigned long long value) { appendValue(out, UINT64, static_cast<uint64_t>(value)); }
+	static void appendArg(std::string& out, bool value) { appendValue(out, INT, static_cast<int32_t>(value)); }
+	static void appendArg(std::string& out, char value) { appendString(out, &value, 1); }
+	static void appendArg(std::string& out, float value) { appendValue(out, DOUBLE, static_cast<double>(value)); }
+	static void appendArg(std::string& out, double value) { appendValue(out, DOUBLE, value); }
+	static void appendArg(std::string& out, const std::string& value) { appendString(out, value.data(), value.size()); }
+
+	static void appendArg(std::string& out, const void* value) {
+		appendValue(out, POINTER, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+	}
+
+	static void appendArg(std::string& out, const char* value) {
+		if (!value) value = "(null)";
+		appendString(out, value, std::strlen(value));
+	}
+
+	/**
+	 * Encodes all arguments in order.
+	 */
+	template<class... Args>
+	static void appendArgs(std::string& out, const Args&... args) {
+		int expand[] = { 0, (appendArg(out, args), 0)... };
+		(void)expand;
+	}
+
+	/**
+	 * Formats a structured message.
+	 * \param format The format string.
+	 * \param args The encoded arguments.
+	 * \param out The message is appended to it. Missing arguments are printed as '{}', surplus arguments are ignored.
+	 * \return false if the arguments are malformed.
+	 */
+	static bool format(const std::string& format, const char* args, size_t size, std::string& out) {
+		const char* end = args + size;
+		size_t pos = 0;
+
+		while (true) {
+			const auto placeholder = format.find("{}", pos);
+			out.append(format, pos, placeholder == std::string::npos ? std::string::npos : placeholder - pos);
+			if (placeholder == std::string::npos) return true;
+
+			pos = placeholder + 2;
+			if (args == end) {
+				out += "{}";
+				continue;
+			}
+
+			if (!formatArg(args, end, out)) return false;
+		}
+	}
+
+	/**
+	 * \return The name of a log level as printed in text logs, e.g. "WARNING"; an empty string for unknown levels.
+	 */
+	static const char* getLevelName(int level) {
+		switch (level) {
+		case 1: return "INFO";
+		case 2: return "WARNING";
+		case 3: return "FAULT";
+		case 4: return "FATAL";
+		default: return "";
+		}
+	}
+
+	/**
+	 * Formats a wall clock time as "h:m:s", e.g. "13:5:42".
+	 * \param buffer Receives the formatted time. WALL_CLOCK_SIZE characters are sufficient.
+	 */
+	static void formatWallClock(uint32_t secondsOfDay, char* buffer, size_t size) {
+		snprintf(buffer, size, "%u:%u:%u", secondsOfDay / 3600, secondsOfDay / 60 % 60, secondsOfDay % 60);
+	}
+
+	/**
+	 * Appends the prefix of a text log line, e.g. "[13:5:42, 1042337us, INFO]    " (level 0: no level name).
+	 * \param wallClock The time as formatted by formatWallClock().
+	 * \param microseconds The monotonic time of the message (see LogClock).
+	 */
+	static void appendPrefix(std::string& out, const char* wallClock, int level, uint64_t microseconds) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), ", %lluus", static_cast<unsigned long long>(microseconds));
+
+		out += '[';
+		out += wallClock;
+		out += buffer;
+		if (level != 0) {
+			out += ", ";
+			out += getLevelName(level);
+		}
+		out += "]    ";
+	}
+
+	template<class T>
+	static void appendRaw(std::string& out, const T& value) {
+		out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	/**
+	 * Reads a raw value and advances 'current'.
+	 * \return false if not enough bytes are left.
+	 */
+	template<class T>
+	static bool readRaw(const char*& current, const char* end, T& value) {
+		if (static_cast<size_t>(end - current) < sizeof(T)) return false;
+		std::memcpy(&value, current, sizeof(T));
+		current += sizeof(T);
+		return true;
+	}
+
+private:
+
+	template<class T>
+	static void appendValue(std::string& out, ArgType type, const T& value) {
+		out += static_cast<char>(type);
+		appendRaw(out, value);
+	}
+
+	static void appendString(std::string& out, const char* str, size_t length) {
+		out += static_cast<char>(STRING);
+		appendRaw(out, static_cast<uint32_t>(length));
+		out.append(str, length);
+	}
+
+	template<class T>
+	static bool formatNumber(const char*& current, const char* end, const char* spec, std::string& out) {
+		T value;
+		if (!readRaw(current, end, value)) return false;
+
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), spec, value);
+		out += buffer;
+		return true;
+	}
+
+	static bool formatArg(const char*& current, const char* end, std::string& out) {
+		uint8_t type;
+		if (!readRaw(current, end, type)) return false;
+
+		switch (type) {
+		case INT: return formatNumber<int32_t>(current, end, "%d", out);
+		case UINT: return formatNumber<uint32_t>(current, end, "%u", out);
+		case INT64: return formatNumber<long long>(current, end, "%lld", out);
+		case UINT64: return formatNumber<unsigned long long>(current, end, "%llu", out);
+		case DOUBLE: return formatNumber<double>(current, end, "%g", out);
+		case POINTER: return formatNumber<unsigned long long>(current, end, "%08llX", out);
+		case STRING: {
+			uint32_t length;
+			if (!readRaw(current, end, length) || static_cast<size_t>(end - current) < length) return false;
+			out.append(current, length);
+			current += length;
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+};
@@ -0,0 +1,117 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <Logger.h>
+#include <string>
+#include <mutex>
+#include <chrono>
+
+/**
+ * Keeps messages that are logged very often (e.g. every frame or for every item) from flooding the log outputs:
+ * - Each call site (see Logger::CallSite) has a token bucket, which limits the rate of its messages.
+ *   Messages without a call site aren't rate limited.
+ * - A message equal to the previous one isn't logged again; instead the number of repeats is reported
+ *   ("last message repeated N times") once a different message arrives.
+ * Faults and fatal messages are never dropped.
+ */
+class LogLimiter {
+public:
+
+	/**
+	 * Repeats of a message, which were folded and have to be reported.
+	 */
+	struct Repeats {
+		Logger::LogLevel level = Logger::Info;
+
+		// 0: nothing to report
+		uint32_t count = 0;
+	};
+
+	/**
+	 * \param messagesPerSecond The rate at which the bucket of a call site refills. 0 disables rate limiting.
+	 * \param burst The capacity of the buckets, i.e. the number of messages a call site can log at once.
+	 * \param foldRepeats Should repeated messages be folded?
+	 */
+	LogLimiter(double messagesPerSecond, double burst, bool foldRepeats);
+
+	/**
+	 * Takes a token from the bucket of a call site.
+	 * \param suppressed Is set to the number of messages of the call site, that were dropped since its last
+	 * accepted message.
+	 * \return false if the message has to be dropped.
+	 */
+	bool acquire(Logger::CallSite& site, uint32_t& suppressed);
+
+	/**
+	 * Compares a message with the previous one.
+	 * \param formatId The format id of the message (see Logger::registerFormat()).
+	 * \param payload The message text or the encoded arguments of a structured message.
+	 * \param folded Is set to the repeats of the previous message, which have to be reported before this message.
+	 * \return true if the message repeats the previous one and has to be dropped.
+	 */
+	bool fold(Logger::LogLevel level, uint32_t formatId, const std::string& payload, Repeats& folded);
+
+	/**
+	 * \return The repeats of the last message, which weren't reported yet. They are considered as reported afterwards.
+	 */
+	Repeats takeRepeats();
+
+	/**
+	 * \return The text reporting folded repeats.
+	 */
+	static std::string getRepeatsMessage(const Repeats& repeats);
+
+	/**
+	 * \return The text reporting messages suppressed by the rate limit.
+	 */
+	static std::string getSuppressedMessage(uint32_t suppressed);
+
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	// Repeats are reported at least this often, even if the message doesn't change.
+	static constexpr std::chrono::seconds FOLD_INTERVAL{ 10 };
+
+	std::mutex mMutex;
+
+	double mMessagesPerSecond;
+	double mBurst;
+	bool mFoldRepeats;
+
+	// the previous message
+	Logger::LogLevel mLastLevel = Logger::Info;
+	uint32_t mLastFormatId = 0;
+	std::string mLastPayload;
+	bool mHasLast = false;
+
+	uint32_t mRepeatCount = 0;
+	Clock::time_point mFirstRepeat;
+};
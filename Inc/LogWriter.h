@@ -0,0 +1,166 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <Logger.h>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+
+/**
+ * Writes log messages to the log file on a background thread. Any thread can queue messages; they are kept
+ * in a lock-free bounded ring buffer (multiple producers, one consumer at a time) until the writer thread
+ * writes them in batches. The log file stays open while the writer exists.
+ * Note: Messages are written in queue order. If the ring buffer is full, producers wait for the writer.
+ */
+class LogWriter {
+public:
+
+	/**
+	 * Specifies when written messages are committed to disk.
+	 */
+	enum class FlushPolicy {
+		// The messages are only handed over to the OS after each batch.
+		Never,
+
+		// Each batch is committed to disk.
+		Batch,
+
+		// Only batches containing a Fatal message are committed to disk.
+		Fatal,
+	};
+
+	// number of ring buffer slots; a power of two
+	static constexpr size_t CAPACITY = 4096;
+
+	/**
+	 * \param filePath The log file. Messages are appended to it.
+	 */
+	LogWriter(const std::string& filePath, FlushPolicy policy);
+
+	/**
+	 * Writes all queued messages before the writer is destroyed.
+	 */
+	~LogWriter();
+
+	LogWriter(const LogWriter&) = delete;
+	LogWriter& operator=(const LogWriter&) = delete;
+
+	/**
+	 * Starts the writer thread. Until then, queued messages are written by the producer when the ring buffer
+	 * is full or flush() is called. The thread holds a reference to this module until it exits, so the module
+	 * isn't unloaded while the thread still runs its code.
+	 * Note: Mustn't be called from DllMain, as the thread can't start while the loader lock is held.
+	 */
+	void start();
+
+	/**
+	 * Queues a message.
+	 */
+	void push(Logger::LogLevel level, std::string message);
+
+	/**
+	 * Writes all queued messages on the calling thread and commits them to disk.
+	 */
+	void flush();
+
+	/**
+	 * Like flush(), but gives up if the file can't be acquired within a short time (e.g. as the writer thread
+	 * crashed while writing). Intended for crash handlers.
+	 */
+	void drain();
+
+	/**
+	 * Parses a flush policy ("never", "batch" or "fatal"; case insensitive).
+	 * \return The parsed policy or FlushPolicy::Batch, if the text isn't a valid policy.
+	 */
+	static FlushPolicy parseFlushPolicy(const std::string& text);
+
+private:
+
+	struct Entry {
+		Logger::LogLevel level = Logger::Info;
+		std::string message;
+	};
+
+	struct Cell {
+		std::atomic<size_t> sequence;
+		Entry entry;
+	};
+
+	static constexpr size_t MASK = CAPACITY - 1;
+	static constexpr std::chrono::milliseconds WRITE_INTERVAL{ 20 };
+
+	std::unique_ptr<Cell[]> mCells;
+
+	// next position to push to; shared by all producers
+	std::atomic<size_t> mEnqueuePos{ 0 };
+
+	// next position to pop from; only changed while mFileMutex is held
+	std::atomic<size_t> mDequeuePos{ 0 };
+
+	// guards the log file and the consumer side of the ring buffer
+	std::timed_mutex mFileMutex;
+	FILE* mFile = nullptr;
+	FlushPolicy mPolicy;
+
+	std::mutex mWakeMutex;
+	std::condition_variable mWake;
+	bool mWakeRequested = false;
+
+	std::atomic<bool> mStarted{ false };
+
+	// the writer thread (HANDLE) and the module it holds a reference to (HMODULE)
+	void* mThread = nullptr;
+	void* mModule = nullptr;
+	bool mStop = false;
+	bool mStopped = false;
+
+	bool tryPush(Entry& entry);
+	bool tryPop(Entry& entry);
+
+	/**
+	 * Writes all queued messages. mFileMutex has to be held.
+	 * \param commit Should the written messages be committed to disk regardless of the flush policy?
+	 */
+	void writePending(bool commit);
+
+	void requestWake();
+	void run();
+
+	/**
+	 * Entry point of the writer thread. Runs run() and exits with FreeLibraryAndExitThread, so that no code
+	 * of this module runs after the module reference is released.
+	 */
+	static unsigned long __stdcall threadMain(void* param);
+};
@@ -30,6 +30,15 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #define __LOGGER_H__
 #include <string>
 #include <sstream>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <LogFormat.h>
+#include <LogClock.h>
+
+class LogWriter;
+class LogLimiter;
 
 /**
  * Provides basic logging functionality to different streams. Currently supported:
@@ -72,6 +81,19 @@ public:
 		Fatal = 4
 	};
 
+	/**
+	 * Rate limiting state of a call site (see LogLimiter). The logging macros (e.g. UTIL_LOG) define one
+	 * per call site.
+	 */
+	struct CallSite {
+		double tokens = 0;
+		std::chrono::steady_clock::time_point lastRefill;
+
+		// messages dropped since the last accepted one
+		uint32_t suppressed = 0;
+		bool initialized = false;
+	};
+
 	/**
 	 * Default destructor.
 	 */
@@ -88,10 +110,23 @@ public:
 	static void release();
 
 	/**
-	 * Writes the given message 'message' to the log file.
+	 * Queues the given message 'message' for the log file. The file is written by a background thread
+	 * (see LogWriter); Fatal messages are written and committed before this function returns.
+	 * \param level The logging level for this log.
 	 * \param message The message to be logged.
 	 */
-	void writeToFile(const std::string& message);
+	void writeToFile(LogLevel level, const std::string& message);
+
+	/**
+	 * Writes all queued log file messages and commits them to disk.
+	 */
+	void flushFile();
+
+	/**
+	 * Starts writing the log file on a background thread (see LogWriter::start()).
+	 * Note: Mustn't be called from DllMain.
+	 */
+	void startFileWriter();
 
 	/**
 	 * Writes the given message 'message' to zSpy with and log level 'level'.
@@ -100,10 +135,18 @@ public:
 	 */
 	void writeTozSpy(LogLevel level, const std::string& message);
 
-	void writeToConsole(LogLevel level, const std::string& message);
+	/**
+	 * Writes a line created by createOutputWithLogLevel() to the console.
+	 */
+	void writeToConsole(const std::string& output);
 
 	bool isLogLevelActive(LogLevel level);
-	std::string createOutputWithLogLevel(LogLevel level, const std::string& message);
+
+	/**
+	 * \return The message with the time stamp and log level in front of it, e.g. "[13:5:42, 1042337us, INFO]    message".
+	 * \param level The log level or 0 for messages of logAlways() (no level is printed).
+	 */
+	std::string createOutputWithLogLevel(int level, const LogClock::TimeStamp& stamp, const std::string& message);
 	/**
 		 * Logs the content of the specified stringstream 'stream' with an log level 'level'. 
 		 * \param level The logging level for this log
@@ -111,13 +154,44 @@ public:
 		 * \param toFile Should the log message be written to file?
 		 * \param tozSpy Should the log message be written to zSpy?
 		 * \param toConsole Should the log message be written to console (std::cout)?
+		 * \param site The call site of the message; it is rate limited if not null.
 		 */
-	void log(LogLevel level, std::stringstream& stream);
+	void log(LogLevel level, std::stringstream& stream, CallSite* site = nullptr);
 
 	void logAlways(std::stringstream& stream);
 
+	/**
+	 * Registers the format string of a structured message (see UTIL_LOGF). In binary mode the format is written
+	 * to the log file once; messages only refer to its id.
+	 * \return The id of the format.
+	 */
+	uint32_t registerFormat(const char* format);
+
+	/**
+	 * Logs a structured message. Each '{}' in the format is replaced by the next argument (see LogFormat).
+	 * \param site The call site of the message; it is rate limited if not null.
+	 * \param formatId The id registerFormat() returned for the format.
+	 */
+	template<class... Args>
+	void logFormatted(LogLevel level, CallSite* site, uint32_t formatId, const char* format, const Args&... args) {
+		std::string encodedArgs;
+		LogFormat::appendArgs(encodedArgs, args...);
+		logEncoded(level, site, formatId, format, encodedArgs);
+	}
+
+	/**
+	 * \return The format string of the arguments of logFormatted() (used by UTIL_LOGF).
+	 */
+	template<class... Args>
+	static const char* getFormat(const char* format, const Args&...) {
+		return format;
+	}
+
 	std::string logLevelToString(LogLevel level);
 
+	/**
+	 * \return The current wall clock time, e.g. "13:5:42".
+	 */
 	std::string getTimeStamp();
 
 public:
@@ -138,7 +212,42 @@ private:
 	bool tozSpy; 
 	bool toConsole;
 
-	std::stringstream util;
+	LogClock clock;
+
+	std::unique_ptr<LogWriter> fileWriter;
+	bool binaryFile = false;
+	std::atomic<uint32_t> lastFormatId{ LogFormat::TEXT_FORMAT_ID };
+
+	// null if neither rate limiting nor folding of repeats is enabled
+	std::unique_ptr<LogLimiter> limiter;
+
+	void logEncoded(LogLevel level, CallSite* site, uint32_t formatId, const char* format, const std::string& args);
+
+	/**
+	 * Applies the rate limit of the call site and folds repeated messages. Reports of suppressed or folded
+	 * messages are logged before the message.
+	 * \param payload The message text or the encoded arguments of a structured message.
+	 * \return false if the message has to be dropped.
+	 */
+	bool admit(LogLevel level, CallSite* site, uint32_t formatId, const std::string& payload);
+
+	/**
+	 * Writes an unformatted text message to all outputs.
+	 */
+	void writeText(LogLevel level, const std::string& message);
+
+	/**
+	 * Writes a message to the console, the log file and zSpy, as configured.
+	 * \param fileRecord Writes the message to a binary log file as this record, if not null.
+	 */
+	void writeMessage(LogLevel level, const LogClock::TimeStamp& stamp, const std::string& message,
+		const std::string* fileRecord);
+
+	/**
+	 * Builds a MESSAGE record of the binary log file (see LogFormat).
+	 * \param level The log level or 0 for messages of logAlways().
+	 */
+	std::string createRecord(int level, const LogClock::TimeStamp& stamp, uint32_t formatId, const std::string& args);
 
 	/**
 	 * The address of the gothic 2 function zERROR::Report(int, int, zSTRING const &, signed char, UINT, int, char*, char*)
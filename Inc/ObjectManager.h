@@ -2,7 +2,7 @@
 
 This file is part of neclib.
 
-Copyright  2015-2020 David Goeth
+Copyright � 2015-2020 David Goeth
 
 All Rights reserved.
 
@@ -29,6 +29,10 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #pragma once
 
 #include "DynInstance.h"
+#include "DiiArchive.h"
+#include "SlotTable.h"
+#include "ProxyTable.h"
+#include "InitImageCache.h"
 #include <HookManager.h>
 #include <map>
 #include <queue>
@@ -37,7 +41,10 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #include <functional>
 #include "api/g2/ocnpcinventory.h"
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <vector>
+#include <atomic>
 
 /**
  * This class is responsible for managing DynInstance and AdditMemory objects.
@@ -83,13 +90,39 @@ public:
 
 	/**
 	 * Resolves proxying of an instance id.
+	 * Note: This function is called from the parser hooks. It doesn't allocate memory and 
+	 * exits early if no proxy exists.
 	 */
-	int resolveProxying(int instanceID) const;
+	inline int resolveProxying(int instanceID) const {
+		return mProxies.resolve(instanceID);
+	}
 
 	/**
 	 * Resolves proxying for symbol names.
+	 * Note: This function is called from the parser hooks. It doesn't allocate memory and
+	 * exits early if no proxy exists.
+	 * \return symbolName, if the symbol isn't proxied. Otherwise the name of the final proxy target.
 	 */
-	const char* resolveProxying(const zSTRING& symbolName) const;
+	inline const zSTRING& resolveProxying(const zSTRING& symbolName) const {
+		if (mProxiedNames.empty()) return symbolName;
+		auto it = mProxiedNames.find(&symbolName);
+		if (it == mProxiedNames.end()) return symbolName;
+		return getProxyTargetName(it->second, symbolName);
+	}
+
+	/**
+	 * Provides the current parser generation. The generation changes whenever the mapping
+	 * from symbol names to parser symbol indices might have changed (symbols were inserted,
+	 * proxies changed or the DIIs were released). Caches of resolved symbol indices are valid
+	 * only as long as the generation they were created with is the current one.
+	 * Note: Generation 0 is never used and can be used for marking caches as invalid.
+	 */
+	unsigned int getParserGeneration() const;
+
+	/**
+	 * Starts a new parser generation, i.e. invalidates all caches of resolved symbol indices.
+	 */
+	void invalidateParserCaches();
 
 	/**
 	 * \return the current instance of this class.
@@ -107,9 +140,32 @@ public:
 	static void __thiscall oCItemInitByScript (oCItem* item, int inst, int amount);
 
 	/**
-	 * \return The list of all oCMobContainers the current oCGame contains.
+	 * \return All oCMobContainers of the current world. The registry is built by a single scan of the vob list
+	 * after a world is loaded and kept up to date by the zCWorld::AddVob, zCWorld::AddVobAsChild,
+	 * oCWorld::RemoveVob and oCMobContainer destructor hooks.
 	 */
-	static std::list<oCMobContainer*> getMobContainers();
+	const std::unordered_set<oCMobContainer*>& getMobContainers();
+
+	/**
+	 * Checks the vtable of the vob, so that no RTTI name comparison is needed.
+	 * \return true if the vob is an oCMobContainer.
+	 */
+	static bool isMobContainer(zCVob* vob);
+
+	/**
+	 * Registers the vob if it is an oCMobContainer added to the world of the current game.
+	 */
+	void onVobAdded(zCWorld* world, zCVob* vob);
+
+	/**
+	 * Unregisters the vob if it is a registered oCMobContainer.
+	 */
+	void onVobRemoved(zCWorld* world, zCVob* vob);
+
+	/**
+	 * Unregisters a container which is destroyed.
+	 */
+	void onMobContainerDestroyed(oCMobContainer* container);
 
 	/**
 	 * \return true if a new instance could be created. Otherwise false.
@@ -124,6 +180,42 @@ public:
 			 */
 	int createNewInstanceId(oCItem* item, const std::string& instanceName);
 
+	/**
+	 * Creates a new instance with a generated name (see createNewInstanceId(oCItem*, const std::string&)).
+	 * \return The index of the new created zCPar_Symbol.
+	 */
+	int createNewInstanceId(oCItem* item);
+
+	/**
+	 * Creates a new instance with a generated name for each of the given items. All parser symbols are
+	 * inserted first and Ikarus is reinitialized only once.
+	 * \param items The items to use for instance creation. Null entries are skipped.
+	 * \param count The number of items.
+	 * \param instanceIds Receives the index of the new zCPar_Symbol for each item (0 if no instance was created).
+	 * Can be nullptr.
+	 * \return The number of created instances.
+	 */
+	int createInstances(oCItem* const* items, int count, int* instanceIds);
+
+	/**
+	 * Defers updateIkarusSymbols() and the new parser generation for symbol table changes until the
+	 * outermost batch ends. Use it for adding many symbols at once (e.g. when loading a savegame).
+	 * Note: Inserted symbols don't change the indices of existing symbols, so caches of resolved indices stay
+	 * valid within the batch; only names resolved before their symbol was inserted are outdated until it ends.
+	 */
+	class SymbolBatch {
+	public:
+		/**
+		 * \param symbolCount The number of symbols the batch is expected to add. The symbol table
+		 * is grown once for them (see reserveParserSymbols()).
+		 */
+		explicit SymbolBatch(int symbolCount = 0);
+		~SymbolBatch();
+
+		SymbolBatch(const SymbolBatch&) = delete;
+		SymbolBatch& operator=(const SymbolBatch&) = delete;
+	};
+
 	/**
 	 * Deletes a DII by its parser symbol table index.
 	 * \param parserSymbolIndex The parser symbol table index referring to the DII.
@@ -149,7 +241,16 @@ public:
 	
 	static void oCItemOperatorDelete(oCItem* item);
 
-	static bool assignInstanceId2(oCItem* item, int instanceIdParserSymbolIndex);
+	/**
+	 * Reinitializes an item with the fields of an instance (static or dynamic) and assigns the instance id
+	 * to it. The item keeps its stack amount. Dynamic instances are applied directly and whitelisted static
+	 * instances (see isInitCacheable()) from a cached item image (see getItemImage()). For other static
+	 * instances an item is created, so that their script runs.
+	 * \param item The item which should be assigned
+	 * \param instanceIdParserSymbolIndex The instance id the item should be assigned to.
+	 * \return Was the assignment successful?
+	 */
+	bool assignInstanceId2(oCItem* item, int instanceIdParserSymbolIndex);
 
 	/**
 	 * Provides the instance id of a given oCItem.
@@ -178,14 +279,23 @@ public:
 	 * Stores all new created instances at a directory described by 'directoryPath'. If the provided 
 	 * directory path doesn't exists, the directory structure will be created.
 	 * The Savegame will have the name defined by 'filename'.
+	 * If the directory contains the archive and journal written by the previous save, only instances and proxies
+	 * changed since then are appended to the journal 'journalFilename'. Otherwise or if the journal would exceed
+	 * Configuration::getDIIJournalCompactionSize(), the archive is rewritten and the journal is removed.
+	 * \param mirrorDirectoryPath A directory that receives the same changes (e.g. the 'current' savegame directory).
+	 * Ignored if empty or equal to 'directoryPath'.
+	 * Note: The instances are serialized immediately, but the files are written by the SaveWriter thread.
+	 * Use SaveWriter::wait() before reading the directories.
 	 */
-	void saveNewInstances(char* directoryPath, char* filename);
+	void saveNewInstances(const std::string& directoryPath, const std::string& filename, const std::string& journalFilename,
+		const std::string& mirrorDirectoryPath);
 
 	/**
-	 * Loads new instances from a file defined by filePath.
+	 * Loads new instances from a file defined by filePath and applies the journal written next to it.
 	 * \param filePath The path to the file to be loaded.
+	 * \param journalPath The path to the journal. A missing journal is ignored.
 	 */
-	void loadNewInstances(char* filePath);
+	void loadNewInstances(const std::string& filePath, const std::string& journalPath);
 
 	/**
 	 * Removes all new created instances and resets internal state.
@@ -283,13 +393,57 @@ public:
 
 	void updateIkarusSymbols();
 
+	/**
+	 * Calls updateIkarusSymbols() or defers the call if a SymbolBatch is active.
+	 */
+	void requestIkarusSymbolsUpdate();
+
 	void callForAllItems(bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param);
 	void callForAllNpcItems(bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param);
 	void callForAllContainerItems(bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param);
 	void callForAllWorldItems(bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param);
 
+	/**
+	 * Calls 'func' for all live items having the given instance id. Only the affected items are visited
+	 * (see the item index). Items for which 'func' returns true are put into their npc slot again,
+	 * if they are held in one.
+	 */
+	void callForItemsWithInstanceId(int instanceIdParserSymbolIndex, bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param);
+
+	/**
+	 * Updates the item index after the instance id of the item has been set.
+	 */
+	void onItemInstanceChanged(oCItem* item);
+
+	/**
+	 * Removes a destroyed item from the item index.
+	 */
+	void onItemDestroyed(oCItem* item);
+
+	/**
+	 * Marks the item index as outdated. It is rebuilt by a single scan of all items on the next lookup.
+	 * Has to be called whenever the engine loads a world, as it doesn't initialize unarchived items by script.
+	 */
+	void invalidateItemIndex();
+
+	/**
+	 * Invalidates the item index and the container registry. Has to be called whenever the engine loads a world.
+	 */
+	void onWorldChanged();
+
 	static int * getParserInstanceCount();
 
+	/**
+	 * \return The number of symbols the parser symbol table has memory for.
+	 */
+	static int getParserSymbolCapacity();
+
+	/**
+	 * Ensures that the parser symbol table can take 'count' more symbols without being reallocated.
+	 * The capacity grows geometrically, so that repeated reservations don't reallocate the table each time.
+	 */
+	void reserveParserSymbols(int count);
+
 	/**
 	* Checks whether the specified oCItem is in the game world's list registered
 	* \param item The oCItem to check
@@ -298,9 +452,9 @@ public:
 	static bool isItemInWorld(oCItem* item);
 
 	/**
-	 * Searches an oCItem by its instance id in the world, in all containers and all inventories.
+	 * Searches a live oCItem by its instance id (see the item index).
 	 * \param instanceId the instance id for searching the oCItem
-	 * \return The first oCItem found
+	 * \return Any oCItem with the instance id or nullptr.
 	 */
 	oCItem* getItemByInstanceId(int instanceIdParserSymbolIndex);
 
@@ -327,32 +481,151 @@ public:
 	*/
 	bool initByNewInstanceId(oCItem* item);
 
+	/**
+	 * Checks whether the script result of a static item instance may be cached. The instances are whitelisted
+	 * by Configuration::getDIIInitCacheInstances().
+	 */
+	bool isInitCacheable(int instanceIdParserSymbolIndex);
+
+	/**
+	 * Initializes an item of a static instance. Items of cacheable instances get the cached script result of
+	 * the current script generation, as the instance script would do. Otherwise the script runs, and the result
+	 * of cacheable instances is cached.
+	 * \param runScript Runs the instance script on the item; returns 0 on failure.
+	 * \return The result of the script or 1 if the cached result was applied.
+	 */
+	int initByCachedScript(int instanceIdParserSymbolIndex, oCItem* item, const std::function<int()>& runScript);
+
 private:
 
-	struct ARCHIVE_HEADER {
-	public:
+	/**
+	 * A slot of the DII table (see SlotTable). The slot is kept at 16 bytes (on x86), so that
+	 * a membership test is a bounds check plus a single load from one cache line.
+	 */
+	struct DynInstanceSlot {
+
+		enum Flags {
+			HAS_INSTANCE = 1 << 0,
+			HAS_SYMBOL = 1 << 1,
+		};
 
-		static constexpr float VERSION = 1.1f;
-		static constexpr const char DESC[] = "ARCHIVE_VERSION";
+		std::unique_ptr<DynInstance> instance;
+		zCPar_Symbol* symbol = nullptr;
+		int flags = 0;
+		int padding = 0;
+	};
 
-		ARCHIVE_HEADER() {
-			std::memcpy(desc, DESC, sizeof(DESC));
-		}
+	SlotTable<DynInstanceSlot> mSlots;
+	int mInstanceCount = 0;
 
-		char desc[sizeof(DESC)];
-		float version = VERSION;
+	unsigned int mParserGeneration = 1;
+
+	// Hashes and compares the names zSTRING pointers point to. Maps keyed with them don't own
+	// any zSTRING (zSTRING has no destructor on our side) and allow lookups with any zSTRING
+	// without copying or converting it.
+	template<typename Hasher>
+	struct SymbolNameHasher {
+		size_t operator()(const zSTRING* name) const { return Hasher()(*name); }
 	};
 
-	// <int instanceId, Item* item>
-	std::unordered_map<int, std::unique_ptr<DynInstance>> mNewInstanceMap;
-	std::unordered_map<int, zCPar_Symbol*> mNewInstanceToSymbolMap;
-	std::unordered_map<std::string, zCPar_Symbol*> mNameToSymbolMap;
-	std::unordered_map<std::string, int> mNameToInstanceMap;
+	template<typename Equal>
+	struct SymbolNameEqual {
+		bool operator()(const zSTRING* a, const zSTRING* b) const { return Equal()(*a, *b); }
+	};
 
-	std::map<int, int> mProxies;
+	// <symbol name (case insensitive), parser symbol index>
+	// Note: The keys point to the names of the DII parser symbols.
+	std::unordered_map<const zSTRING*, int, SymbolNameHasher<zSTRING_CaseInsensitiveHasher>,
+		SymbolNameEqual<zSTRING_CaseInsensitiveEqual>> mNameToInstanceMap;
+
+	// Proxy changes within a SymbolBatch rebuild the resolved table only once at the end of the batch.
+	ProxyTable mProxies;
 	std::unordered_map<std::string, std::string> mProxiesNames;
 	std::unordered_map<std::string, int> mUnresolvedNamesToInstances;
 
+	// <name of a proxied source symbol, source instance id>
+	// Note: The keys point to the names of the source parser symbols.
+	std::unordered_map<const zSTRING*, int, SymbolNameHasher<zSTRING_Hasher>,
+		SymbolNameEqual<std::equal_to<zSTRING>>> mProxiedNames;
+
+	// The generation of the instance scripts: changes when the script an instance id runs might have
+	// changed, i.e. when the DIIs are released (the parser is reloaded with a savegame) and when proxies
+	// change. Unlike the parser generation, it doesn't change when symbols are inserted.
+	// Note: Generation 0 is never used.
+	unsigned int mScriptGeneration = 1;
+
+	/**
+	 * Starts a new script generation, i.e. invalidates the item and init images.
+	 */
+	void invalidateScriptCaches();
+
+	struct CachedItemImage {
+		unsigned int scriptGeneration = 0;
+		DynInstance::ItemImage image;
+		int next = 0;
+	};
+
+	// <instance id, fields of an item created from the instance>; see getItemImage().
+	// The images hold StringPool handles and are released with the instances.
+	std::unordered_map<int, CachedItemImage> mItemImages;
+
+	/**
+	 * Provides the fields an item gets from a static instance. The fields are captured from an item created
+	 * once per instance and script generation; later calls don't run the instance script anymore. Thus
+	 * assignInstanceId2() only uses it for instances whitelisted by isInitCacheable().
+	 * \return The cached image or nullptr, if no item could be created from the instance.
+	 */
+	const CachedItemImage* getItemImage(int instanceIdParserSymbolIndex);
+
+	/**
+	 * Provides the fields of a prototype instance, which the first DII of the prototype shares as its
+	 * prototype image (see DynInstance::setPrototype()). Static prototypes provide their script image
+	 * (see getItemImage()), dynamic prototypes their stored fields.
+	 * \return false, if no item could be created from the instance.
+	 */
+	bool getPrototypeFieldImage(int instanceIdParserSymbolIndex, DynInstance::FieldImage& image);
+
+	// The fields set by the scripts of whitelisted instances; see initByCachedScript(). Like mItemImages,
+	// the images are valid for the script generation they were stored in.
+	InitImageCache<DynInstance::ItemImage> mInitImages;
+
+	/**
+	 * Resolves the whitelist of mInitImages for the current script generation.
+	 */
+	void resolveInitCacheInstances();
+
+	bool mProxiesDirty = false;
+
+	// Reverse index of the live items: <instance id, items> and <item, instance id it is indexed with>.
+	// Kept current by the oCItem::InitByScript and destructor hooks and by setInstanceId().
+	std::unordered_map<int, std::unordered_set<oCItem*>> mItemsByInstance;
+	std::unordered_map<oCItem*, int> mItemInstances;
+	bool mItemIndexValid = false;
+
+	// see getMobContainers()
+	std::unordered_set<oCMobContainer*> mMobContainers;
+	bool mMobContainersValid = false;
+
+	// Generated instance names are 'DII_*<number>*'. Numbers are handed out by a monotonic counter; numbers
+	// of names that weren't used are reused first. Both are stored in the savegame, so that a loaded game
+	// generates the same names.
+	uint32_t mNextGeneratedName = 0;
+	std::vector<uint32_t> mFreeGeneratedNames;
+
+	// see SymbolBatch
+	int mSymbolBatchDepth = 0;
+	bool mIkarusUpdatePending = false;
+	bool mParserCachesPending = false;
+
+	// The archive and journal written by the last save. A checksum of 0 means that there is no such archive
+	// and the next save has to write the complete archive.
+	uint32_t mBaseChecksum = 0;
+	long long mBaseSize = 0;
+	long long mJournalSize = 0;
+
+	// set by the SaveWriter thread if writing the files failed
+	std::atomic<bool> mSaveFailed{ false };
+
 	std::stringstream mLogStream;
 
 	static std::unique_ptr<ObjectManager> mInstance;
@@ -368,6 +641,18 @@ private:
 	 */
 	void logSymbolData(zCPar_Symbol* sym);
 
+	/**
+	 * Logs (debug only) how many bytes the text fields of all DIIs occupy with and without string pooling.
+	 */
+	void logStringMemoryReport();
+
+	/**
+	 * Releases the interned strings no DII and no cached item image refers to anymore, if enough strings
+	 * were interned since the last collection (see StringPool::isCollectionDue()).
+	 * Note: Mustn't be called while pool handles are held outside of the DIIs and the caches.
+	 */
+	void collectStrings();
+
 	/**
 	 * Creates a zCPar_Symbol from a ParserInfo object and adds it to the parser.
 	 * @return: The index of the new created zCPar_Symbol into the symbol table of the parser.
@@ -375,6 +660,87 @@ private:
 	int createParserSymbol(const ParserInfo& info);
 
 	zCPar_Symbol * createNewInstanceSymbol(int instanceParserSymbolID, zCPar_Symbol * prototype, const std::string& symbolName) const;
+
+	/**
+	 * \return The slot of the given parser symbol index or nullptr if the index lies outside of the DII slot table.
+	 */
+	DynInstanceSlot* getSlot(int parserSymbolIndex);
+
+	/**
+	 * Provides the slot of the given parser symbol index. The slot table is grown if necessary.
+	 */
+	DynInstanceSlot& acquireSlot(int parserSymbolIndex);
+
+	/**
+	 * Registers a DII parser symbol in the slot table and the name lookup.
+	 */
+	void registerSymbol(int parserSymbolIndex, zCPar_Symbol* symbol);
+
+	/**
+	 * Rebuilds the resolved proxy table or defers the rebuild if a SymbolBatch is active.
+	 */
+	void requestProxyTablesRebuild();
+
+	/**
+	 * Calls invalidateParserCaches() for inserted symbols or defers the call if a SymbolBatch is active.
+	 */
+	void requestParserCachesInvalidation();
+
+	/**
+	 * Provides the name of the final proxy target of a proxied source instance.
+	 * \return The name of the target's parser symbol or fallback if the symbol doesn't exist.
+	 */
+	const zSTRING& getProxyTargetName(int sourceInstanceID, const zSTRING& fallback) const;
+
+	/**
+	 * Builds a version 2 archive of all stored instances and proxies in memory.
+	 */
+	void writeArchive(ArchiveWriter& archive);
+
+	/**
+	 * Builds a journal entry of all dirty instances (and the proxies, if they are dirty) in memory.
+	 * \return false if nothing changed since the last save.
+	 */
+	bool writeJournalEntry(ArchiveWriter& entry);
+
+	/**
+	 * Creates the parser symbol of a loaded instance and registers the instance.
+	 */
+	void loadInstance(std::unique_ptr<DynInstance> instance);
+
+	/**
+	 * Creates the parser symbol of a loaded proxy (if necessary) and registers the proxy.
+	 */
+	void loadProxy(const std::string& sourceInstanceName, const std::string& targetInstanceName);
+
+	/**
+	 * Rebuilds the item index from all items in the world, in containers and in npc inventories.
+	 */
+	void rebuildItemIndex();
+
+	/**
+	 * Puts the given items into their npc slot again, if they are held in one.
+	 */
+	void refreshNpcSlotItems(const std::unordered_set<oCItem*>& items);
+
+	/**
+	 * Restores the name allocator of a loaded archive. For archives without a name allocator block
+	 * the counter continues after the highest generated name number of the loaded instances.
+	 */
+	void loadNameAllocator(const DiiArchive::LoadedArchive& archive);
+
+	/**
+	 * Hands out the number of the next generated instance name. Numbers whose name is already used
+	 * by a parser symbol (e.g. random names of older savegames) are skipped.
+	 */
+	uint32_t allocateGeneratedName();
+
+	static std::string getGeneratedName(uint32_t number);
+
+	/**
+	 * \return Is the name a generated instance name? If so, 'number' receives its number.
+	 */
+	static bool parseGeneratedName(const std::string& name, uint32_t& number);
 };
 
 
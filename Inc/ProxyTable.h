@@ -0,0 +1,103 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <cstddef>
+
+/**
+ * The proxies between parser symbol indices (source instance -> target instance) and a path compressed
+ * table for resolving them: the resolved table maps every source to the final target of its proxy chain,
+ * so resolving is a bounds check plus one load. The parser hooks resolve instance ids many times per frame.
+ * Changes mark the table pending; until rebuild() is called the chains are resolved by walking the proxies.
+ * This allows to add many proxies (e.g. while loading a savegame) with a single rebuild.
+ */
+class ProxyTable {
+public:
+
+	/**
+	 * \return The final target of the proxy chain of the given instance or the instance itself if it isn't proxied.
+	 */
+	inline int resolve(int instanceID) const {
+		if (mPending) return resolveChain(instanceID);
+		if (static_cast<unsigned int>(instanceID) >= mResolved.size()) return instanceID;
+		return mResolved[instanceID];
+	}
+
+	/**
+	 * Resolves a proxy chain by walking the proxies.
+	 */
+	int resolveChain(int instanceID) const;
+
+	/**
+	 * \return Would a proxy from source to target close a cycle, i.e. does the chain of target lead to source?
+	 */
+	bool wouldCreateCycle(int sourceInstanceID, int targetInstanceID) const;
+
+	/**
+	 * Adds a proxy. The caller ensures that the source isn't proxied yet and that the proxy doesn't
+	 * create a cycle (see wouldCreateCycle()).
+	 */
+	void add(int sourceInstanceID, int targetInstanceID);
+
+	/**
+	 * Removes the proxy of the given source.
+	 * \return false, if the source isn't proxied.
+	 */
+	bool remove(int sourceInstanceID);
+
+	/**
+	 * Removes all proxies.
+	 */
+	void clear();
+
+	/**
+	 * Rebuilds the resolved table from the proxies.
+	 */
+	void rebuild();
+
+	/**
+	 * \return Was a proxy added or removed since the last rebuild?
+	 */
+	bool isPending() const;
+
+	bool empty() const;
+	size_t size() const;
+
+private:
+
+	// <source instance id, target instance id>; ordered, so the last entry has the highest source id
+	std::map<int, int> mProxies;
+
+	// mResolved[sourceID] is the final target of the proxy chain (or sourceID if it isn't proxied).
+	// It is empty if no proxy exists.
+	std::vector<int> mResolved;
+	bool mPending = false;
+};
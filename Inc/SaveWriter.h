@@ -0,0 +1,109 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <sstream>
+
+/**
+ * Executes the file operations of savegames on a background thread, so that the frame triggering
+ * a save doesn't wait for the disk. The savegame content is serialized into memory by the main thread
+ * and written by jobs, which are executed in submission order.
+ * Every job names the directories it touches; wait() is the barrier for code that reads these directories.
+ * Note: Jobs mustn't use the logger, as it isn't thread safe. Exceptions thrown by jobs are logged
+ * by the main thread on the next call of submit() or wait().
+ */
+class SaveWriter {
+public:
+
+	using Job = std::function<void()>;
+
+	SaveWriter();
+
+	/**
+	 * Executes all pending jobs before the writer is destroyed.
+	 */
+	~SaveWriter();
+
+	/**
+	 * \return The current instance of this class.
+	 */
+	static SaveWriter* getSaveWriter();
+
+	static void release();
+
+	/**
+	 * Queues a job. The writer thread is started on the first submission.
+	 * \param directories The directories the job writes to.
+	 */
+	void submit(std::vector<std::string> directories, Job job);
+
+	/**
+	 * Blocks until all jobs writing to the given directory are done.
+	 */
+	void wait(const std::string& directory);
+
+private:
+
+	struct Task {
+		std::vector<std::string> directories;
+		Job job;
+	};
+
+	std::mutex mMutex;
+	std::condition_variable mTaskAvailable;
+	std::condition_variable mTaskDone;
+	std::deque<Task> mTasks;
+
+	// <directory, number of queued or running jobs writing to it>
+	std::unordered_map<std::string, int> mPending;
+
+	// error messages of failed jobs; logged by the main thread
+	std::vector<std::string> mErrors;
+
+	std::thread mThread;
+	bool mStop = false;
+	bool mStopped = false;
+
+	std::stringstream mLogStream;
+
+	static std::unique_ptr<SaveWriter> mInstance;
+
+	void run();
+	void execute(Task& task);
+	void logErrors();
+};
@@ -0,0 +1,113 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+/**
+ * A dense table of slots addressed by parser symbol index. DII parser symbol indices are dense and
+ * mostly appended to the symbol table, so slot 'index - firstIndex' of a vector is used instead of
+ * a hash map: a lookup is a single bounds check plus one load, and iterating visits contiguous memory.
+ * Slots must be default constructible and movable; unused slots stay default constructed.
+ */
+template<class Slot>
+class SlotTable {
+public:
+
+	using iterator = typename std::vector<Slot>::iterator;
+	using const_iterator = typename std::vector<Slot>::const_iterator;
+
+	/**
+	 * \return The slot of the given index or nullptr if the index lies outside of the table.
+	 */
+	Slot* get(int index)
+	{
+		// Note: The unsigned cast maps indices below mFirstIndex to huge values, so one comparison suffices.
+		const unsigned int slotIndex = static_cast<unsigned int>(index - mFirstIndex);
+		if (slotIndex >= mSlots.size()) return nullptr;
+		return &mSlots[slotIndex];
+	}
+
+	const Slot* get(int index) const
+	{
+		return const_cast<SlotTable*>(this)->get(index);
+	}
+
+	/**
+	 * Provides the slot of the given index. The table is grown if necessary.
+	 */
+	Slot& acquire(int index)
+	{
+		if (mSlots.empty()) {
+			mFirstIndex = index;
+		}
+		else if (index < mFirstIndex) {
+			// DIIs are usually appended to the symbol table, so this is the rare case.
+			const auto shift = static_cast<size_t>(mFirstIndex - index);
+			std::vector<Slot> grown(mSlots.size() + shift);
+			std::move(mSlots.begin(), mSlots.end(), grown.begin() + shift);
+			mSlots.swap(grown);
+			mFirstIndex = index;
+		}
+
+		const auto slotIndex = static_cast<size_t>(index - mFirstIndex);
+		if (slotIndex >= mSlots.size()) {
+			mSlots.resize(slotIndex + 1);
+		}
+
+		return mSlots[slotIndex];
+	}
+
+	/**
+	 * \return The index of the first slot.
+	 */
+	int getFirstIndex() const { return mFirstIndex; }
+
+	size_t size() const { return mSlots.size(); }
+	bool empty() const { return mSlots.empty(); }
+
+	void clear()
+	{
+		mSlots.clear();
+		mFirstIndex = 0;
+	}
+
+	iterator begin() { return mSlots.begin(); }
+	iterator end() { return mSlots.end(); }
+	const_iterator begin() const { return mSlots.begin(); }
+	const_iterator end() const { return mSlots.end(); }
+
+private:
+
+	// slot index = index - mFirstIndex
+	std::vector<Slot> mSlots;
+	int mFirstIndex = 0;
+};
@@ -0,0 +1,132 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+/**
+ * A pool of interned strings. Equal strings are stored only once and referenced by 32-bit handles.
+ * DIIs created from the same prototype share most of their text fields, so storing handles instead
+ * of std::string members keeps the memory footprint of large DII populations small.
+ * Note: Interned strings live until the pool is cleared or a collection finds them unused (see beginCollection()).
+ */
+class StringPool {
+public:
+
+	using Handle = unsigned int;
+
+	/**
+	 * The handle of the empty string. It is always valid.
+	 */
+	static constexpr Handle EMPTY = 0;
+
+	StringPool();
+
+	/**
+	 * \return The current instance of this class.
+	 */
+	static StringPool* getStringPool();
+
+	/**
+	 * Provides the handle of the given string. If the string isn't interned yet, it will be added to the pool.
+	 */
+	Handle intern(const std::string& str);
+	Handle intern(const char* str);
+
+	/**
+	 * Provides the string referenced by a handle. The reference stays valid until the pool is cleared.
+	 * An invalid handle resolves to the empty string.
+	 */
+	const std::string& resolve(Handle handle) const;
+
+	const char* c_str(Handle handle) const;
+
+	/**
+	 * Removes all interned strings. All handles except EMPTY get invalid.
+	 */
+	void clear();
+
+	/**
+	 * Starts a collection of unused strings. Afterwards all handles still in use have to be marked;
+	 * sweep() then releases the other strings. Their handles get invalid and are reused by intern().
+	 */
+	void beginCollection();
+
+	/**
+	 * Marks a handle as used during a collection.
+	 */
+	void mark(Handle handle);
+
+	/**
+	 * Releases all strings which weren't marked since beginCollection().
+	 * \return The number of released strings.
+	 */
+	size_t sweep();
+
+	/**
+	 * \return Has the pool grown enough since the last collection, that a new collection is worthwhile?
+	 */
+	bool isCollectionDue() const;
+
+	/**
+	 * \return The number of interned strings.
+	 */
+	size_t getSize() const;
+
+	/**
+	 * \return The (approximated) number of bytes occupied by the pool.
+	 */
+	size_t getByteSize() const;
+
+	/**
+	 * \return The (approximated) number of bytes an unpooled std::string with the given content would occupy.
+	 */
+	static size_t getUnpooledByteSize(const std::string& str);
+
+private:
+	// Strings interned since the last collection, before a new collection is due; at least the number
+	// of strings which survived the last collection.
+	static constexpr size_t MIN_COLLECTION_GROWTH = 4096;
+
+	std::unordered_map<std::string, Handle> mLookup;
+
+	// handle -> string; the strings are owned by the (node based) lookup map. Released handles are null.
+	std::vector<const std::string*> mStrings;
+	std::vector<Handle> mFreeHandles;
+
+	// collection state
+	std::vector<bool> mMarks;
+	size_t mSizeAfterCollection = 0;
+	size_t mInternedSinceCollection = 0;
+
+	static std::unique_ptr<StringPool> mInstance;
+};
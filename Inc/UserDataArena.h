@@ -0,0 +1,114 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstddef>
+
+/**
+ * Hands out the memory blocks of DII user data (see DII_UserData). All user data blocks of a script session
+ * have the same size, as they are defined by DII_USER_DATA_INTEGER_AMOUNT and DII_USER_DATA_STRING_AMOUNT.
+ * Blocks are carved from contiguous chunks and released blocks are reused through a free list, so that
+ * creating and releasing many DIIs doesn't fragment the 32-bit address space of the game.
+ * Note: The arena only manages raw memory; owners have to release the content of a block (e.g. zSTRINGs)
+ * before returning it.
+ */
+class UserDataArena {
+public:
+
+	/**
+	 * The (approximated) size of a chunk. Blocks larger than a chunk get a chunk of their own.
+	 */
+	static constexpr size_t CHUNK_BYTE_SIZE = 64 * 1024;
+
+	UserDataArena();
+
+	/**
+	 * \return The current instance of this class.
+	 */
+	static UserDataArena* getUserDataArena();
+
+	static void release();
+
+	/**
+	 * Provides a zero initialized block of the given size.
+	 */
+	void* allocate(size_t size);
+
+	/**
+	 * Returns a block to the arena.
+	 * \param size The size the block was allocated with.
+	 */
+	void deallocate(void* block, size_t size);
+
+	/**
+	 * Frees the chunks of all block sizes which have no allocated blocks.
+	 */
+	void trim();
+
+	/**
+	 * \return The number of blocks currently handed out.
+	 */
+	size_t getAllocatedBlockCount() const;
+
+	/**
+	 * \return The number of bytes occupied by the chunks.
+	 */
+	size_t getByteSize() const;
+
+private:
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	struct SizeClass {
+		std::vector<std::unique_ptr<char[]>> chunks;
+		size_t chunkByteSize = 0;
+
+		// unused part of the last chunk
+		char* cursor = nullptr;
+		char* end = nullptr;
+
+		FreeBlock* freeList = nullptr;
+		size_t allocatedBlocks = 0;
+	};
+
+	// <block size, size class>
+	std::unordered_map<size_t, SizeClass> mSizeClasses;
+
+	static std::unique_ptr<UserDataArena> mInstance;
+
+	/**
+	 * Rounds a requested size up to a block size which is able to hold a free list entry.
+	 */
+	static size_t getBlockSize(size_t size);
+};
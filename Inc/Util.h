@@ -40,6 +40,72 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 
 #define UTIL_GET_SYMBOL_WITH_CHECKS(x) util::getSymbolWithChecks(x, __FUNCTION__)
 
+/**
+ * The minimum level of UTIL_LOG messages compiled into the module. Release builds also compile out
+ * all UTIL_DEBUG messages. Define it in the project settings to override the default.
+ */
+#ifndef UTIL_MIN_LOG_LEVEL
+#ifdef NDEBUG
+#define UTIL_MIN_LOG_LEVEL Logger::Warning
+#else
+#define UTIL_MIN_LOG_LEVEL Logger::Info
+#endif
+#endif
+
+/**
+ * Logs a message like util::logInfo() etc., but the message is only formatted if its level is active.
+ * The messages of each call site are rate limited (see LogLimiter).
+ * Usage: UTIL_LOG(Logger::Warning, mLogStream, __FUNCTION__ << ": value = " << value << std::endl);
+ */
+#define UTIL_LOG(level, stream, ...)                                              \
+	do {                                                                          \
+		if ((level) >= UTIL_MIN_LOG_LEVEL && util::isLogLevelActive(level)) {    \
+			static Logger::CallSite utilSite;                                     \
+			(stream) << __VA_ARGS__;                                              \
+			Logger::getLogger()->log(level, stream, &utilSite);                   \
+		}                                                                         \
+	} while (0)
+
+/**
+ * Logs a message like util::debug(), but the message is only formatted if debugging and its level are active.
+ */
+#define UTIL_DEBUG(level, stream, ...)                                            \
+	do {                                                                          \
+		if (Logger::Info >= UTIL_MIN_LOG_LEVEL && util::isDebugLogActive(level)) { \
+			static Logger::CallSite utilSite;                                     \
+			(stream) << __VA_ARGS__;                                              \
+			Logger::getLogger()->log(level, stream, &utilSite);                   \
+		}                                                                         \
+	} while (0)
+
+/**
+ * Logs a structured message like UTIL_LOG: Each '{}' in the format string is replaced by the next argument.
+ * The format is registered once per call site, so that binary log files only store its id and the raw arguments.
+ * Usage: UTIL_LOGF(Logger::Warning, "{}: value = {}\n", __FUNCTION__, value);
+ */
+#define UTIL_LOGF(level, ...)                                                     \
+	do {                                                                          \
+		if ((level) >= UTIL_MIN_LOG_LEVEL && util::isLogLevelActive(level)) {    \
+			static const uint32_t utilFormatId =                                  \
+				Logger::getLogger()->registerFormat(Logger::getFormat(__VA_ARGS__)); \
+			static Logger::CallSite utilSite;                                     \
+			Logger::getLogger()->logFormatted(level, &utilSite, utilFormatId, __VA_ARGS__); \
+		}                                                                         \
+	} while (0)
+
+/**
+ * Logs a structured message like UTIL_DEBUG (see UTIL_LOGF).
+ */
+#define UTIL_DEBUGF(level, ...)                                                   \
+	do {                                                                          \
+		if (Logger::Info >= UTIL_MIN_LOG_LEVEL && util::isDebugLogActive(level)) { \
+			static const uint32_t utilFormatId =                                  \
+				Logger::getLogger()->registerFormat(Logger::getFormat(__VA_ARGS__)); \
+			static Logger::CallSite utilSite;                                     \
+			Logger::getLogger()->logFormatted(level, &utilSite, utilFormatId, __VA_ARGS__); \
+		}                                                                         \
+	} while (0)
+
 #define LEGO_HOOKENGINE_PREAMBLE __asm      \
 /* Port output */         \
 {                         \
@@ -228,15 +294,6 @@ public:
 	 */
 	static void split(std::vector<std::string> &tokens, const std::string &text, char sep);
 
-	/**
-	 * Copies all files from a specified source path which additionally begin with the pattern
-	 * 'pattern' and moves the result to the destination folder 'dest'.
-	 * \param source The directory to copy from
-	 * \param des The directory to copy to
-	 * \param pattern Only files, which names begin with this pattern, will be treated.
-	 */
-	static void copyContentTo(std::string source, std::string dest, std::string pattern);
-
 	/**
 	 * Deletes all files from the folder 'folder' which begin with the pattern 'pattern'.
 	 * \param folder The directory to delete the files from.
@@ -245,11 +302,23 @@ public:
 	static void deleteAllFiles(std::string folder, std::string pattern);
 
 	/**
-	 * Copies a file and moves its copy to a specified destination.
-	 * \param from The file to be copied.
-	 * \param to The file path the file should be copied to.
+	 * Reads the whole content of a file with a single read call.
+	 * \param path The file to read.
+	 * \param content Receives the file content.
+	 * \return Could the file be read?
+	 */
+	static bool readFile(const std::string& path, std::vector<char>& content);
+
+	/**
+	 * Writes (or appends) a memory block to a file with a single write call.
+	 * Throws an std::ios_base::failure if the file couldn't be written.
 	 */
-	static void copyFileTo(std::string from, std::string to);
+	static void writeFile(const std::string& path, const char* data, size_t size, bool append = false);
+
+	/**
+	 * \return The size of a file in bytes or -1 if the file doesn't exist.
+	 */
+	static long long getFileSize(const std::string& path);
 
 	/**
 	 * Takes the address of an pointer and deletes the pointer and sets its content to NULL.
@@ -362,6 +431,16 @@ public:
 
 	static void debug(std::stringstream& ss, Logger::LogLevel level = Logger::Info);
 
+	/**
+	 * \return Are messages of the given level logged? (see UTIL_LOG)
+	 */
+	static bool isLogLevelActive(Logger::LogLevel level);
+
+	/**
+	 * \return Are debug messages of the given level logged? (see UTIL_DEBUG)
+	 */
+	static bool isDebugLogActive(Logger::LogLevel level);
+
 	static std::string trimFromRight(const std::string&);
 	static void readString(std::istream& is, std::string& data);
     static void readzSTRING(std::istream& is, zSTRING& data);
@@ -391,20 +470,6 @@ public:
 
 	static void callDaedalusFunction_Int2(std::string functionName, int first, int second, bool isExternal);
 
-    template<class T>
-    static std::list<T*> create(zCListSort<T>* zclist) {
-
-        std::list<T*> result;
-        while (zclist != NULL) {
-            auto* item = zclist->GetData();
-            if (item != NULL) result.push_back(item);
-
-            zclist = zclist->GetNext();
-        }
-
-        return result;
-    }
-
 private:
 	util() {};
 	~util() {};
@@ -0,0 +1,148 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+template<class T> class zCArray;
+template<class T> class zCList;
+template<class T> class zCListSort;
+
+/** Forward iterator over the elements of a zCList or zCListSort. Nodes without data
+* (e.g. the head node of the engine's lists) are skipped.
+*/
+template<class Node, class T>
+class zCListIterator
+{
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef T* value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef T** pointer;
+	typedef T* reference;
+
+	zCListIterator() : node(NULL) {};
+
+	explicit zCListIterator(Node* node) : node(node)
+	{
+		SkipEmpty();
+	};
+
+	T* operator*() const { return node->data; };
+
+	zCListIterator& operator++()
+	{
+		node = node->next;
+		SkipEmpty();
+		return *this;
+	};
+
+	zCListIterator operator++(int)
+	{
+		zCListIterator result = *this;
+		++*this;
+		return result;
+	};
+
+	bool operator==(const zCListIterator& other) const { return node == other.node; };
+	bool operator!=(const zCListIterator& other) const { return node != other.node; };
+
+private:
+	Node* node;
+
+	void SkipEmpty()
+	{
+		while (node && !node->data) node = node->next;
+	};
+};
+
+/** A pair of iterators usable in range based for loops.
+*/
+template<class Iterator>
+class zCRange
+{
+public:
+	zCRange(Iterator first, Iterator last) : first(first), last(last) {};
+
+	Iterator begin() const { return first; };
+	Iterator end() const { return last; };
+
+private:
+	Iterator first;
+	Iterator last;
+};
+
+/** Iterates over the elements of an engine list without copying it, e.g.
+* for (oCItem* item : zRange(world->GetItemList())) {...}
+* The list mustn't be modified while iterating; use zSnapshot() in that case.
+*/
+template<class T>
+inline zCRange<zCListIterator<zCListSort<T>, T>> zRange(zCListSort<T>* list)
+{
+	typedef zCListIterator<zCListSort<T>, T> Iterator;
+	return zCRange<Iterator>(Iterator(list), Iterator());
+};
+
+template<class T>
+inline zCRange<zCListIterator<zCList<T>, T>> zRange(zCList<T>* list)
+{
+	typedef zCListIterator<zCList<T>, T> Iterator;
+	return zCRange<Iterator>(Iterator(list), Iterator());
+};
+
+template<class T>
+inline zCRange<T*> zRange(zCArray<T>& array)
+{
+	return zCRange<T*>(array.begin(), array.end());
+};
+
+/** Copies the elements of an engine container. Use it instead of zRange() if the container
+* might be modified while iterating.
+*/
+template<class T>
+inline std::vector<T*> zSnapshot(zCListSort<T>* list)
+{
+	auto range = zRange(list);
+	return std::vector<T*>(range.begin(), range.end());
+};
+
+template<class T>
+inline std::vector<T*> zSnapshot(zCList<T>* list)
+{
+	auto range = zRange(list);
+	return std::vector<T*>(range.begin(), range.end());
+};
+
+template<class T>
+inline std::vector<T> zSnapshot(zCArray<T>& array)
+{
+	return std::vector<T>(array.begin(), array.end());
+};
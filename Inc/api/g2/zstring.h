@@ -351,6 +351,56 @@ struct zSTRING_Hasher
 	}
 };
 
+/**
+ * Converts an ASCII character to upper case (same as ::toupper for the "C" locale).
+ */
+inline char zSTRING_ToUpper(char c)
+{
+	return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+}
+
+/**
+ * A case insensitive hasher for zSTRING objects. 
+ * The string buffer is read in place, so no memory is allocated.
+ */
+struct zSTRING_CaseInsensitiveHasher
+{
+	std::size_t operator()(const zSTRING& str) const
+	{
+		const char* data = str.ToChar();
+		const size_t length = str.Length();
+		std::size_t hash = 0;
+		_INLINE_VAR constexpr size_t _FNV_prime = 16777619U; // from microsoft's type_trait implementation
+		for (size_t i = 0; i < length; ++i) {
+			hash ^= static_cast<size_t>(zSTRING_ToUpper(data[i]));
+			hash *= _FNV_prime;
+		}
+
+		return hash;
+	}
+};
+
+/**
+ * A case insensitive equality comparator for zSTRING objects.
+ * The string buffers are read in place, so no memory is allocated.
+ */
+struct zSTRING_CaseInsensitiveEqual
+{
+	bool operator()(const zSTRING& a, const zSTRING& b) const
+	{
+		const size_t length = a.Length();
+		if (length != b.Length()) return false;
+
+		const char* dataA = a.ToChar();
+		const char* dataB = b.ToChar();
+		for (size_t i = 0; i < length; ++i) {
+			if (zSTRING_ToUpper(dataA[i]) != zSTRING_ToUpper(dataB[i])) return false;
+		}
+
+		return true;
+	}
+};
+
 #undef __G2EXT_API_HEADER
 
 #endif // __API_G2_ZSTRING_H__
\ No newline at end of file
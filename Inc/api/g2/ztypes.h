@@ -725,6 +725,20 @@ public:
 		return (unsigned int)this->m_numInArray;
 	};
 
+	/** Begin of the used elements. Allows range based for loops over a zCArray.
+	*/
+	T* begin()
+	{
+		return this->m_array;
+	};
+
+	/** End of the used elements.
+	*/
+	T* end()
+	{
+		return this->m_array + this->m_numInArray;
+	};
+
 	/** Insert description. 
 	*/
 	int Search(const T& item)
@@ -1022,6 +1036,8 @@ class zCTree
 	T*			data;
 };
 
+#include "api/g2/zrange.h"
+
 /** ZenGin color type 
 * @note: The ZenGin uses a BGRA colour type! (Don't mix it up with RGBA!)
 *
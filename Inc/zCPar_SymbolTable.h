@@ -40,7 +40,7 @@ namespace g2ext_extended
 		int				nextPreAllocated;    // ecx + 0x4
 											 /*
 											 zCPar_Smybol* symbolList; //ecx + 0x8 (0x007A3EED)
-											 int unknown;	//ecx + 0xB
+											 int numAlloc;	//ecx + 0xC
 											 int numInList;  //ecx + 0x10
 											 int unknown;    // ecx+ 0x14; maybe zSTRING* symbolNameList ?
 
@@ -66,6 +66,7 @@ namespace g2ext_extended
 			XCALL(0x007A3F00);
 		};
 
+		// Sets the allocated size of the symbol arrays; the symbols are kept.
 		void SetSize(int)
 		{
 			XCALL(0x007A4430);
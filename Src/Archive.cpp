@@ -0,0 +1,266 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <Archive.h>
+#include <stdexcept>
+#include <cstring>
+#include <array>
+#include <algorithm>
+
+constexpr uint32_t ArchiveStringTable::INVALID_INDEX;
+
+uint32_t archiveChecksum(const void* data, size_t size)
+{
+	// Slicing-by-8: table[k][b] is the CRC of byte b followed by k zero bytes, so eight bytes
+	// are processed with eight independent table lookups.
+	static const auto table = [] {
+		std::vector<std::array<uint32_t, 256>> result(8);
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			result[0][i] = c;
+		}
+
+		for (uint32_t i = 0; i < 256; ++i) {
+			for (size_t k = 1; k < result.size(); ++k) {
+				const auto previous = result[k - 1][i];
+				result[k][i] = result[0][previous & 0xFF] ^ (previous >> 8);
+			}
+		}
+		return result;
+	}();
+
+	auto* bytes = static_cast<const unsigned char*>(data);
+	uint32_t crc = 0xFFFFFFFFu;
+
+	// the archives are little endian (x86)
+	for (; size >= 8; size -= 8, bytes += 8) {
+		uint32_t low = 0;
+		uint32_t high = 0;
+		std::memcpy(&low, bytes, sizeof(low));
+		std::memcpy(&high, bytes + 4, sizeof(high));
+		low ^= crc;
+
+		crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24]
+			^ table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+	}
+
+	for (; size != 0; --size, ++bytes) {
+		crc = table[0][(crc ^ *bytes) & 0xFF] ^ (crc >> 8);
+	}
+
+	return crc ^ 0xFFFFFFFFu;
+}
+
+void ArchiveWriter::writeString(const std::string& str)
+{
+	write(static_cast<uint32_t>(str.size()));
+	write(str.data(), str.size());
+}
+
+void ArchiveWriter::append(const ArchiveWriter& other)
+{
+	write(other.getData(), other.getSize());
+}
+
+void ArchiveWriter::reserve(size_t size)
+{
+	if (size > mBuffer.size()) mBuffer.resize(size);
+}
+
+const char* ArchiveWriter::getData() const
+{
+	return mBuffer.data();
+}
+
+size_t ArchiveWriter::getSize() const
+{
+	return mSize;
+}
+
+void ArchiveWriter::grow(size_t size)
+{
+	mBuffer.resize(std::max(mSize + size, mBuffer.size() * 2));
+}
+
+
+ArchiveReader::ArchiveReader(const char* begin, const char* end) : mCurrent(begin), mEnd(end)
+{
+}
+
+void ArchiveReader::read(void* dest, size_t size)
+{
+	require(size);
+	std::memcpy(dest, mCurrent, size);
+	mCurrent += size;
+}
+
+void ArchiveReader::readString(std::string& str)
+{
+	uint32_t size = 0;
+	read(size);
+	require(size);
+	str.assign(mCurrent, size);
+	mCurrent += size;
+}
+
+void ArchiveReader::require(size_t size) const
+{
+	if (getRemaining() < size) {
+		throw std::runtime_error("Unexpected end of archive");
+	}
+}
+
+void ArchiveReader::requireCount(size_t count, size_t elementSize) const
+{
+	if (count > getRemaining() / elementSize) {
+		throw std::runtime_error("Unexpected end of archive");
+	}
+}
+
+void ArchiveReader::skip(size_t size)
+{
+	require(size);
+	mCurrent += size;
+}
+
+const char* ArchiveReader::getPosition() const
+{
+	return mCurrent;
+}
+
+size_t ArchiveReader::getRemaining() const
+{
+	return static_cast<size_t>(mEnd - mCurrent);
+}
+
+
+uint32_t ArchiveStringTable::add(StringPool::Handle handle)
+{
+	if (handle >= mHandleIndices.size()) {
+		mHandleIndices.resize(handle + 1, INVALID_INDEX);
+	}
+
+	auto& index = mHandleIndices[handle];
+	if (index == INVALID_INDEX) {
+		index = add(StringPool::getStringPool()->resolve(handle));
+	}
+
+	return index;
+}
+
+uint32_t ArchiveStringTable::add(const std::string& str)
+{
+	// most strings are already known; they are only copied into the table once
+	auto it = mIndices.find(str);
+	if (it != mIndices.end()) return it->second;
+
+	it = mIndices.emplace(str, static_cast<uint32_t>(mStrings.size())).first;
+	mStrings.push_back(&it->first);
+	mByteSize += sizeof(uint32_t) + str.size();
+
+	return it->second;
+}
+
+uint32_t ArchiveStringTable::addUnique(const std::string& str)
+{
+	mStrings.push_back(&str);
+	mByteSize += sizeof(uint32_t) + str.size();
+
+	return static_cast<uint32_t>(mStrings.size() - 1);
+}
+
+void ArchiveStringTable::reserve(size_t count)
+{
+	mIndices.reserve(count);
+	mStrings.reserve(count);
+}
+
+void ArchiveStringTable::write(ArchiveWriter& writer) const
+{
+	writer.reserve(writer.getSize() + mByteSize);
+	for (const auto* str : mStrings) {
+		writer.writeString(*str);
+	}
+}
+
+size_t ArchiveStringTable::getSize() const
+{
+	return mStrings.size();
+}
+
+size_t ArchiveStringTable::getByteSize() const
+{
+	return mByteSize;
+}
+
+void ArchiveStringTable::read(ArchiveReader& reader, uint32_t count, std::vector<StringPool::Handle>& handles)
+{
+	auto* pool = StringPool::getStringPool();
+
+	// each string has at least its length
+	reader.requireCount<uint32_t>(count);
+	handles.clear();
+	handles.reserve(count);
+
+	std::string str;
+	for (uint32_t i = 0; i != count; ++i) {
+		reader.readString(str);
+		handles.push_back(pool->intern(str));
+	}
+}
+
+
+void StreamArchive::readString(std::istream& is, std::string& str)
+{
+	uint32_t size = 0;
+	readValue(is, size);
+	str.resize(size);
+	if (size != 0) is.read(&str[0], size);
+
+	// strings of spaces only are kept
+	const auto end = str.find_last_not_of(' ');
+	if (end != std::string::npos) str.erase(end + 1);
+}
+
+void StreamArchive::writeString(std::ostream& os, const std::string& str)
+{
+	// c-strings avoid null bytes to be written
+	const auto size = static_cast<uint32_t>(std::strlen(str.c_str()));
+	writeValue(os, size);
+	os.write(str.c_str(), size);
+}
+
+
+MemoryStreamBuffer::MemoryStreamBuffer(const char* begin, const char* end)
+{
+	auto* data = const_cast<char*>(begin);
+	setg(data, data, data + (end - begin));
+}
@@ -63,7 +63,15 @@ void Configuration::load(const string &filename)
 	mConfig.logToZSpy = tree.get<bool>("LOGGING.logToZSpy", true);
 	mConfig.logToFile = tree.get<bool>("LOGGING.logToFile", false);
 	mConfig.logToConsole = tree.get<bool>("LOGGING.logToConsole", false);
+	mConfig.logFileFlush = tree.get<std::string>("LOGGING.logFileFlush", "batch");
+	mConfig.logBinary = tree.get<bool>("LOGGING.logBinary", false);
+	mConfig.logRateLimit = tree.get<double>("LOGGING.logRateLimit", 0);
+	mConfig.logRateBurst = tree.get<double>("LOGGING.logRateBurst", 50);
+	mConfig.logFoldRepeats = tree.get<bool>("LOGGING.logFoldRepeats", false);
 	mConfig.debugEnabled = tree.get<bool>("LOGGING.debugEnabled", false);
+
+	mConfig.diiJournalCompactionSize = tree.get<size_t>("DII.journalCompactionSize", 512 * 1024);
+	mConfig.diiInitCacheInstances = tree.get<std::string>("DII.initCacheInstances", "");
 }
 
 void Configuration::save(const string &filename)
@@ -80,7 +88,14 @@ void Configuration::save(const string &filename)
 	pt.put("LOGGING.logToZSpy", mConfig.logToZSpy);
 	pt.put("LOGGING.logToFile", mConfig.logToFile);
 	pt.put("LOGGING.logToConsole", mConfig.logToConsole);
+	pt.put("LOGGING.logFileFlush", mConfig.logFileFlush);
+	pt.put("LOGGING.logBinary", mConfig.logBinary);
+	pt.put("LOGGING.logRateLimit", mConfig.logRateLimit);
+	pt.put("LOGGING.logRateBurst", mConfig.logRateBurst);
+	pt.put("LOGGING.logFoldRepeats", mConfig.logFoldRepeats);
 	pt.put("LOGGING.debugEnabled", mConfig.debugEnabled);
+	pt.put("DII.journalCompactionSize", mConfig.diiJournalCompactionSize);
+	pt.put("DII.initCacheInstances", mConfig.diiInitCacheInstances);
 
 	try {
 		write_ini(path.str(), pt);
@@ -118,6 +133,41 @@ bool Configuration::getLogToConsole()
 	return mConfig.logToConsole;
 }
 
+const string& Configuration::getLogFileFlush()
+{
+	return mConfig.logFileFlush;
+}
+
+bool Configuration::getLogBinary()
+{
+	return mConfig.logBinary;
+}
+
+double Configuration::getLogRateLimit()
+{
+	return mConfig.logRateLimit;
+}
+
+double Configuration::getLogRateBurst()
+{
+	return mConfig.logRateBurst;
+}
+
+bool Configuration::getLogFoldRepeats()
+{
+	return mConfig.logFoldRepeats;
+}
+
+size_t Configuration::getDIIJournalCompactionSize()
+{
+	return mConfig.diiJournalCompactionSize;
+}
+
+const string& Configuration::getDIIInitCacheInstances()
+{
+	return mConfig.diiInitCacheInstances;
+}
+
 bool Configuration::getLogInfos()
 {
 	return mConfig.logInfos;
@@ -42,15 +42,21 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #include <Levitation.h>
 #include <functional>
 #include <Constants.h>
+#include <SaveWriter.h>
+#include <UserDataArena.h>
 #include <api\g2\ocobjectfactory.h>
 
 using namespace constants;
 
 const std::string DII::SAVE_ITEM_FILE_EXT = ".SAV";
+const std::string DII::SAVE_ITEM_JOURNAL_EXT = ".JNL";
 const std::string DII::SAVE_ITEM_INSTANCES  = "DII_INSTANCES";
 const std::string DII::FILE_PATERN = "DII_*";
 
 bool DII::showExtendedDebugInfo = false;
+std::set<int> DII::mQueuedInstanceUpdates;
+std::unordered_set<oCItem*> DII::mDeferredItemUpdates;
+std::unordered_set<void*> DII::mOpenInventories;
 
 
 typedef void ( __thiscall* LoadSavegame )(void*, int, int); 
@@ -73,6 +79,25 @@ typedef void (__thiscall* OCGameLoadGame)(void* pThis, int, zSTRING const &);
 OCGameLoadGame oCGameLoadGame;
 typedef void ( __thiscall* OCGameLoadWorld )(void*, int, zSTRING const &); 
 OCGameLoadWorld oCGameLoadWorld;
+OCItemInitByScript oCItemInitByScriptOriginal;
+typedef void (__thiscall* OCItemDestructor)(void* pThis);
+OCItemDestructor oCItemDestructor;
+typedef void (__thiscall* OCGameRender)(void* pThis);
+OCGameRender oCGameRender;
+typedef void (__thiscall* OCNpcInventoryOpen)(void* pThis, int, int, int);
+OCNpcInventoryOpen oCNpcInventoryOpen;
+typedef void (__thiscall* OCNpcInventoryClose)(void* pThis);
+OCNpcInventoryClose oCNpcInventoryClose;
+typedef void (__thiscall* OCMobContainerOpen)(void* pThis, void*);
+OCMobContainerOpen oCMobContainerOpen;
+typedef void* (__thiscall* ZCWorldAddVob)(void* pThis, zCVob*);
+ZCWorldAddVob zCWorldAddVob;
+typedef void (__thiscall* OCWorldRemoveVob)(void* pThis, zCVob*);
+OCWorldRemoveVob oCWorldRemoveVob;
+typedef void* (__thiscall* ZCWorldAddVobAsChild)(void* pThis, zCVob*, void*);
+ZCWorldAddVobAsChild zCWorldAddVobAsChild;
+typedef void* (__thiscall* OCMobContainerDestructor)(void* pThis, unsigned int);
+OCMobContainerDestructor oCMobContainerDestructor;
 
 
 OCItemInsertEffect DII::oCItemInsertEffect = (OCItemInsertEffect)0x00712C40;
@@ -86,6 +111,18 @@ void DII::hookModule()
 	oCItemGetValue = (OCItemGetValue) (OCITEM_GET_VALUE_ADDRESS);
 	createInstance = (CreateInstance) (ZCPARSER_CREATE_INSTANCE);
 	oCGameLoadGame = (OCGameLoadGame) OCGAME_LOAD_GAME_ADDRESS;
+	oCGameLoadWorld = (OCGameLoadWorld) OCGAME_LOAD_WORLD_ADDRESS;
+	oCItemInitByScriptOriginal = (OCItemInitByScript) OCITEM_INIT_BY_SCRIPT_ADDRESS;
+	oCItemDestructor = (OCItemDestructor) OCITEM_DESTRUCTOR_ADDRESS;
+	zCWorldAddVob = (ZCWorldAddVob) ZCWORLD_ADD_VOB_ADDRESS;
+	oCWorldRemoveVob = (OCWorldRemoveVob) OCWORLD_REMOVE_VOB_ADDRESS;
+	zCWorldAddVobAsChild = (ZCWorldAddVobAsChild) ZCWORLD_ADD_VOB_AS_CHILD_ADDRESS;
+	oCMobContainerDestructor = (OCMobContainerDestructor)
+		reinterpret_cast<void**>(VOB_TYPE_VT_OCMOBCONTAINER)[ZCOBJECT_VTABLE_DESTRUCTOR_SLOT];
+	oCGameRender = (OCGameRender) OCGAME_RENDER_ADDRESS;
+	oCNpcInventoryOpen = (OCNpcInventoryOpen) OCNPC_INVENTORY_OPEN_ADDRESS;
+	oCNpcInventoryClose = (OCNpcInventoryClose) OCNPC_INVENTORY_CLOSE_ADDRESS;
+	oCMobContainerOpen = (OCMobContainerOpen) OCMOB_CONTAINER_OPEN;
 
 	zCParserGetIndex = (ZCParserGetIndex)ZCPARSER_GETINDEX;
 	zCPar_SymbolTableGetIndex = (ZCPar_SymbolTableGetIndex) ZCPAR_SYMBOL_TABLE_GETINDEX;
@@ -105,6 +142,17 @@ void DII::hookModule()
 
 	hookManager->addFunctionHook((LPVOID*)&createInstance, createInstanceHook, mModuleDesc);
 	hookManager->addFunctionHook((LPVOID*)&oCGameLoadGame, oCGameLoadGameHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCGameLoadWorld, oCGameLoadWorldHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCItemInitByScriptOriginal, oCItemInitByScriptHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCItemDestructor, oCItemDestructorHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&zCWorldAddVob, zCWorldAddVobHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCWorldRemoveVob, oCWorldRemoveVobHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&zCWorldAddVobAsChild, zCWorldAddVobAsChildHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCMobContainerDestructor, oCMobContainerDestructorHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCGameRender, oCGameRenderHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCNpcInventoryOpen, oCNpcInventoryOpenHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCNpcInventoryClose, oCNpcInventoryCloseHook, mModuleDesc);
+	hookManager->addFunctionHook((LPVOID*)&oCMobContainerOpen, oCMobContainerOpenHook, mModuleDesc);
 	
 	hookManager->addFunctionHook((LPVOID*)&zCParserGetIndex, zCParserGetIndexHook, mModuleDesc);
 	hookManager->addFunctionHook((LPVOID*)&zCPar_SymbolTableGetIndex, zCPar_SymbolTableGetIndexHook, mModuleDesc);
@@ -121,6 +169,17 @@ void DII::unHookModule()
 
 	hookManager->removeFunctionHook((LPVOID*)&createInstance, createInstanceHook, mModuleDesc);
 	hookManager->removeFunctionHook((LPVOID*)&oCGameLoadGame, oCGameLoadGameHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCGameLoadWorld, oCGameLoadWorldHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCItemInitByScriptOriginal, oCItemInitByScriptHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCItemDestructor, oCItemDestructorHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&zCWorldAddVob, zCWorldAddVobHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCWorldRemoveVob, oCWorldRemoveVobHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&zCWorldAddVobAsChild, zCWorldAddVobAsChildHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCMobContainerDestructor, oCMobContainerDestructorHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCGameRender, oCGameRenderHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCNpcInventoryOpen, oCNpcInventoryOpenHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCNpcInventoryClose, oCNpcInventoryCloseHook, mModuleDesc);
+	hookManager->removeFunctionHook((LPVOID*)&oCMobContainerOpen, oCMobContainerOpenHook, mModuleDesc);
 
 	hookManager->removeFunctionHook((LPVOID*)&zCParserGetIndex, zCParserGetIndexHook, mModuleDesc);
 	hookManager->removeFunctionHook((LPVOID*)&zCPar_SymbolTableGetIndex, zCPar_SymbolTableGetIndexHook, mModuleDesc);
@@ -150,8 +209,50 @@ void DII::DII_ApplyInstanceChangesToAll(const zSTRING& instanceName)
 		return;
 	}
 
-	ItemUpdater::UpdateItemData params = { symbolIndex, symbolIndex };
-	manager->callForAllItems(ItemUpdater::updateItem, NULL, &params);
+	mQueuedInstanceUpdates.insert(symbolIndex);
+}
+
+void DII::applyQueuedInstanceUpdates()
+{
+	if (mQueuedInstanceUpdates.empty()) return;
+
+	std::set<int> instanceIds;
+	instanceIds.swap(mQueuedInstanceUpdates);
+
+	auto* manager = ObjectManager::getObjectManager();
+	for (int instanceId : instanceIds) {
+		ItemUpdater::UpdateItemData params = { instanceId, instanceId };
+		manager->callForItemsWithInstanceId(instanceId, ItemUpdater::updateOrDeferItem, NULL, &params);
+	}
+
+	mLogStream << __FUNCTION__ << ": applied " << instanceIds.size() << " instance updates; "
+		<< mDeferredItemUpdates.size() << " item updates are deferred" << std::endl;
+	util::debug(mLogStream);
+}
+
+void DII::applyDeferredItemUpdate(oCItem* item)
+{
+	if (mDeferredItemUpdates.erase(item) == 0) return;
+
+	const int instanceId = ObjectManager::getInstanceId(*item);
+	ItemUpdater::UpdateItemData params = { instanceId, instanceId };
+	ItemUpdater::updateItem(NULL, &params, item);
+}
+
+void DII::applyDeferredItemUpdates()
+{
+	if (mDeferredItemUpdates.empty()) return;
+
+	const std::vector<oCItem*> items(mDeferredItemUpdates.begin(), mDeferredItemUpdates.end());
+	for (auto* item : items) {
+		applyDeferredItemUpdate(item);
+	}
+}
+
+bool DII::isItemUpdateDeferrable(oCItem* item)
+{
+	constexpr int ITEM_ACTIVE = 0x40000000;
+	return mOpenInventories.empty() && item->homeWorld == NULL && !(item->flags & ITEM_ACTIVE);
 }
 
 void DII::DII_RemoveProxy(const zSTRING& sourceInstanceName)
@@ -210,33 +311,24 @@ int DII::DII_CreateNewInstanceInt(oCItem* item) //Func int DII_CreateNewInstance
 
 	// Create new instance with item
 	ObjectManager* manager = ObjectManager::getObjectManager();
-
-
-	int parserSymbolIndex = 0;
-
-	while (!parserSymbolIndex) {
-#pragma push_macro("min")
-#pragma push_macro("max")
-#undef min
-#undef max
-
-		const std::string instanceName = "DII_*" + std::to_string(util::generateRandom(std::numeric_limits<int>::min(), std::numeric_limits<int>::max())) + "*";
-
-#pragma pop_macro("max")
-#pragma pop_macro("min")
-
-		parserSymbolIndex = manager->createNewInstanceId(item, instanceName);
-		if (!parserSymbolIndex) {
-			mLogStream << __FUNCTION__ << ": Couldn't create new instance '" << instanceName << "'" << std::endl;
-			util::logWarning(mLogStream);
-		}
-	}
+	int parserSymbolIndex = manager->createNewInstanceId(item);
 
 	mLogStream << __FUNCTION__ << ": key = " << parserSymbolIndex << std::endl;
 	util::debug(mLogStream);
 	return parserSymbolIndex;
 }
 
+int DII::DII_CreateNewInstancesBatch(oCItem** items, int count, int* instanceIds) //Func int DII_CreateNewInstancesBatch(var int items, var int count, var int instanceIds)
+{
+	if (!items || count <= 0) { return 0; }
+
+	mLogStream << __FUNCTION__ << ": count = " << count << std::endl;
+	util::debug(mLogStream);
+
+	ObjectManager* manager = ObjectManager::getObjectManager();
+	return manager->createInstances(items, count, instanceIds);
+}
+
 zSTRING* DII::DII_CreateNewInstance(oCItem* item)
 {
 	const auto parserSymbolIndex = DII_CreateNewInstanceInt(item);
@@ -306,6 +398,9 @@ BYTE* DII::DII_GetUserData(int instanceIdParserSymbolIndex) // Func DII_UserData
 	}
 
 	DynInstance* storeItem = manager->getInstanceItem(instanceIdParserSymbolIndex);
+
+	// The script gets write access to the user data, so we have to assume that it changes.
+	storeItem->setDirty(true);
 	return storeItem->getUserData();
 }
 
@@ -333,6 +428,9 @@ bool DII::DII_UpdateInstance(const zSTRING& instanceName, oCItem* item)
 	}
 	dynInstance->store(*item);
 
+	// the replaced text fields might not be used anymore
+	manager->collectStrings();
+
 	return true;
 }
 
@@ -362,6 +460,7 @@ void DII::DII_GetItemByInstanceId(int itemParserSymbolIndex, int instanceIdParse
 
 	ObjectManager* manager = ObjectManager::getObjectManager();
 	item = manager->getItemByInstanceId(instanceIdParserSymbolIndex);
+	if (item) applyDeferredItemUpdate(item);
 
 	if (!item)
 	{
@@ -383,15 +482,20 @@ void DII::DII_ChangeInstanceForAll(const zSTRING& sourceName, const zSTRING& tar
 {
 	ObjectManager* manager = ObjectManager::getObjectManager();
 
+	// pending updates refer to the current instance ids
+	applyQueuedInstanceUpdates();
+
 	auto sourceID = manager->getUnProxiedInstanceID(sourceName);
 	auto targetID = manager->getUnProxiedInstanceID(targetName);
 
 	ItemUpdater::UpdateItemData params = { sourceID, targetID };
-	manager->callForAllItems(ItemUpdater::updateItemInstance, NULL, &params);
+	manager->callForItemsWithInstanceId(sourceID, ItemUpdater::updateItemInstance, NULL, &params);
 }
 
 int DII::oCItemGetValueHook(void* pThis) {
 	oCItem* item = static_cast<oCItem*>(pThis);
+	applyDeferredItemUpdate(item);
+
 	ObjectManager* manager = ObjectManager::getObjectManager();
 	//if (manager->getDynInstanceId(item) > ObjectManager::INSTANCE_BEGIN) {
 	if (manager->isAssignedToDII(item)) {
@@ -419,7 +523,7 @@ zCPar_Symbol* DII::zCPar_SymbolTableGetSymbolHook(void* pThis, int index)
 zCPar_Symbol* DII::zCPar_SymbolTableGetSymbolStringHook(void* pThis, zSTRING const & symbolName)
 {
 	auto* manager = ObjectManager::getObjectManager();
-	zSTRING resolvedName = manager->resolveProxying(symbolName);
+	const zSTRING& resolvedName = manager->resolveProxying(symbolName);
 	zCPar_Symbol* result = zCPar_SymbolTableGetSymbolString(pThis, resolvedName);
 	if (result == NULL)
 	{
@@ -432,7 +536,7 @@ zCPar_Symbol* DII::zCPar_SymbolTableGetSymbolStringHook(void* pThis, zSTRING con
 int DII::zCPar_SymbolTableGetIndexHook(void* pThis, zSTRING const& symbolName)
 {
 	auto* manager = ObjectManager::getObjectManager();
-	zSTRING resolvedName = manager->resolveProxying(symbolName);
+	const zSTRING& resolvedName = manager->resolveProxying(symbolName);
 	int result = zCPar_SymbolTableGetIndex(pThis, resolvedName);
 	if (result == -1)
 	{
@@ -460,7 +564,10 @@ DII::DII() :Module("DII")
 
 DII::~DII()
 {
+	// finish pending savegame writes before the instances are gone
+	SaveWriter::release();
 	ObjectManager::release();
+	UserDataArena::release();
 }
 
 
@@ -468,8 +575,18 @@ DII::~DII()
 {   
 	mLogStream << __FUNCTION__ << ": load savegame..." << std::endl;
 	util::logInfo(mLogStream);
+
+	// the instances of the queued updates are released
+	mQueuedInstanceUpdates.clear();
+
+	// a save to the same slot might still be in progress
+	auto* writer = SaveWriter::getSaveWriter();
+	writer->wait(ObjectManager::getSaveGameDirectoryPath(saveGameSlotNumber));
+	writer->wait(ObjectManager::getCurrentDirectoryPath());
+
 	loadDynamicInstances(saveGameSlotNumber);
 	loadSavegame(pThis, saveGameSlotNumber, b);
+	ObjectManager::getObjectManager()->onWorldChanged();
 
 	mLogStream << __FUNCTION__ << ": done." << std::endl;
 	util::logInfo(mLogStream);
@@ -495,7 +612,11 @@ DII::~DII()
 
 	std::string currentDir = manager->getCurrentDirectoryPath();
 
-	util::copyContentTo(currentDir,saveGameDir, FILE_PATERN);
+	// Gothic copies the 'current' directory, so the DII files of a previous save have to be written completely.
+	SaveWriter::getSaveWriter()->wait(currentDir);
+
+	applyQueuedInstanceUpdates();
+	applyDeferredItemUpdates();
 
 	// Write actual savegame
 	writeSavegame(pThis, saveGameSlotNumber, b);
@@ -504,9 +625,11 @@ DII::~DII()
 	// It is better to do this after savegame writing, as gothic copies (possibly outdated) dynamic-instance-save-files from the current
 	// save directory to the target savegame directory. Would be save the dynamic instances before the savegame-writing, gothic would eventually 
  	// overwrite our stuff!!! 
+	// The 'current' directory receives the same changes, so that it is up to date for the next save.
+	// The instances are serialized now; the files are written in the background.
 	std::string saveInstances = SAVE_ITEM_INSTANCES + SAVE_ITEM_FILE_EXT;
-	manager->saveNewInstances(const_cast<char*>(saveGameDir.c_str()), const_cast<char*>(saveInstances.c_str()));
-	util::copyFileTo(saveGameDir + saveInstances, currentDir + saveInstances);
+	std::string saveJournal = SAVE_ITEM_INSTANCES + SAVE_ITEM_JOURNAL_EXT;
+	manager->saveNewInstances(saveGameDir, saveInstances, saveJournal, currentDir);
 
 	mLogStream << __FUNCTION__ << ": done." << std::endl;
 	util::logInfo(mLogStream);
@@ -522,8 +645,7 @@ DII::~DII()
 	zCPar_Symbol* symbol = zCParser::GetParser()->GetSymbol(instanceId);
 	if (symbol == NULL)
 	{
-		mLogStream << __FUNCTION__ << ": symbol is null! InstanceId: " << instanceId << std::endl;
-		util::debug(mLogStream, Logger::Warning);
+		UTIL_DEBUG(Logger::Warning, mLogStream, __FUNCTION__ << ": symbol is null! InstanceId: " << instanceId << std::endl);
 	}
 
 	// Get the smybol of the item variable and let it point to the 'source' variable (will contain the newly created item!)
@@ -533,9 +655,18 @@ DII::~DII()
 	 if (itemSymbol != nullptr)
 		itemSymbol->offset = (int)source;
 
-	int result = createInstance(pThis, instanceId, source);
-
 	auto isDynamic = manager->isDynamicInstance(instanceId);
+
+	// Whitelisted static item instances run their script only once per script generation
+	int result = 0;
+	if (!isDynamic && pThis == zCParser::GetParser()) {
+		result = manager->initByCachedScript(instanceId, static_cast<oCItem*>(source),
+			[&] { return createInstance(pThis, instanceId, source); });
+	}
+	else {
+		result = createInstance(pThis, instanceId, source);
+	}
+
 	if (isDynamic)
 	{
 		oCItem* item = (oCItem*)source;
@@ -552,12 +683,111 @@ void DII::oCGameLoadGameHook(void* pThis, int second, zSTRING const& worldName)
 	util::logInfo(mLogStream);
 	ObjectManager* manager = ObjectManager::getObjectManager();
 	manager->releaseInstances();
+	mQueuedInstanceUpdates.clear();
+	SaveWriter::getSaveWriter()->wait(ObjectManager::getCurrentDirectoryPath());
 	oCGameLoadGame(pThis, second, worldName);
+	manager->onWorldChanged();
 
 	mLogStream << __FUNCTION__ << ": done." << std::endl;
 	util::logInfo(mLogStream);
 }
 
+void DII::oCGameLoadWorldHook(void* pThis, int saveGameSlotNumber, zSTRING const& levelPath)
+{
+	mOpenInventories.clear();
+
+	// the vobs of the previous world are destroyed while loading
+	auto* manager = ObjectManager::getObjectManager();
+	manager->onWorldChanged();
+	oCGameLoadWorld(pThis, saveGameSlotNumber, levelPath);
+	manager->onWorldChanged();
+}
+
+void DII::oCItemInitByScriptHook(void* pThis, int instanceId, int amount)
+{
+	oCItemInitByScriptOriginal(pThis, instanceId, amount);
+
+	if (auto* manager = ObjectManager::getObjectManager())
+		manager->onItemInstanceChanged(static_cast<oCItem*>(pThis));
+}
+
+void DII::oCItemDestructorHook(void* pThis)
+{
+	mDeferredItemUpdates.erase(static_cast<oCItem*>(pThis));
+
+	// items might be destroyed after the module is released
+	if (auto* manager = ObjectManager::getObjectManager())
+		manager->onItemDestroyed(static_cast<oCItem*>(pThis));
+
+	oCItemDestructor(pThis);
+}
+
+void* DII::zCWorldAddVobHook(void* pThis, zCVob* vob)
+{
+	void* result = zCWorldAddVob(pThis, vob);
+
+	if (auto* manager = ObjectManager::getObjectManager())
+		manager->onVobAdded(static_cast<zCWorld*>(pThis), vob);
+
+	// an item, whose update is deferred, becomes visible
+	if (!mDeferredItemUpdates.empty() && vob && vob->type == VOB_TYPE_ITEM)
+		applyDeferredItemUpdate(reinterpret_cast<oCItem*>(vob));
+
+	return result;
+}
+
+void DII::oCWorldRemoveVobHook(void* pThis, zCVob* vob)
+{
+	if (auto* manager = ObjectManager::getObjectManager())
+		manager->onVobRemoved(static_cast<zCWorld*>(pThis), vob);
+
+	oCWorldRemoveVob(pThis, vob);
+}
+
+void* DII::zCWorldAddVobAsChildHook(void* pThis, zCVob* vob, void* parent)
+{
+	void* result = zCWorldAddVobAsChild(pThis, vob, parent);
+
+	if (auto* manager = ObjectManager::getObjectManager())
+		manager->onVobAdded(static_cast<zCWorld*>(pThis), vob);
+
+	return result;
+}
+
+void* DII::oCMobContainerDestructorHook(void* pThis, unsigned int flags)
+{
+	// containers might be destroyed after the module is released
+	if (auto* manager = ObjectManager::getObjectManager())
+		manager->onMobContainerDestroyed(static_cast<oCMobContainer*>(pThis));
+
+	return oCMobContainerDestructor(pThis, flags);
+}
+
+void DII::oCGameRenderHook(void* pThis)
+{
+	applyQueuedInstanceUpdates();
+	oCGameRender(pThis);
+}
+
+void DII::oCNpcInventoryOpenHook(void* pThis, int x, int y, int mode)
+{
+	applyDeferredItemUpdates();
+	mOpenInventories.insert(pThis);
+	oCNpcInventoryOpen(pThis, x, y, mode);
+}
+
+void DII::oCNpcInventoryCloseHook(void* pThis)
+{
+	mOpenInventories.erase(pThis);
+	oCNpcInventoryClose(pThis);
+}
+
+void DII::oCMobContainerOpenHook(void* pThis, void* npc)
+{
+	applyDeferredItemUpdates();
+	oCMobContainerOpen(pThis, npc);
+}
+
 zCListSort<oCItem>* DII::getInvItemByInstanceId(oCNpcInventory* inventory, int instanceId)
 {
 	inventory->UnpackCategory();
@@ -615,9 +845,9 @@ void DII::loadDynamicInstances(int saveGameSlotNumber)
 	ObjectManager* manager = ObjectManager::getObjectManager();
 	manager->releaseInstances();
 	std::string instances = SAVE_ITEM_INSTANCES + SAVE_ITEM_FILE_EXT;
+	std::string journal = SAVE_ITEM_INSTANCES + SAVE_ITEM_JOURNAL_EXT;
 	std::string saveGameDir = manager->getSaveGameDirectoryPath(saveGameSlotNumber);
-	std::string fileName = saveGameDir + instances;
-	manager->loadNewInstances((char*)fileName.c_str());
+	manager->loadNewInstances(saveGameDir + instances, saveGameDir + journal);
 	mLogStream << __FUNCTION__ << ": done." << std::endl;
 	util::logInfo(mLogStream);
 }
@@ -773,10 +1003,26 @@ bool DII::ItemUpdater::updateItem(void* obj, void* param, oCItem* itm)
 	return false;
 }
 
+bool DII::ItemUpdater::updateOrDeferItem(void* obj, void* param, oCItem* itm)
+{
+	if (itm == NULL) return false;
+
+	if (isItemUpdateDeferrable(itm)) {
+		mDeferredItemUpdates.insert(itm);
+		return false;
+	}
+
+	mDeferredItemUpdates.erase(itm);
+	return updateItem(obj, param, itm);
+}
+
 bool DII::ItemUpdater::updateItemInstance(void* obj, void* param, oCItem* itm)
 {
 	if (itm == NULL) return false;
 
+	// the deferred update belongs to the previous instance
+	applyDeferredItemUpdate(itm);
+
 	ItemUpdater::UpdateItemData* params = (ItemUpdater::UpdateItemData*)param;
 	ObjectManager* manager = ObjectManager::getObjectManager();
 	int id = manager->getInstanceId(*itm);;
@@ -0,0 +1,348 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <DiiArchive.h>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+
+constexpr const char DiiArchive::ARCHIVE_HEADER::DESC[];
+
+DiiArchive::LoadedArchive::LoadedArchive(InstanceFactory createInstance, uint32_t userDataIntAmount, uint32_t userDataStringAmount)
+	: createInstance(std::move(createInstance)), userDataIntAmount(userDataIntAmount), userDataStringAmount(userDataStringAmount)
+{
+}
+
+void DiiArchive::LoadedArchive::addInstance(std::unique_ptr<DiiRecord> instance)
+{
+	auto result = instanceIndices.insert({ instance->getSymbolName(), instances.size() });
+	if (result.second) {
+		instances.push_back(std::move(instance));
+	}
+	else {
+		instances[result.first->second] = std::move(instance);
+	}
+}
+
+void DiiArchive::writeArchive(ArchiveWriter& archive, const std::vector<const DiiRecord*>& instances, const ProxyMap& proxies,
+	uint32_t nextGeneratedName, const std::vector<uint32_t>& freeGeneratedNames)
+{
+	ARCHIVE_HEADER header;
+	archive.write(header);
+	writeArchiveBlocks(archive, instances, &proxies, nextGeneratedName, freeGeneratedNames);
+	archive.write(archiveChecksum(archive.getData(), archive.getSize()));
+}
+
+void DiiArchive::writeJournalEntry(ArchiveWriter& entry, uint32_t baseChecksum, const std::vector<const DiiRecord*>& instances,
+	const ProxyMap* proxies, uint32_t nextGeneratedName, const std::vector<uint32_t>& freeGeneratedNames)
+{
+	ArchiveWriter body;
+	writeArchiveBlocks(body, instances, proxies, nextGeneratedName, freeGeneratedNames);
+
+	ARCHIVE_JOURNAL_ENTRY header;
+	header.flags = ARCHIVE_JOURNAL_ENTRY::HAS_NAME_ALLOCATOR | ARCHIVE_JOURNAL_ENTRY::HAS_DELTA_RECORDS;
+	if (proxies) header.flags |= ARCHIVE_JOURNAL_ENTRY::HAS_PROXIES;
+	header.baseChecksum = baseChecksum;
+	header.size = static_cast<uint32_t>(body.getSize());
+
+	entry.reserve(entry.getSize() + sizeof(header) + body.getSize() + sizeof(uint32_t));
+	entry.write(header);
+	entry.append(body);
+	entry.write(archiveChecksum(body.getData(), body.getSize()));
+}
+
+void DiiArchive::writeArchiveBlocks(ArchiveWriter& writer, const std::vector<const DiiRecord*>& instances,
+	const ProxyMap* proxies, uint32_t nextGeneratedName, const std::vector<uint32_t>& freeGeneratedNames)
+{
+	ARCHIVE_LAYOUT layout;
+	layout.instanceCount = static_cast<uint32_t>(instances.size());
+	layout.intFieldCount = DiiRecord::ARCHIVE_INT_FIELD_COUNT;
+	layout.stringFieldCount = DiiRecord::ARCHIVE_STRING_FIELD_COUNT;
+	if (!instances.empty()) {
+		layout.userDataIntAmount = instances.front()->getUserDataRecord().getIntCount();
+		layout.userDataStringAmount = instances.front()->getUserDataRecord().getStringCount();
+	}
+	layout.proxyCount = proxies ? static_cast<uint32_t>(proxies->size()) : 0;
+
+	// The string table precedes the images and records, but is only complete after all of them are written.
+	ArchiveStringTable strings;
+	ArchiveWriter records;
+
+	// the prototype images the instances refer to
+	std::unordered_map<const DiiRecord::FieldImage*, uint32_t> imageIndices;
+	std::vector<const DiiRecord::FieldImage*> images;
+
+	// the sizes of all record blocks are known in advance
+	const size_t userDataSize = (layout.userDataIntAmount + layout.userDataStringAmount) * sizeof(uint32_t);
+	size_t recordsSize = layout.proxyCount * 2 * sizeof(uint32_t)
+		+ sizeof(nextGeneratedName) + (1 + freeGeneratedNames.size()) * sizeof(uint32_t);
+	for (auto* instance : instances) {
+		recordsSize += instance->getDeltaRecordSize() + userDataSize;
+	}
+	records.reserve(recordsSize);
+
+	// every instance has its own symbol name, which isn't looked up in the table
+	strings.reserve(instances.size());
+
+	for (auto* instance : instances) {
+		auto* image = instance->getPrototypeImage().get();
+		auto result = imageIndices.insert({ image, static_cast<uint32_t>(images.size()) });
+		if (result.second) images.push_back(image);
+
+		instance->writeDeltaRecord(records, strings, result.first->second);
+		instance->getUserDataRecord().writeRecord(records, strings, layout.userDataIntAmount, layout.userDataStringAmount);
+	}
+
+	ArchiveWriter imageBlock;
+	imageBlock.reserve(sizeof(uint32_t) + images.size() * sizeof(DiiRecord::FieldImage));
+	imageBlock.write(static_cast<uint32_t>(images.size()));
+	for (auto* image : images) {
+		DiiRecord::writeFieldImage(imageBlock, strings, *image);
+	}
+
+	if (proxies) {
+		for (auto& pair : *proxies) {
+			records.write(strings.add(pair.first));
+			records.write(strings.add(pair.second));
+		}
+	}
+
+	records.write(nextGeneratedName);
+	records.write(static_cast<uint32_t>(freeGeneratedNames.size()));
+	for (auto number : freeGeneratedNames) {
+		records.write(number);
+	}
+
+	layout.stringCount = static_cast<uint32_t>(strings.getSize());
+
+	// the blocks are followed by a checksum
+	writer.reserve(writer.getSize() + sizeof(layout) + strings.getByteSize() + imageBlock.getSize() + records.getSize()
+		+ sizeof(uint32_t));
+	writer.write(layout);
+	strings.write(writer);
+	writer.append(imageBlock);
+	writer.append(records);
+}
+
+void DiiArchive::readArchiveBlocks(ArchiveReader& reader, LoadedArchive& archive, ProxyList& proxies)
+{
+	ARCHIVE_LAYOUT layout;
+	reader.read(layout);
+
+	if (layout.intFieldCount != DiiRecord::ARCHIVE_INT_FIELD_COUNT
+		|| layout.stringFieldCount != DiiRecord::ARCHIVE_STRING_FIELD_COUNT) {
+		throw std::runtime_error("Incompatible archive record layout");
+	}
+
+	if (layout.instanceCount != 0
+		&& (layout.userDataIntAmount != archive.userDataIntAmount || layout.userDataStringAmount != archive.userDataStringAmount)) {
+		std::stringstream ss;
+		ss << "user data amounts of the archive (" << layout.userDataIntAmount << ", " << layout.userDataStringAmount
+			<< ") don't match the defined amounts (" << archive.userDataIntAmount << ", " << archive.userDataStringAmount << ")";
+		archive.warnings.push_back(ss.str());
+	}
+
+	std::vector<StringPool::Handle> strings;
+	ArchiveStringTable::read(reader, layout.stringCount, strings);
+
+	uint32_t imageCount = 0;
+	reader.read(imageCount);
+	reader.requireCount<DiiRecord::FieldImage>(imageCount);
+
+	std::vector<std::shared_ptr<const DiiRecord::FieldImage>> images;
+	images.reserve(imageCount);
+	for (uint32_t i = 0; i != imageCount; ++i) {
+		auto image = std::make_shared<DiiRecord::FieldImage>();
+		DiiRecord::readFieldImage(reader, strings, *image);
+		images.push_back(std::move(image));
+	}
+
+	for (uint32_t i = 0; i != layout.instanceCount; ++i) {
+		auto instance = archive.createInstance();
+		instance->readDeltaRecord(reader, strings, images);
+		instance->getUserDataRecord().readRecord(reader, strings, layout.userDataIntAmount, layout.userDataStringAmount);
+		archive.addInstance(std::move(instance));
+	}
+
+	auto* pool = StringPool::getStringPool();
+	proxies.clear();
+	for (uint32_t i = 0; i != layout.proxyCount; ++i) {
+		uint32_t sourceIndex = 0;
+		uint32_t targetIndex = 0;
+		reader.read(sourceIndex);
+		reader.read(targetIndex);
+
+		if (sourceIndex >= strings.size() || targetIndex >= strings.size()) {
+			throw std::runtime_error("Invalid string table index in proxy block");
+		}
+
+		proxies.emplace_back(pool->resolve(strings[sourceIndex]), pool->resolve(strings[targetIndex]));
+	}
+
+	uint32_t freeCount = 0;
+	reader.read(archive.nextGeneratedName);
+	reader.read(freeCount);
+	reader.requireCount<uint32_t>(freeCount);
+
+	archive.freeGeneratedNames.clear();
+	archive.freeGeneratedNames.reserve(freeCount);
+	for (uint32_t i = 0; i != freeCount; ++i) {
+		uint32_t number = 0;
+		reader.read(number);
+		archive.freeGeneratedNames.push_back(number);
+	}
+	archive.hasNameAllocator = true;
+}
+
+uint32_t DiiArchive::loadArchive(const char* begin, const char* end, LoadedArchive& archive)
+{
+	ARCHIVE_HEADER header;
+	if (static_cast<size_t>(end - begin) < sizeof(ARCHIVE_HEADER)) {
+		throw std::runtime_error("Incompatible archive format");
+	}
+	std::memcpy(&header, begin, sizeof(ARCHIVE_HEADER));
+
+	//check that the read header matches the expected one!
+	if (std::memcmp(header.desc, ARCHIVE_HEADER::DESC, sizeof(header.desc)) != 0) {
+		throw std::runtime_error("Incompatible archive format");
+	}
+
+	const char* body = begin + sizeof(ARCHIVE_HEADER);
+
+	if (header.version == ARCHIVE_HEADER::VERSION) {
+		return loadArchive_2(body, end, archive);
+	}
+
+	if (header.version == ARCHIVE_HEADER::VERSION_1_1) {
+		return loadArchive_1_1(body, end, archive);
+	}
+
+	throw std::runtime_error("Incompatible archive version");
+}
+
+uint32_t DiiArchive::loadArchive_2(const char* begin, const char* end, LoadedArchive& archive)
+{
+	// the checksum covers the header, too
+	const char* archiveBegin = begin - sizeof(ARCHIVE_HEADER);
+	if (static_cast<size_t>(end - begin) < sizeof(ARCHIVE_LAYOUT) + sizeof(uint32_t)) {
+		throw std::runtime_error("Unexpected end of archive");
+	}
+
+	end -= sizeof(uint32_t);
+	uint32_t checksum = 0;
+	std::memcpy(&checksum, end, sizeof(checksum));
+	if (checksum != archiveChecksum(archiveBegin, end - archiveBegin)) {
+		throw std::runtime_error("Archive checksum mismatch");
+	}
+
+	ArchiveReader reader(begin, end);
+	readArchiveBlocks(reader, archive, archive.proxies);
+	return checksum;
+}
+
+uint32_t DiiArchive::loadArchive_1_1(const char* begin, const char* end, LoadedArchive& archive)
+{
+	MemoryStreamBuffer buffer(begin, end);
+	std::istream is(&buffer);
+	is.exceptions(std::ios::failbit | std::ios::badbit);
+
+	uint32_t size = 0;
+	StreamArchive::readValue(is, size);
+
+	for (uint32_t i = 0; i != size; ++i) {
+		auto instance = archive.createInstance();
+		instance->deserialize(is);
+		archive.addInstance(std::move(instance));
+	}
+
+	uint32_t proxiesSize = 0;
+	StreamArchive::readValue(is, proxiesSize);
+
+	for (uint32_t i = 0; i != proxiesSize; ++i) {
+
+		std::string sourceInstanceName;
+		std::string targetInstanceName;
+		StreamArchive::readString(is, sourceInstanceName);
+		StreamArchive::readString(is, targetInstanceName);
+		archive.proxies.emplace_back(sourceInstanceName, targetInstanceName);
+	}
+
+	return 0;
+}
+
+void DiiArchive::applyJournal(const std::vector<char>& journal, uint32_t baseChecksum, LoadedArchive& archive)
+{
+	ArchiveReader reader(journal.data(), journal.data() + journal.size());
+	ProxyList proxies;
+	const uint32_t REQUIRED_FLAGS = ARCHIVE_JOURNAL_ENTRY::HAS_NAME_ALLOCATOR | ARCHIVE_JOURNAL_ENTRY::HAS_DELTA_RECORDS;
+
+	// the begin of the first entry that isn't applied
+	const char* unapplied = reader.getPosition();
+
+	try {
+		while (reader.getRemaining() != 0) {
+			ARCHIVE_JOURNAL_ENTRY entry;
+			reader.read(entry);
+
+			// entries of an older archive are left over if the archive couldn't be rewritten completely
+			if (entry.magic != ARCHIVE_JOURNAL_ENTRY::MAGIC || entry.baseChecksum != baseChecksum) break;
+			if ((entry.flags & REQUIRED_FLAGS) != REQUIRED_FLAGS) break;
+
+			// the body and its checksum; entry.size + sizeof(uint32_t) might wrap around
+			reader.requireCount<char>(entry.size);
+			if (reader.getRemaining() - entry.size < sizeof(uint32_t)) {
+				throw std::runtime_error("Unexpected end of archive");
+			}
+
+			const char* body = reader.getPosition();
+			uint32_t checksum = 0;
+			std::memcpy(&checksum, body + entry.size, sizeof(checksum));
+			if (checksum != archiveChecksum(body, entry.size)) break;
+
+			ArchiveReader bodyReader(body, body + entry.size);
+			readArchiveBlocks(bodyReader, archive, proxies);
+			if (entry.flags & ARCHIVE_JOURNAL_ENTRY::HAS_PROXIES) {
+				archive.proxies = std::move(proxies);
+			}
+
+			reader.skip(entry.size);
+			reader.skip(sizeof(uint32_t));
+			unapplied = reader.getPosition();
+			++archive.journalEntryCount;
+		}
+	}
+	catch (const std::exception& e) {
+		// an interrupted save leaves a truncated entry; all complete entries are kept
+		archive.warnings.push_back(std::string("journal ends with an incomplete entry: ") + e.what());
+	}
+
+	const size_t ignored = journal.data() + journal.size() - unapplied;
+	if (ignored != 0) {
+		archive.warnings.push_back("ignored " + std::to_string(ignored) + " journal bytes not belonging to the archive");
+	}
+}
@@ -0,0 +1,501 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <DiiRecord.h>
+#include <stdexcept>
+#include <cstring>
+
+std::unordered_map<DiiRecord::StringHandle, std::shared_ptr<const DiiRecord::FieldImage>> DiiRecord::mPrototypeImages;
+constexpr int DiiRecord::FIELD_COUNT;
+constexpr DiiRecord::FieldRun DiiRecord::FIELD_RUNS[];
+
+/**
+ * Checks that FIELD_RUNS covers every field and symbol of a FieldImage exactly once and in field order.
+ */
+static constexpr bool isValidFieldTable()
+{
+	int nextInt = 0;
+	int nextString = 0;
+	int nextSymbol = 0;
+
+	for (const auto& run : DiiRecord::FIELD_RUNS) {
+		if (run.kind == DiiRecord::FieldRun::INTS) {
+			if (run.field != nextInt) return false;
+			nextInt += run.count;
+			continue;
+		}
+
+		if (run.field != nextString) return false;
+		nextString += run.count;
+
+		if (run.kind == DiiRecord::FieldRun::SYMBOLS) {
+			if (run.symbol != nextSymbol) return false;
+			nextSymbol += run.count;
+		}
+	}
+
+	return nextInt == DiiRecord::INT_FIELD_COUNT
+		&& nextString == DiiRecord::STRING_FIELD_COUNT
+		&& nextSymbol == DiiRecord::SYMBOL_FIELD_COUNT;
+}
+
+static_assert(isValidFieldTable(), "DiiRecord::FIELD_RUNS doesn't match the fields of DiiRecord::FieldImage");
+
+DiiRecord::DiiRecord() : mPrototypeImage(getEmptyImage())
+{
+}
+
+DiiRecord::~DiiRecord()
+{
+}
+
+static void writePooledString(std::ostream& os, DiiRecord::StringHandle handle)
+{
+	StreamArchive::writeString(os, StringPool::getStringPool()->resolve(handle));
+}
+
+static void readPooledString(std::istream& is, DiiRecord::StringHandle& handle)
+{
+	std::string data;
+	StreamArchive::readString(is, data);
+	handle = StringPool::getStringPool()->intern(data);
+}
+
+static void writeRecordString(ArchiveWriter& writer, ArchiveStringTable& strings, DiiRecord::StringHandle handle)
+{
+	writer.write(strings.add(handle));
+}
+
+static DiiRecord::StringHandle toRecordStringHandle(uint32_t index, const std::vector<DiiRecord::StringHandle>& strings)
+{
+	if (index >= strings.size()) {
+		throw std::runtime_error("Invalid string table index in archive record");
+	}
+
+	return strings[index];
+}
+
+static DiiRecord::StringHandle readRecordString(ArchiveReader& reader, const std::vector<DiiRecord::StringHandle>& strings)
+{
+	uint32_t index = 0;
+	reader.read(index);
+	return toRecordStringHandle(index, strings);
+}
+
+const std::string& DiiRecord::getPrototypeSymbolName() {
+	return StringPool::getStringPool()->resolve(mPrototypeSymbolName);
+};
+
+void DiiRecord::setPrototypeSymbolName(const std::string& symbolName){
+	const auto handle = StringPool::getStringPool()->intern(symbolName);
+	mDirty = true;
+	if (handle == mPrototypeSymbolName) return;
+
+	// the overrides have to refer to the image of the new prototype
+	FieldImage image;
+	getFieldImage(image);
+	mPrototypeSymbolName = handle;
+	setFieldImage(image);
+}
+
+void DiiRecord::setPrototype(const std::string& symbolName, const FieldImage& prototypeImage)
+{
+	mPrototypeSymbolName = StringPool::getStringPool()->intern(symbolName);
+
+	auto& shared = mPrototypeImages[mPrototypeSymbolName];
+	if (!shared) shared = std::make_shared<const FieldImage>(prototypeImage);
+	mPrototypeImage = shared;
+
+	memset(mOverrideMask, 0, sizeof(mOverrideMask));
+	mOverrides.clear();
+	mResolvedIndices.parserGeneration = 0;
+	mDirty = true;
+}
+
+bool DiiRecord::hasPrototypeImage(const std::string& symbolName)
+{
+	const auto handle = StringPool::getStringPool()->intern(symbolName);
+	return mPrototypeImages.find(handle) != mPrototypeImages.end();
+}
+
+const std::string& DiiRecord::getSymbolName()
+{
+	return mSymbolName;
+}
+
+void DiiRecord::setSymbolName(const std::string& symbolName)
+{
+	mSymbolName = symbolName;
+	mDirty = true;
+}
+
+void DiiRecord::serialize(std::ostream& os) const
+{
+	FieldImage image;
+	getFieldImage(image);
+
+	StreamArchive::writeString(os, mSymbolName);	
+	writePooledString(os, mPrototypeSymbolName);
+	StreamArchive::writeValue(os, zCPar_Symbol_Bitfield);
+
+	for (const auto& run : FIELD_RUNS) {
+		for (int i = run.field; i < run.field + run.count; ++i) {
+			if (run.kind == FieldRun::INTS) {
+				StreamArchive::writeValue(os, image.ints[i]);
+			}
+			else {
+				writePooledString(os, image.strings[i]);
+			}
+		}
+	}
+
+	getUserDataRecord().serialize(os);
+}
+
+void DiiRecord::deserialize(std::istream& is)
+{
+	StreamArchive::readString(is, mSymbolName);
+	readPooledString(is, mPrototypeSymbolName);
+	StreamArchive::readValue(is, zCPar_Symbol_Bitfield);
+
+	FieldImage image;
+	for (const auto& run : FIELD_RUNS) {
+		for (int i = run.field; i < run.field + run.count; ++i) {
+			if (run.kind == FieldRun::INTS) {
+				StreamArchive::readValue(is, image.ints[i]);
+			}
+			else {
+				readPooledString(is, image.strings[i]);
+			}
+		}
+	}
+
+	setFieldImage(image);
+	mResolvedIndices.parserGeneration = 0;
+
+	getUserDataRecord().deserialize(is);
+}
+
+void DiiRecord::writeDeltaRecord(ArchiveWriter& writer, ArchiveStringTable& strings, uint32_t imageIndex) const
+{
+	writer.write(zCPar_Symbol_Bitfield);
+	writer.write(strings.addUnique(mSymbolName));
+	writeRecordString(writer, strings, mPrototypeSymbolName);
+	writer.write(imageIndex);
+	writer.write(mOverrideMask);
+
+	// the overridden values are written with a single copy
+	int values[FIELD_COUNT];
+	size_t next = 0;
+	for (int field = 0; field < FIELD_COUNT && next < mOverrides.size(); ++field) {
+		if (!isOverridden(field)) continue;
+
+		const auto value = mOverrides[next];
+		values[next++] = field < INT_FIELD_COUNT ? value : static_cast<int>(strings.add(static_cast<StringHandle>(value)));
+	}
+	writer.write(values, next * sizeof(int));
+}
+
+size_t DiiRecord::getDeltaRecordSize() const
+{
+	return sizeof(zCPar_Symbol_Bitfield) + 3 * sizeof(uint32_t) + sizeof(mOverrideMask) + mOverrides.size() * sizeof(int);
+}
+
+void DiiRecord::readDeltaRecord(ArchiveReader& reader, const std::vector<StringHandle>& strings,
+	const std::vector<std::shared_ptr<const FieldImage>>& images)
+{
+	uint32_t imageIndex = 0;
+	auto* pool = StringPool::getStringPool();
+	reader.read(zCPar_Symbol_Bitfield);
+	mSymbolName = pool->resolve(readRecordString(reader, strings));
+	mPrototypeSymbolName = readRecordString(reader, strings);
+	reader.read(imageIndex);
+	reader.read(mOverrideMask);
+
+	if (imageIndex >= images.size()) {
+		throw std::runtime_error("Invalid prototype image index in archive record");
+	}
+
+	// unused mask bits have to be zero
+	const auto usedBits = FIELD_COUNT % 32;
+	if (usedBits != 0 && (mOverrideMask[OVERRIDE_MASK_WORDS - 1] >> usedBits) != 0) {
+		throw std::runtime_error("Invalid override mask in archive record");
+	}
+
+	mPrototypeImage = images[imageIndex];
+
+	size_t count = 0;
+	for (int field = 0; field < FIELD_COUNT; ++field) {
+		if (isOverridden(field)) ++count;
+	}
+
+	reader.requireCount<int>(count);
+	mOverrides.resize(count);
+	reader.read(mOverrides.data(), count * sizeof(int));
+
+	// string fields are stored as string table indices
+	size_t next = 0;
+	for (int field = 0; field < FIELD_COUNT; ++field) {
+		if (!isOverridden(field)) continue;
+
+		auto& value = mOverrides[next++];
+		if (field >= INT_FIELD_COUNT) {
+			value = static_cast<int>(toRecordStringHandle(static_cast<uint32_t>(value), strings));
+		}
+	}
+
+	// the first loaded image of a prototype is shared with new instances of the prototype
+	if (mPrototypeSymbolName != StringPool::EMPTY) {
+		auto& shared = mPrototypeImages[mPrototypeSymbolName];
+		if (!shared) shared = mPrototypeImage;
+	}
+
+	mResolvedIndices.parserGeneration = 0;
+}
+
+// The archived image has the layout of a FieldImage with string table indices instead of pool handles.
+static_assert(sizeof(DiiRecord::FieldImage) == DiiRecord::INT_FIELD_COUNT * sizeof(int)
+	+ DiiRecord::STRING_FIELD_COUNT * sizeof(uint32_t), "FieldImage has to be written without padding");
+
+void DiiRecord::writeFieldImage(ArchiveWriter& writer, ArchiveStringTable& strings, const FieldImage& image)
+{
+	FieldImage record = image;
+	for (auto& handle : record.strings) {
+		handle = strings.add(handle);
+	}
+	writer.write(record);
+}
+
+void DiiRecord::readFieldImage(ArchiveReader& reader, const std::vector<StringHandle>& strings, FieldImage& image)
+{
+	reader.read(image);
+	for (auto& handle : image.strings) {
+		handle = toRecordStringHandle(handle, strings);
+	}
+}
+
+void DiiRecord::getFieldImage(FieldImage& image) const
+{
+	image = *mPrototypeImage;
+
+	size_t next = 0;
+	for (int field = 0; field < FIELD_COUNT && next < mOverrides.size(); ++field) {
+		if (!isOverridden(field)) continue;
+
+		const auto value = mOverrides[next++];
+		if (field < INT_FIELD_COUNT) {
+			image.ints[field] = value;
+		}
+		else {
+			image.strings[field - INT_FIELD_COUNT] = static_cast<StringHandle>(value);
+		}
+	}
+}
+
+void DiiRecord::setFieldImage(const FieldImage& image)
+{
+	if (mPrototypeSymbolName == StringPool::EMPTY) {
+		// not assigned to a prototype yet; nothing to share
+		mPrototypeImage = std::make_shared<const FieldImage>(image);
+	}
+	else {
+		auto& shared = mPrototypeImages[mPrototypeSymbolName];
+		if (!shared) shared = std::make_shared<const FieldImage>(image);
+		mPrototypeImage = shared;
+	}
+
+	const auto& prototype = *mPrototypeImage;
+	memset(mOverrideMask, 0, sizeof(mOverrideMask));
+	mOverrides.clear();
+
+	for (int field = 0; field < INT_FIELD_COUNT; ++field) {
+		if (image.ints[field] == prototype.ints[field]) continue;
+		mOverrideMask[field / 32] |= 1u << (field % 32);
+		mOverrides.push_back(image.ints[field]);
+	}
+
+	for (int i = 0; i < STRING_FIELD_COUNT; ++i) {
+		if (image.strings[i] == prototype.strings[i]) continue;
+		const int field = INT_FIELD_COUNT + i;
+		mOverrideMask[field / 32] |= 1u << (field % 32);
+		mOverrides.push_back(static_cast<int>(image.strings[i]));
+	}
+
+	mOverrides.shrink_to_fit();
+}
+
+int DiiRecord::getIntField(IntField field) const
+{
+	return getFieldValue(field);
+}
+
+DiiRecord::StringHandle DiiRecord::getStringField(StringField field) const
+{
+	return static_cast<StringHandle>(getFieldValue(INT_FIELD_COUNT + field));
+}
+
+const std::shared_ptr<const DiiRecord::FieldImage>& DiiRecord::getPrototypeImage() const
+{
+	return mPrototypeImage;
+}
+
+size_t DiiRecord::getOverrideCount() const
+{
+	return mOverrides.size();
+}
+
+void DiiRecord::releasePrototypeImages()
+{
+	mPrototypeImages.clear();
+}
+
+size_t DiiRecord::getPrototypeImageCount()
+{
+	return mPrototypeImages.size();
+}
+
+void DiiRecord::markStrings(StringPool& pool) const
+{
+	pool.mark(mPrototypeSymbolName);
+	if (mPrototypeImage) markFieldImage(*mPrototypeImage, pool);
+
+	for (int field = INT_FIELD_COUNT; field < FIELD_COUNT; ++field) {
+		if (isOverridden(field)) pool.mark(static_cast<StringHandle>(mOverrides[getOverridePosition(field)]));
+	}
+}
+
+void DiiRecord::markFieldImage(const FieldImage& image, StringPool& pool)
+{
+	for (auto handle : image.strings) {
+		pool.mark(handle);
+	}
+}
+
+void DiiRecord::markPrototypeImages(StringPool& pool)
+{
+	for (auto it = mPrototypeImages.begin(); it != mPrototypeImages.end();) {
+		if (it->second.use_count() == 1) {
+			it = mPrototypeImages.erase(it);
+			continue;
+		}
+
+		pool.mark(it->first);
+		markFieldImage(*it->second, pool);
+		++it;
+	}
+}
+
+bool DiiRecord::isOverridden(int field) const
+{
+	return (mOverrideMask[field / 32] & (1u << (field % 32))) != 0;
+}
+
+int DiiRecord::getFieldValue(int field) const
+{
+	if (isOverridden(field)) return mOverrides[getOverridePosition(field)];
+	if (field < INT_FIELD_COUNT) return mPrototypeImage->ints[field];
+	return static_cast<int>(mPrototypeImage->strings[field - INT_FIELD_COUNT]);
+}
+
+size_t DiiRecord::getOverridePosition(int field) const
+{
+	size_t position = 0;
+	for (int i = 0; i <= field / 32; ++i) {
+		auto bits = mOverrideMask[i];
+		if (i == field / 32) bits &= (1u << (field % 32)) - 1;
+
+		// population count
+		bits = bits - ((bits >> 1) & 0x55555555u);
+		bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+		position += (((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+	}
+
+	return position;
+}
+
+const std::shared_ptr<const DiiRecord::FieldImage>& DiiRecord::getEmptyImage()
+{
+	static const std::shared_ptr<const FieldImage> image = std::make_shared<const FieldImage>(FieldImage());
+	return image;
+}
+
+int DiiRecord::getParserSymbolBitfield()
+{
+	return zCPar_Symbol_Bitfield;
+}
+
+void DiiRecord::setParserSymbolBitfield(int bitfield)
+{
+	zCPar_Symbol_Bitfield = bitfield;
+	mDirty = true;
+}
+
+bool DiiRecord::getDoNotStore() const
+{
+	return mDoNotStore;
+}
+
+void DiiRecord::setDoNotStore(bool doNotStore)
+{
+	mDoNotStore = doNotStore;
+}
+
+bool DiiRecord::isDirty() const
+{
+	return mDirty;
+}
+
+void DiiRecord::setDirty(bool dirty)
+{
+	mDirty = dirty;
+}
+
+size_t DiiRecord::getUnpooledStringByteSize() const
+{
+	FieldImage image;
+	getFieldImage(image);
+
+	auto* pool = StringPool::getStringPool();
+	size_t result = StringPool::getUnpooledByteSize(pool->resolve(mPrototypeSymbolName));
+	for (auto handle : image.strings) {
+		result += StringPool::getUnpooledByteSize(pool->resolve(handle));
+	}
+
+	return result;
+}
+
+size_t DiiRecord::getPooledStringByteSize() const
+{
+	// the prototype symbol name and the overridden text fields; the prototype image is shared
+	size_t handleCount = 1;
+	for (int field = INT_FIELD_COUNT; field < FIELD_COUNT; ++field) {
+		if (isOverridden(field)) ++handleCount;
+	}
+
+	return handleCount * sizeof(StringHandle);
+}
@@ -209,7 +209,7 @@ int HookManager::hook(int flags)
 	mInstance->mCalled = true;
 
 	// init Logger since Configuration file is initialized there
-	Logger::getLogger();
+	Logger::getLogger()->startFileWriter();
 
 	mLogStream << __FUNCTION__ << ": read Configuration: " << std::endl;
 	mLogStream << "debugEnabled = " << Configuration::debugEnabled() << std::endl;
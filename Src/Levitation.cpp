@@ -210,14 +210,11 @@ void Levitation::zCVobCheckAndResolveCollisionsHook(void* pThis)
 		float length = std::sqrtf(diff.x * diff.x + diff.y * diff.y + diff.z * diff.z);
 
 
-		auto isTargetActive = Configuration::debugEnabled();
-		if (isTargetActive && intersectionsWithVobs) {
-			mLogStream << __FUNCTION__ << ": original collision detection is used" << std::endl;
-			util::debug(mLogStream);
+		if (intersectionsWithVobs) {
+			UTIL_DEBUGF(Logger::Info, "{}: original collision detection is used\n", __FUNCTION__);
 		}
-		else if (isTargetActive) {
-			mLogStream << __FUNCTION__ << ": custom collision detection is used" << std::endl;
-			util::debug(mLogStream);
+		else {
+			UTIL_DEBUGF(Logger::Info, "{}: custom collision detection is used\n", __FUNCTION__);
 		}
 
 		//if (length < 2.2 || length > 20) return;
@@ -402,8 +399,6 @@ zVEC3 Levitation::levitate() {
 	if (!isLevitationActive()) return positionAdd;
 	if (Levitation::gameIsPaused) return positionAdd;
 
-	std::stringstream mLogStream;
-
 	oCNpc* hero = oCNpc::GetHero();
 	//if (oCNpcIsMovLock(hero)) return positionAdd;
 
@@ -615,18 +610,13 @@ bool checkVobCollision__checkVob(zCVob* vob, const zTBBox3D& boundingBox)
 {
 	if (vob == nullptr) return false;
 
-	std::stringstream mLogStream;
-
-
 	zCArray<void*>* leafObjects = &vob->vobLeafList;
 	zCPolygon** polys;
 	//int third;
 	auto& name = vob->objectName;
 
-	mLogStream << __FUNCTION__ << ": Check object with leaf number: " << leafObjects->GetSize() << std::endl;
-	util::debug(mLogStream);
-	mLogStream << __FUNCTION__ << ": visual name: " << name.ToChar() << std::endl;
-	util::debug(mLogStream);
+	UTIL_DEBUGF(Logger::Info, "{}: Check object with leaf number: {}\n", __FUNCTION__, leafObjects->GetSize());
+	UTIL_DEBUGF(Logger::Info, "{}: visual name: {}\n", __FUNCTION__, name.ToChar());
 
 	for (unsigned int i = 0; i < leafObjects->GetSize(); ++i)
 	{
@@ -643,8 +633,7 @@ bool checkVobCollision__checkVob(zCVob* vob, const zTBBox3D& boundingBox)
 			//util::logInfo(logStream);
 			if (poly->CheckBBoxPolyIntersection(boundingBox))
 			{
-				mLogStream << __FUNCTION__ << ": Intersection found! " << std::endl;
-				util::debug(mLogStream);
+				UTIL_DEBUGF(Logger::Info, "{}: Intersection found! \n", __FUNCTION__);
 				return true;
 			}
 		}
@@ -661,14 +650,11 @@ bool Levitation::checkVobCollision(void* zCBspBaseObject, zCVob* testedVob, cons
 
 	if (collectedVobs.GetSize() > 0)
 	{
-		std::stringstream mLogStream;
-		mLogStream << __FUNCTION__ << ": Found vobs!: " << collectedVobs.GetSize() << std::endl;
-		util::logInfo(mLogStream);
+		UTIL_LOGF(Logger::Info, "{}: Found vobs!: {}\n", __FUNCTION__, collectedVobs.GetSize());
 
 		for (unsigned int i = 0; i < collectedVobs.GetSize(); ++i)
 		{
-			mLogStream << __FUNCTION__ << ": test vob with number: " << i << std::endl;
-			util::logInfo(mLogStream);
+			UTIL_LOGF(Logger::Info, "{}: test vob with number: {}\n", __FUNCTION__, i);
 
 			if (i > 0) {
 				bool test = false;
@@ -761,23 +747,13 @@ bool Levitation::checkForLevitationStaticCollision(oCNpc* hero, const zMAT4& mat
 
 					if (hasNoCollision)
 					{
-						if (Configuration::debugEnabled()) {
-							std::stringstream logStream;
-							logStream << __FUNCTION__ << ": ignore poly with no collision flagged material" << std::endl;
-							util::debug(logStream);
-						}
-						
+						UTIL_DEBUGF(Logger::Info, "{}: ignore poly with no collision flagged material\n", __FUNCTION__);
 						continue;
 					}
 
 					if (isGhostOccluder)
 					{
-						if (Configuration::debugEnabled()) {
-							std::stringstream logStream;
-							logStream << __FUNCTION__ << ": ignore poly with GHOSTOCCLUDER material" << std::endl;
-							util::debug(logStream);
-						}
-						
+						UTIL_DEBUGF(Logger::Info, "{}: ignore poly with GHOSTOCCLUDER material\n", __FUNCTION__);
 						continue;
 					}
 
@@ -794,11 +770,7 @@ bool Levitation::checkForLevitationStaticCollision(oCNpc* hero, const zMAT4& mat
 					if (!intersected && !hasNoCollision && !isGhostOccluder) {
 						intersected = true;
 
-						if (Configuration::debugEnabled()) {
-							std::stringstream logStream;
-							logStream << __FUNCTION__ << ": intersection found!: " << materialName << std::endl;
-							util::debug(logStream);
-						}
+						UTIL_DEBUGF(Logger::Info, "{}: intersection found!: {}\n", __FUNCTION__, materialName);
 
 						break;
 					}
@@ -844,12 +816,7 @@ bool Levitation::checkForLevitationVobCollision(oCNpc* hero, const zMAT4& mat)
 
 	if (collectedVobs.GetSize() > 1) // hero is always included!
 	{
-		if (Configuration::debugEnabled()) {
-			std::stringstream mLogStream;
-			mLogStream << __FUNCTION__ << ": Found vobs: " << collectedVobs.GetSize() - 1 << std::endl;
-			util::debug(mLogStream);
-		}
-		
+		UTIL_DEBUGF(Logger::Info, "{}: Found vobs: {}\n", __FUNCTION__, collectedVobs.GetSize() - 1);
 
 		for (unsigned int i = 0; i < collectedVobs.GetSize(); ++i)
 		{
@@ -877,7 +844,6 @@ bool Levitation::checkForLevitationVobCollision(oCNpc* hero, const zMAT4& mat)
 
 bool Levitation::doCustomCollisionCheck(oCNpc* npc) {
 
-	std::stringstream mLogStream;
 	zTBBox3D bBox = LevitationData::zCModelGetBBox3D(npc->GetModel());// ->GetBBox3D();
 	zVEC3 pos = npc->GetPosition();
 	zMAT4* mat = &(npc->trafoObjToWorld);
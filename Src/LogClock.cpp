@@ -0,0 +1,58 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <LogClock.h>
+#include <cstring>
+
+LogClock::LogClock() : mStart(Clock::now())
+{
+}
+
+LogClock::TimeStamp LogClock::now()
+{
+	TimeStamp stamp;
+	stamp.microseconds = static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - mStart).count());
+
+	const time_t current = time(NULL);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (current != mCachedTime) {
+		tm localTime;
+		localtime_s(&localTime, &current);
+
+		mCachedTime = current;
+		mCachedSecondsOfDay = static_cast<uint32_t>(localTime.tm_hour * 3600 + localTime.tm_min * 60 + localTime.tm_sec);
+		LogFormat::formatWallClock(mCachedSecondsOfDay, mCachedWallClock, sizeof(mCachedWallClock));
+	}
+
+	stamp.secondsOfDay = mCachedSecondsOfDay;
+	std::memcpy(stamp.wallClock, mCachedWallClock, sizeof(stamp.wallClock));
+	return stamp;
+}
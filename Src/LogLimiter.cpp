@@ -0,0 +1,126 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <LogLimiter.h>
+#include <algorithm>
+
+constexpr std::chrono::seconds LogLimiter::FOLD_INTERVAL;
+
+LogLimiter::LogLimiter(double messagesPerSecond, double burst, bool foldRepeats) :
+	mMessagesPerSecond(std::max(messagesPerSecond, 0.0)), mBurst(std::max(burst, 1.0)), mFoldRepeats(foldRepeats)
+{
+}
+
+bool LogLimiter::acquire(Logger::CallSite& site, uint32_t& suppressed)
+{
+	suppressed = 0;
+	if (mMessagesPerSecond == 0) return true;
+
+	const auto now = Clock::now();
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (!site.initialized) {
+		site.tokens = mBurst;
+		site.lastRefill = now;
+		site.initialized = true;
+	}
+	else {
+		const std::chrono::duration<double> elapsed = now - site.lastRefill;
+		site.tokens = std::min(mBurst, site.tokens + elapsed.count() * mMessagesPerSecond);
+		site.lastRefill = now;
+	}
+
+	if (site.tokens < 1.0) {
+		++site.suppressed;
+		return false;
+	}
+
+	site.tokens -= 1.0;
+	suppressed = site.suppressed;
+	site.suppressed = 0;
+	return true;
+}
+
+bool LogLimiter::fold(Logger::LogLevel level, uint32_t formatId, const std::string& payload, Repeats& folded)
+{
+	folded = Repeats();
+	if (!mFoldRepeats) return false;
+
+	const auto now = Clock::now();
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const bool repeat = mHasLast && level < Logger::Fault && level == mLastLevel && formatId == mLastFormatId
+		&& payload == mLastPayload;
+
+	if (repeat) {
+		if (mRepeatCount == 0) {
+			mFirstRepeat = now;
+		}
+		else if (now - mFirstRepeat >= FOLD_INTERVAL) {
+			// report the repeats so far and log the message again
+			folded.level = mLastLevel;
+			folded.count = mRepeatCount;
+			mRepeatCount = 0;
+			return false;
+		}
+
+		++mRepeatCount;
+		return true;
+	}
+
+	folded.level = mLastLevel;
+	folded.count = mRepeatCount;
+
+	mLastLevel = level;
+	mLastFormatId = formatId;
+	mLastPayload = payload;
+	mHasLast = true;
+	mRepeatCount = 0;
+	return false;
+}
+
+LogLimiter::Repeats LogLimiter::takeRepeats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	Repeats repeats;
+	repeats.level = mLastLevel;
+	repeats.count = mRepeatCount;
+	mRepeatCount = 0;
+	return repeats;
+}
+
+std::string LogLimiter::getRepeatsMessage(const Repeats& repeats)
+{
+	return "last message repeated " + std::to_string(repeats.count) + " times\n";
+}
+
+std::string LogLimiter::getSuppressedMessage(uint32_t suppressed)
+{
+	return "rate limit: suppressed " + std::to_string(suppressed) + " earlier messages like the next one\n";
+}
@@ -0,0 +1,248 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <LogWriter.h>
+#include <Windows.h>
+#include <io.h>
+#include <algorithm>
+#include <cctype>
+#include <thread>
+
+constexpr size_t LogWriter::CAPACITY;
+constexpr size_t LogWriter::MASK;
+constexpr std::chrono::milliseconds LogWriter::WRITE_INTERVAL;
+
+LogWriter::LogWriter(const std::string& filePath, FlushPolicy policy) : mCells(new Cell[CAPACITY]), mPolicy(policy)
+{
+	for (size_t i = 0; i != CAPACITY; ++i) {
+		mCells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	// binary mode: binary log records must be written byte for byte (no LF -> CR LF translation)
+	fopen_s(&mFile, filePath.c_str(), "ab");
+}
+
+LogWriter::~LogWriter()
+{
+	if (mThread) {
+		std::unique_lock<std::mutex> lock(mWakeMutex);
+		mStop = true;
+		mWake.notify_one();
+
+		// If the process terminates, the writer thread is already gone. Otherwise we wait for the thread
+		// to finish its queue; joining isn't possible, as this might run while the loader lock is held.
+		// The thread's remaining code is safe, as the thread holds a module reference until it exits.
+		if (WaitForSingleObject(mThread, 0) != WAIT_OBJECT_0) {
+			mWake.wait(lock, [this] { return mStopped; });
+		}
+
+		lock.unlock();
+		CloseHandle(mThread);
+	}
+
+	// messages left by a terminated writer thread
+	drain();
+
+	if (mFile) {
+		fclose(mFile);
+	}
+}
+
+void LogWriter::start()
+{
+	if (mStarted.exchange(true)) return;
+
+	HMODULE module = NULL;
+	if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCTSTR>(&LogWriter::threadMain), &module)) {
+		mStarted = false;
+		return;
+	}
+
+	mModule = module;
+	mThread = CreateThread(NULL, 0, &LogWriter::threadMain, this, 0, NULL);
+	if (!mThread) {
+		FreeLibrary(module);
+		mModule = nullptr;
+		mStarted = false;
+	}
+}
+
+void LogWriter::push(Logger::LogLevel level, std::string message)
+{
+	Entry entry;
+	entry.level = level;
+	entry.message = std::move(message);
+
+	while (!tryPush(entry)) {
+		// full: write the queue ourselves if there is no writer thread; otherwise let it catch up
+		if (!mStarted.load()) {
+			flush();
+			continue;
+		}
+
+		requestWake();
+		std::this_thread::yield();
+	}
+
+	// Wake the writer early if the buffer fills up; otherwise it writes every WRITE_INTERVAL.
+	const auto dequeuePos = mDequeuePos.load(std::memory_order_relaxed);
+	const auto queued = mEnqueuePos.load(std::memory_order_relaxed) - dequeuePos;
+	if (queued > CAPACITY / 2) {
+		requestWake();
+	}
+}
+
+void LogWriter::flush()
+{
+	std::lock_guard<std::timed_mutex> lock(mFileMutex);
+	writePending(true);
+}
+
+void LogWriter::drain()
+{
+	if (!mFileMutex.try_lock_for(std::chrono::milliseconds(500))) return;
+	writePending(true);
+	mFileMutex.unlock();
+}
+
+LogWriter::FlushPolicy LogWriter::parseFlushPolicy(const std::string& text)
+{
+	std::string lower = text;
+	std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+	if (lower == "never") return FlushPolicy::Never;
+	if (lower == "fatal") return FlushPolicy::Fatal;
+	return FlushPolicy::Batch;
+}
+
+bool LogWriter::tryPush(Entry& entry)
+{
+	auto pos = mEnqueuePos.load(std::memory_order_relaxed);
+	Cell* cell;
+
+	while (true) {
+		cell = &mCells[pos & MASK];
+		const auto sequence = cell->sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+		if (diff == 0) {
+			// the cell is free; claim it
+			if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+		}
+		else if (diff < 0) {
+			// the cell wasn't consumed yet: the buffer is full
+			return false;
+		}
+		else {
+			// another producer claimed the cell
+			pos = mEnqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->entry = std::move(entry);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+bool LogWriter::tryPop(Entry& entry)
+{
+	const auto pos = mDequeuePos.load(std::memory_order_relaxed);
+	auto& cell = mCells[pos & MASK];
+	const auto sequence = cell.sequence.load(std::memory_order_acquire);
+	if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0) return false;
+
+	entry = std::move(cell.entry);
+	cell.entry.message.clear();
+	cell.sequence.store(pos + CAPACITY, std::memory_order_release);
+	mDequeuePos.store(pos + 1, std::memory_order_relaxed);
+	return true;
+}
+
+void LogWriter::writePending(bool commit)
+{
+	Entry entry;
+	bool written = false;
+
+	while (tryPop(entry)) {
+		if (mFile) {
+			fwrite(entry.message.data(), 1, entry.message.size(), mFile);
+		}
+		commit |= mPolicy == FlushPolicy::Fatal && entry.level == Logger::Fatal;
+		written = true;
+	}
+
+	if (!written || !mFile) return;
+
+	fflush(mFile);
+
+	if (commit || mPolicy == FlushPolicy::Batch) {
+		_commit(_fileno(mFile));
+	}
+}
+
+void LogWriter::requestWake()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mWakeRequested = true;
+	}
+	mWake.notify_one();
+}
+
+void LogWriter::run()
+{
+	bool stop = false;
+
+	while (!stop) {
+		{
+			std::unique_lock<std::mutex> lock(mWakeMutex);
+			mWake.wait_for(lock, WRITE_INTERVAL, [this] { return mStop || mWakeRequested; });
+			mWakeRequested = false;
+			stop = mStop;
+		}
+
+		std::lock_guard<std::timed_mutex> lock(mFileMutex);
+		writePending(false);
+	}
+
+	std::lock_guard<std::mutex> lock(mWakeMutex);
+	mStopped = true;
+	mWake.notify_all();
+}
+
+unsigned long __stdcall LogWriter::threadMain(void* param)
+{
+	auto* writer = static_cast<LogWriter*>(param);
+
+	// the writer might be destroyed as soon as run() returns
+	auto module = static_cast<HMODULE>(writer->mModule);
+	writer->run();
+
+	FreeLibraryAndExitThread(module, 0);
+	return 0;
+}
@@ -35,13 +35,32 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #include <iostream>
 #include <sstream>
 #include <Configuration.h>
-#include <ctime>
+#include <LogWriter.h>
+#include <LogLimiter.h>
 
 class zERROR;
 
 Logger* Logger::instance = NULL;
 std::string Logger::logFileName;
 
+static LPTOP_LEVEL_EXCEPTION_FILTER previousExceptionFilter = NULL;
+
+/**
+ * Writes the queued log file messages before the process dies of an unhandled exception.
+ */
+static LONG WINAPI onUnhandledException(EXCEPTION_POINTERS* info)
+{
+	if (Logger* logger = Logger::getLogger()) {
+		logger->flushFile();
+	}
+
+	if (previousExceptionFilter) {
+		return previousExceptionFilter(info);
+	}
+
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
 typedef int (__thiscall* ZERROR_REPORT)(void* pThis, int errorType, int, zSTRING const &, signed char, UINT, int, char*, char*);
 ZERROR_REPORT zErrorReport;
 
@@ -52,6 +71,30 @@ Logger::Logger()
 
 Logger::~Logger()
 {
+	// The engine might be gone already; thus pending repeats are only reported to the log file
+	if (limiter && fileWriter) {
+		const auto repeats = limiter->takeRepeats();
+		if (repeats.count) {
+			const auto message = LogLimiter::getRepeatsMessage(repeats);
+			const auto stamp = clock.now();
+			if (binaryFile) {
+				std::string args;
+				LogFormat::appendArg(args, message);
+				writeToFile(repeats.level, createRecord(repeats.level, stamp, LogFormat::TEXT_FORMAT_ID, args));
+			}
+			else {
+				writeToFile(repeats.level, createOutputWithLogLevel(repeats.level, stamp, message));
+			}
+		}
+	}
+
+	if (fileWriter) {
+		// Restore the previous filter, unless another filter was installed in the meantime
+		auto current = SetUnhandledExceptionFilter(previousExceptionFilter);
+		if (current != onUnhandledException) {
+			SetUnhandledExceptionFilter(current);
+		}
+	}
 }
 
 Logger* Logger::getLogger()
@@ -69,11 +112,30 @@ Logger* Logger::getLogger()
 		instance->toFile = Configuration::getLogToFile();
 		instance->tozSpy = Configuration::getLogTozSpy();
 		instance->toConsole = Configuration::getLogToConsole();
+
+		if (Configuration::getLogRateLimit() > 0 || Configuration::getLogFoldRepeats()) {
+			instance->limiter = std::make_unique<LogLimiter>(Configuration::getLogRateLimit(),
+				Configuration::getLogRateBurst(), Configuration::getLogFoldRepeats());
+		}
+
 		std::string logFilePath = util::getModuleDirectory(util::getModuleHandle()) + std::string("\\") 
 			+ logFileName;
-		std::ofstream logFile(logFilePath.c_str());
+		std::ofstream logFile(logFilePath.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
 		if (logFile.is_open())
 			logFile.close();
+
+		if (instance->toFile) {
+			instance->fileWriter = std::make_unique<LogWriter>(logFilePath,
+				LogWriter::parseFlushPolicy(Configuration::getLogFileFlush()));
+			previousExceptionFilter = SetUnhandledExceptionFilter(onUnhandledException);
+
+			instance->binaryFile = Configuration::getLogBinary();
+			if (instance->binaryFile) {
+				std::string header;
+				LogFormat::appendRaw(header, LogFormat::FILE_HEADER());
+				instance->fileWriter->push(Info, std::move(header));
+			}
+		}
 	}
 	return instance;
 }
@@ -83,17 +145,30 @@ void Logger::release()
 	SAFE_DELETE(instance);
 }
 
-void Logger::writeToFile(const std::string& message)
+void Logger::writeToFile(LogLevel level, const std::string& message)
 {
+	if (!fileWriter) return;
 
-	std::string logFilePath = util::getModuleDirectory(util::getModuleHandle()) + std::string("\\") 
-			+ logFileName;
-	FILE* pFile;
-	fopen_s(&pFile, logFilePath.c_str(),"a");
-	fputs(message.c_str(), pFile);
-	fflush(pFile);
-	_commit(_fileno(pFile));
-	fclose(pFile);
+	fileWriter->push(level, message);
+
+	// the game might be shut down after a fatal message
+	if (level == Fatal) {
+		fileWriter->flush();
+	}
+}
+
+void Logger::flushFile()
+{
+	if (fileWriter) {
+		fileWriter->drain();
+	}
+}
+
+void Logger::startFileWriter()
+{
+	if (fileWriter) {
+		fileWriter->start();
+	}
 }
 
 void Logger::writeTozSpy(LogLevel level, const std::string& msg)
@@ -121,49 +196,47 @@ void Logger::writeTozSpy(LogLevel level, const std::string& msg)
 	}	
 }
 
-void Logger::writeToConsole(LogLevel level, const std::string& message)
+void Logger::writeToConsole(const std::string& output)
 {
-	std::string timeStamp = getTimeStamp();
-	std::cout << "["<< getTimeStamp() << ", " << logLevelToString(level) <<"]    " << message;
+	std::cout << output;
 }
 
 void Logger::logAlways(std::stringstream& stream)
 {
-	//make time stamp and add it along with the log level in front of the log message
-	std::string timeStamp = getTimeStamp();
+	//make time stamp and add it in front of the log message
+	const auto stamp = clock.now();
+	const std::string text = stream.str();
 
-	// Clear the util stream content before filling it
-	util.clear();
-	util.str("");
-	util << "[" << timeStamp << "]    "
-		<< stream.str();
+	// Clear the string stream's content
+	stream.clear();
+	stream.str("");
 
-	std::string message = util.str();
+	if (toFile && binaryFile)
+	{
+		std::string args;
+		LogFormat::appendArg(args, text);
+		writeToFile(Info, createRecord(0, stamp, LogFormat::TEXT_FORMAT_ID, args));
+	}
 
+	std::string message = createOutputWithLogLevel(0, stamp, text);
 
 	if (toConsole)
 	{
-		writeToConsole(Info, message);
+		writeToConsole(message);
 	}
 
-	if (toFile)
+	if (toFile && !binaryFile)
 	{
-		writeToFile(message);
+		writeToFile(Info, message);
 	}
 
 	if (tozSpy)
 	{
 		writeTozSpy(Info, message);
 	}
-
-	// Clear again
-	util.clear();
-	util.str("");
-	stream.clear();
-	stream.str("");
 }
 
-void Logger::log(LogLevel level, std::stringstream& stream)
+void Logger::log(LogLevel level, std::stringstream& stream, CallSite* site)
 {
 	//early exit
 	if (!isLogLevelActive(level)) { return; }
@@ -173,14 +246,115 @@ void Logger::log(LogLevel level, std::stringstream& stream)
 	stream.clear();
 	stream.str("");
 
+	if (!admit(level, site, LogFormat::TEXT_FORMAT_ID, message)) { return; }
+
+	writeText(level, message);
+}
+
+void Logger::writeText(LogLevel level, const std::string& message)
+{
+	const auto stamp = clock.now();
+
+	if (toFile && binaryFile)
+	{
+		std::string args;
+		LogFormat::appendArg(args, message);
+		auto record = createRecord(level, stamp, LogFormat::TEXT_FORMAT_ID, args);
+		writeMessage(level, stamp, message, &record);
+	}
+	else
+	{
+		writeMessage(level, stamp, message, nullptr);
+	}
+}
+
+uint32_t Logger::registerFormat(const char* format)
+{
+	const uint32_t id = ++lastFormatId;
+
+	if (fileWriter && binaryFile)
+	{
+		const std::string str = format;
+		std::string record;
+		record += static_cast<char>(LogFormat::FORMAT);
+		LogFormat::appendRaw(record, id);
+		LogFormat::appendRaw(record, static_cast<uint32_t>(str.size()));
+		record += str;
+		fileWriter->push(Info, std::move(record));
+	}
+
+	return id;
+}
+
+void Logger::logEncoded(LogLevel level, CallSite* site, uint32_t formatId, const char* format, const std::string& args)
+{
+	if (!isLogLevelActive(level)) { return; }
+	if (!admit(level, site, formatId, args)) { return; }
+
+	const auto stamp = clock.now();
+
+	// Binary log files get the arguments as they are; the message is only formatted for text outputs
+	const bool binaryRecord = toFile && binaryFile;
+	std::string message;
+	if (toConsole || tozSpy || !binaryRecord)
+	{
+		LogFormat::format(format, args.data(), args.size(), message);
+	}
+
+	if (binaryRecord)
+	{
+		auto record = createRecord(level, stamp, formatId, args);
+		writeMessage(level, stamp, message, &record);
+	}
+	else
+	{
+		writeMessage(level, stamp, message, nullptr);
+	}
+}
+
+bool Logger::admit(LogLevel level, CallSite* site, uint32_t formatId, const std::string& payload)
+{
+	if (!limiter) { return true; }
+
+	uint32_t suppressed = 0;
+	if (site && level < Fault && !limiter->acquire(*site, suppressed)) { return false; }
+
+	LogLimiter::Repeats repeats;
+	const bool repeat = limiter->fold(level, formatId, payload, repeats);
+
+	if (repeats.count)
+	{
+		writeText(repeats.level, LogLimiter::getRepeatsMessage(repeats));
+	}
+
+	if (repeat) { return false; }
+
+	if (suppressed)
+	{
+		writeText(level, LogLimiter::getSuppressedMessage(suppressed));
+	}
+
+	return true;
+}
+
+void Logger::writeMessage(LogLevel level, const LogClock::TimeStamp& stamp, const std::string& message,
+	const std::string* fileRecord)
+{
+	// the console and text log files share the output line
+	std::string output;
+	if (toConsole || (toFile && !fileRecord))
+	{
+		output = createOutputWithLogLevel(level, stamp, message);
+	}
+
 	if (toConsole)
 	{
-		writeToConsole(level, message);	
+		writeToConsole(output);
 	}
 
 	if (toFile)
 	{
-		writeToFile(createOutputWithLogLevel(level, message));
+		writeToFile(level, fileRecord ? *fileRecord : output);
 	}
 
 	if (tozSpy)
@@ -189,6 +363,20 @@ void Logger::log(LogLevel level, std::stringstream& stream)
 	}
 }
 
+std::string Logger::createRecord(int level, const LogClock::TimeStamp& stamp, uint32_t formatId, const std::string& args)
+{
+	std::string record;
+	record.reserve(22 + args.size());
+	record += static_cast<char>(LogFormat::MESSAGE);
+	LogFormat::appendRaw(record, static_cast<uint8_t>(level));
+	LogFormat::appendRaw(record, stamp.secondsOfDay);
+	LogFormat::appendRaw(record, stamp.microseconds);
+	LogFormat::appendRaw(record, formatId);
+	LogFormat::appendRaw(record, static_cast<uint32_t>(args.size()));
+	record += args;
+	return record;
+}
+
 bool Logger::isLogLevelActive(LogLevel level)
 {
 	switch (level) {
@@ -226,32 +414,25 @@ bool Logger::isLogLevelActive(LogLevel level)
 	return false;
 }
 
-std::string Logger::createOutputWithLogLevel(LogLevel level, const std::string& message)
+std::string Logger::createOutputWithLogLevel(int level, const LogClock::TimeStamp& stamp, const std::string& message)
 {
-	//make time stamp and add it along with the log level in front of the log message
-	std::string timeStamp = getTimeStamp();
-	std::string logLevelDesc = logLevelToString(level);
-
-	// Clear the util stream content before filling it
-	util.clear();
-	util.str("");
-	util << "[" << timeStamp << ", " << logLevelDesc << "]    "
-		<< message;
+	//add the time stamp along with the log level in front of the log message
+	std::string output;
+	output.reserve(48 + message.size());
+	LogFormat::appendPrefix(output, stamp.wallClock, level, stamp.microseconds);
+	output += message;
 
-	return util.str();
+	return output;
 }
 
 std::string Logger::logLevelToString(LogLevel level)
 {
 	switch(level) {
 	case Info:
-		return "INFO";
 	case Warning:
-		return "WARNING";
 	case Fault:
-		return "FAULT";
 	case Fatal:
-		return "FATAL";
+		return LogFormat::getLevelName(level);
 	default:
 		std::stringstream ss; ss << "Logger::logLevelToString: unknown log level: " << level << std::endl;
 		logAlways(ss);
@@ -261,15 +442,5 @@ std::string Logger::logLevelToString(LogLevel level)
 
 std::string Logger::getTimeStamp()
 {
-	tm currTime;
-	time_t timeStamp = time(NULL);
-	//currTime = localtime(&timeStamp);
-	localtime_s(&currTime, &timeStamp);
-
-	// Clear the util stream content before filling it
-	util.clear();
-	util.str("");
-	util << currTime.tm_hour << ":" << currTime.tm_min << ":" << currTime.tm_sec;
-
-	return util.str();
+	return clock.now().wallClock;
 };
\ No newline at end of file
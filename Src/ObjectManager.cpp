@@ -43,6 +43,12 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #include <api/g2/oCItemExtended.h>
 #include <Constants.h>
 #include <DII.h>
+#include <StringPool.h>
+#include <Configuration.h>
+#include <SaveWriter.h>
+#include <UserDataArena.h>
+#include <cstdint>
+#include <algorithm>
 
 using namespace std;
 using namespace constants;
@@ -106,25 +112,32 @@ bool ObjectManager::addProxy(const zSTRING & sourceInstance, const zSTRING & tar
 	}
 
 	//check, that we do not add a circle in proxying
-	auto it = mProxies.find(targetInstanceID);
-	while (it != mProxies.end()) {
-		auto target = it->second;
-		if (target == sourceInstanceID) {
-			mLogStream << __FUNCTION__ << ": Cannot add proxy (" << sourceInstance.ToChar() << ", " << targetInstance.ToChar() 
-				<< ") since it would result into circle proxying!" << std::endl;
-			util::logWarning(mLogStream);
-			return false;
-		}
-		it = mProxies.find(target);
+	if (mProxies.wouldCreateCycle(sourceInstanceID, targetInstanceID)) {
+		mLogStream << __FUNCTION__ << ": Cannot add proxy (" << sourceInstance.ToChar() << ", " << targetInstance.ToChar() 
+			<< ") since it would result into circle proxying!" << std::endl;
+		util::logWarning(mLogStream);
+		return false;
 	}
 
 	mProxiesNames.insert({sourceInstance2, targetInstance2});
+	mProxiesDirty = true;
 	
 	if (sourceInstanceID != -1) {
 		mUnresolvedNamesToInstances.insert({ std::string(sourceInstance.ToChar()), sourceInstanceID });
-		mProxies.insert({ sourceInstanceID, targetInstanceID });
+
+		// Note: the source isn't proxied yet, so this is the source's own symbol.
+		auto* sourceSymbol = parser->GetSymbol(sourceInstanceID);
+		if (sourceSymbol) {
+			mProxiedNames.insert({ &sourceSymbol->name, sourceInstanceID });
+		}
+
+		mProxies.add(sourceInstanceID, targetInstanceID);
 	}
 
+	requestProxyTablesRebuild();
+	invalidateParserCaches();
+	invalidateScriptCaches();
+
 	return true;
 }
 
@@ -146,35 +159,61 @@ void ObjectManager::removeProxy(const zSTRING& sourceInstance)
 	if (it == mUnresolvedNamesToInstances.end()) return;
 	auto sourceInstanceID = it->second;
 
-	mProxies.erase(sourceInstanceID);
+	mProxies.remove(sourceInstanceID);
 	mProxiesNames.erase(name);
 	mUnresolvedNamesToInstances.erase(name);
+	mProxiedNames.erase(&sourceInstance);
+	mProxiesDirty = true;
+
+	requestProxyTablesRebuild();
+	invalidateParserCaches();
+	invalidateScriptCaches();
 }
 
-int ObjectManager::resolveProxying(int instanceID) const
+void ObjectManager::requestProxyTablesRebuild()
 {
-	int resolvedInstanceID = instanceID;
-	auto it = mProxies.find(instanceID);
-	while (it != mProxies.end()) {
-		auto target = it->second;
-		resolvedInstanceID = target;
-		it = mProxies.find(target);
-	}
+	// the proxies are resolved by walking the chains until the batch ends
+	if (mSymbolBatchDepth > 0) return;
 
-	return resolvedInstanceID;
+	mProxies.rebuild();
 }
 
-const char* ObjectManager::resolveProxying(const zSTRING& symbolName) const
+void ObjectManager::requestParserCachesInvalidation()
 {
-	const char* resolvedName = symbolName.ToChar();
-	auto it = mProxiesNames.find(resolvedName);
-	while (it != mProxiesNames.end()) {
-		const auto& target = it->second;
-		resolvedName = target.c_str();
-		it = mProxiesNames.find(target);
+	if (mSymbolBatchDepth > 0) {
+		mParserCachesPending = true;
+		return;
 	}
 
-	return resolvedName;
+	invalidateParserCaches();
+}
+
+const zSTRING& ObjectManager::getProxyTargetName(int sourceInstanceID, const zSTRING& fallback) const
+{
+	// Note: the symbol lookup resolves the proxy chain of the source
+	auto* symbol = zCParser::GetParser()->GetSymbol(sourceInstanceID);
+	if (!symbol) return fallback;
+	return symbol->name;
+}
+
+unsigned int ObjectManager::getParserGeneration() const
+{
+	return mParserGeneration;
+}
+
+void ObjectManager::invalidateParserCaches()
+{
+	mParserCachesPending = false;
+	++mParserGeneration;
+
+	// skip the generation reserved for invalid caches
+	if (mParserGeneration == 0) ++mParserGeneration;
+}
+
+void ObjectManager::invalidateScriptCaches()
+{
+	++mScriptGeneration;
+	if (mScriptGeneration == 0) ++mScriptGeneration;
 }
 
 
@@ -279,6 +318,82 @@ int ObjectManager::createNewInstanceId(oCItem* item, const std::string& instance
 	return instanceParserSymbolID;
 };
 
+int ObjectManager::createNewInstanceId(oCItem* item)
+{
+	const uint32_t number = allocateGeneratedName();
+	const int parserSymbolIndex = createNewInstanceId(item, getGeneratedName(number));
+
+	// the name is still unused
+	if (!parserSymbolIndex) {
+		mFreeGeneratedNames.push_back(number);
+	}
+
+	return parserSymbolIndex;
+}
+
+uint32_t ObjectManager::allocateGeneratedName()
+{
+	auto* parser = zCParser::GetParser();
+
+	while (true) {
+		uint32_t number;
+		if (!mFreeGeneratedNames.empty()) {
+			number = mFreeGeneratedNames.back();
+			mFreeGeneratedNames.pop_back();
+		}
+		else {
+			number = mNextGeneratedName++;
+		}
+
+		if (parser->GetIndex(zSTRING(getGeneratedName(number).c_str())) == -1) {
+			return number;
+		}
+	}
+}
+
+std::string ObjectManager::getGeneratedName(uint32_t number)
+{
+	return "DII_*" + std::to_string(number) + "*";
+}
+
+bool ObjectManager::parseGeneratedName(const std::string& name, uint32_t& number)
+{
+	static constexpr char PREFIX[] = "DII_*";
+	static constexpr size_t PREFIX_LENGTH = sizeof(PREFIX) - 1;
+
+	if (name.size() < PREFIX_LENGTH + 2 || name.compare(0, PREFIX_LENGTH, PREFIX) != 0 || name.back() != '*') {
+		return false;
+	}
+
+	unsigned long long value = 0;
+	for (size_t i = PREFIX_LENGTH; i != name.size() - 1; ++i) {
+		const char c = name[i];
+		if (c < '0' || c > '9') return false;
+		value = value * 10 + (c - '0');
+		if (value > UINT32_MAX) return false;
+	}
+
+	number = static_cast<uint32_t>(value);
+	return true;
+}
+
+int ObjectManager::createInstances(oCItem* const* items, int count, int* instanceIds)
+{
+	SymbolBatch batch(count);
+	int createdCount = 0;
+
+	for (int i = 0; i < count; ++i) {
+		const int parserSymbolIndex = items[i] ? createNewInstanceId(items[i]) : 0;
+		if (instanceIds) instanceIds[i] = parserSymbolIndex;
+		if (parserSymbolIndex) ++createdCount;
+	}
+
+	mLogStream << __FUNCTION__ << ": created " << createdCount << " of " << count << " instances" << std::endl;
+	util::debug(mLogStream);
+
+	return createdCount;
+}
+
 void ObjectManager::deleteDII(int parserSymbolIndex)
 {
 
@@ -296,41 +411,42 @@ void ObjectManager::deleteDII(int parserSymbolIndex)
 	//Check that the symbol cannot be found anymore
 	//auto* testSymbol = parser->GetSymbol(parserSymbolIndex);
 
-	std::string name = symbol->name.ToChar();
-
-	auto* dii = mNewInstanceMap[parserSymbolIndex].get();
-	dii->setDoNotStore(true);
+	auto* slot = getSlot(parserSymbolIndex);
+	slot->instance->setDoNotStore(true);
 
 	// remove the DII
-	auto deleteCount = mNewInstanceMap.erase(parserSymbolIndex);
-	mNewInstanceToSymbolMap.erase(parserSymbolIndex);
-	mNameToSymbolMap.erase(name);
-	mNameToInstanceMap.erase(name);
+	slot->instance.reset();
+	slot->symbol = nullptr;
+	slot->flags = 0;
+	--mInstanceCount;
+	auto deleteCount = mNameToInstanceMap.erase(&symbol->name);
 
 	// Note: We expect that exactly one entry was deleted.
 	if (deleteCount != 1) {
 		mLogStream << "ObjectManager::deleteDII: Assertion error: deleteCount is '" << deleteCount << "' but we expected 1" << endl;
 		util::logFatal(mLogStream);
 	}
+
+	collectStrings();
 }
 
 void ObjectManager::registerInstance(int instanceIdParserSymbolIndex, std::unique_ptr<DynInstance> item) {
 	// allow no reassignments
-	auto it = mNewInstanceMap.find(instanceIdParserSymbolIndex);
-	if (it != mNewInstanceMap.end())
+	if (isDynamicInstance(instanceIdParserSymbolIndex))
 	{
-		mLogStream << "Instance id already exists! Nothing will be created." << endl;
-		util::debug(mLogStream, Logger::Warning);
+		UTIL_DEBUGF(Logger::Warning, "Instance id already exists! Nothing will be created.\n");
 		return;
 	}
 
-	mNewInstanceMap.insert(std::make_pair<>(instanceIdParserSymbolIndex, std::move(item)));
-	
+	auto& slot = acquireSlot(instanceIdParserSymbolIndex);
+	slot.instance = std::move(item);
+	slot.flags |= DynInstanceSlot::HAS_INSTANCE;
+	++mInstanceCount;
 }
 
 void ObjectManager::releaseInstances() {
 	//release all allocated parser symbols and update parser symbol table
-	int allocatedSize = mNewInstanceMap.size();
+	int allocatedSize = mInstanceCount;
 	int* symTableSize = getParserInstanceCount();
 	*symTableSize = *symTableSize - allocatedSize;
 	mLogStream << __FUNCTION__ << ": allocatedSize = " << allocatedSize << endl;
@@ -339,22 +455,41 @@ void ObjectManager::releaseInstances() {
 	util::logAlways(mLogStream);
 
 	// clear all data structures
-	mNewInstanceMap.clear();
-	mNewInstanceToSymbolMap.clear();
+	mSlots.clear();
+	mInstanceCount = 0;
 	mNameToInstanceMap.clear();
-	mNameToSymbolMap.clear();
+
+	// No DynInstance or item image references interned strings anymore
+	DynInstance::releasePrototypeImages();
+	mItemImages.clear();
+	mInitImages.clear();
+	StringPool::getStringPool()->clear();
+
+	// all user data blocks are back in the arena
+	UserDataArena::getUserDataArena()->trim();
 
 	mProxiesNames.clear();
 	mProxies.clear();
 	mUnresolvedNamesToInstances.clear();
+	mProxiedNames.clear();
+	mProxiesDirty = false;
+
+	mNextGeneratedName = 0;
+	mFreeGeneratedNames.clear();
+
+	// the next save can't continue any journal
+	mBaseChecksum = 0;
+	mBaseSize = 0;
+	mJournalSize = 0;
+
+	invalidateParserCaches();
+	invalidateScriptCaches();
 };
 
 bool ObjectManager::assignInstanceId(oCItem* item, int instanceIdParserSymbolIndex){
-	auto it = mNewInstanceMap.find(instanceIdParserSymbolIndex);
-	if (it == mNewInstanceMap.end())
+	if (!isDynamicInstance(instanceIdParserSymbolIndex))
 	{
-		mLogStream<< __FUNCTION__ << ": instance id wasn't found: " << instanceIdParserSymbolIndex << std::endl;
-		util::debug(mLogStream, Logger::Warning);
+		UTIL_DEBUGF(Logger::Warning, "{}: instance id wasn't found: {}\n", __FUNCTION__, instanceIdParserSymbolIndex);
 		return false;
 	}
 	
@@ -362,8 +497,7 @@ bool ObjectManager::assignInstanceId(oCItem* item, int instanceIdParserSymbolInd
 
 	if(!initByNewInstanceId(item))
 	{
-		mLogStream << __FUNCTION__ << ": Item Initialisation failed!" << std::endl;
-		util::debug(mLogStream, Logger::Warning);
+		UTIL_DEBUGF(Logger::Warning, "{}: Item Initialisation failed!\n", __FUNCTION__);
 		return false;
 	};
 	return true;
@@ -376,145 +510,133 @@ void ObjectManager::oCItemOperatorDelete(oCItem* item)
 
 bool ObjectManager::assignInstanceId2(oCItem* item, int instanceIdParserSymbolIndex)
 {
-	//TODO: get rid of the copy item!!!
-	oCItem* copy = oCObjectFactory::GetFactory()->CreateItem(instanceIdParserSymbolIndex);
+	const int resolvedId = resolveProxying(instanceIdParserSymbolIndex);
 
-	if (!copy) return false;
-	
-	item->idx = copy->idx;
-	item->name = copy->name;
-	item->nameID = copy->nameID;
-	item->hp = copy->hp;
-	item->hp_max = copy->hp_max;
-	item->mainflags = copy->mainflags;
-	item->flags = copy->flags;
-	item->weight = copy->weight;
-	item->value = copy->value;
-
-	// -- weapons		
-	item->damageType = copy->damageType;
-	item->damageTotal = copy->damageTotal;
-
-	item->damage[0] = copy->damage[0];
-	item->damage[1] = copy->damage[1];
-	item->damage[2] = copy->damage[2];
-	item->damage[3] = copy->damage[3];
-	item->damage[4] = copy->damage[4];
-	item->damage[5] = copy->damage[5];
-	item->damage[6] = copy->damage[6];
-	item->damage[7] = copy->damage[7];
-
-	// -- armor 
-	item->wear = copy->wear;
-	item->protection[0] = copy->protection[0];
-	item->protection[1] = copy->protection[1];
-	item->protection[2] = copy->protection[2];
-	item->protection[3] = copy->protection[3];
-	item->protection[4] = copy->protection[4];
-	item->protection[5] = copy->protection[5];
-	item->protection[6] = copy->protection[6];
-	item->protection[7] = copy->protection[7];
-
-	// -- food
-	item->nutrition = copy->nutrition;
-
-	// -- use attributes
-	item->cond_atr[0] = copy->cond_atr[0];
-	item->cond_atr[1] = copy->cond_atr[1];
-	item->cond_atr[2] = copy->cond_atr[2];
-
-	item->cond_value[0] = copy->cond_value[0];
-	item->cond_value[1] = copy->cond_value[1];
-	item->cond_value[2] = copy->cond_value[2];
-
-	// -- attributes that will be changed on equip
-	item->change_atr[0] = copy->change_atr[0];
-	item->change_atr[1] = copy->change_atr[1];
-	item->change_atr[2] = copy->change_atr[2];
-
-	item->change_value[0] = copy->change_value[0];
-	item->change_value[1] = copy->change_value[1];
-	item->change_value[2] = copy->change_value[2];
-
-	// -- parser functions
-	item->magic = copy->magic;
-	item->on_equip = copy->on_equip;
-	item->on_unequip = copy->on_unequip;
-
-	item->on_state[0] = copy->on_state[0];
-	item->on_state[1] = copy->on_state[1];
-	item->on_state[2] = copy->on_state[2];
-	item->on_state[3] = copy->on_state[3];
-
-	// -- owner									
-	item->owner = copy->owner;			//	owner: npc instance
-	item->ownerGuild = copy->ownerGuild;		//	owner: guild
-	item->disguiseGuild = copy->disguiseGuild;
-
-	// -- visual
-	item->visual = copy->visual;
-
-	// -- change of mesh on equip
-	item->visual_change = copy->visual_change;	//	ASC file
-	item->effect = copy->effect;			//  Effect instance
-
-	item->visual_skin = copy->visual_skin;
-
-	item->scemeName = copy->scemeName;
-	item->material = copy->material;
-	item->munition = copy->munition;		//	Instance of ammunition
-
-	item->spell = copy->spell;
-	item->range = copy->range;
-
-	item->mag_circle = copy->mag_circle;
-
-	item->description = copy->description;
-	item->text[0] = copy->text[0];
-	item->text[1] = copy->text[1];
-	item->text[2] = copy->text[2];
-	item->text[3] = copy->text[3];
-	item->text[4] = copy->text[4];
-	item->text[5] = copy->text[5];
-
-	item->count[0] = copy->count[0];
-	item->count[1] = copy->count[1];
-	item->count[2] = copy->count[2];
-	item->count[3] = copy->count[3];
-	item->count[4] = copy->count[4];
-	item->count[5] = copy->count[5];
-
-	// -- inventory presentation
-	item->inv_zbias = copy->inv_zbias;								//  far plane (how far the item goes into the room by the z-axis)
-	item->inv_rotx = copy->inv_rotx;								//  rotation around x-axis (in degrees)
-	item->inv_roty = copy->inv_roty;								//  rotation around y-axis (in degrees)
-	item->inv_rotz = copy->inv_rotz;								//  rotation around z-axis (in degrees)
-	item->inv_animate = copy->inv_animate;							//  rotate the item
-																// Skip instanz field!!!
-																//item->instanz=instanz;						//int Symbolindex
-	item->c_manipulation = copy->c_manipulation;					//int ?
-	item->last_manipulation = copy->last_manipulation;				//zREAL ?
-	item->magic_value = copy->magic_value;					//int ?
-	
-	//item->effectVob = effectVob;						//oCVisualFX*
-	item->next = copy->next;
-	int address = reinterpret_cast<int>(item);
-	address += 0x330;
-	int* instance = reinterpret_cast<int*>(address);
+	if (isDynamicInstance(resolvedId)) {
+		getInstanceItem(resolvedId)->init(item, instanceIdParserSymbolIndex);
+	}
+	else if (isInitCacheable(instanceIdParserSymbolIndex)) {
+		const auto* cached = getItemImage(instanceIdParserSymbolIndex);
+		if (!cached) return false;
+
+		DynInstance::applyItemImage(cached->image, item);
+		item->next = cached->next;
+	}
+	else {
+		// The script of other instances might have side effects, so it runs for each assignment.
+		oCItem* copy = oCObjectFactory::GetFactory()->CreateItem(instanceIdParserSymbolIndex);
+		if (!copy) return false;
 
-	//Get current symbol index and set it as the item's instance id
-	*instance = instanceIdParserSymbolIndex;
+		DynInstance::ItemImage image;
+		DynInstance::captureItemImage(*copy, image);
+		DynInstance::applyItemImage(image, item);
+		item->next = copy->next;
 
-	//insert effect finally
-	//oCItemSaveRemoveEffect(item);
-	//oCItemSaveInsertEffect(item);
+		DII::DII_DeleteItem(copy);
+	}
 
-	//TODO: Verify!!!
-	DII::DII_DeleteItem(copy);
+	setInstanceId(item, instanceIdParserSymbolIndex);
 
 	return true;
 };
 
+const ObjectManager::CachedItemImage* ObjectManager::getItemImage(int instanceIdParserSymbolIndex)
+{
+	auto it = mItemImages.find(instanceIdParserSymbolIndex);
+	if (it != mItemImages.end() && it->second.scriptGeneration == mScriptGeneration) return &it->second;
+
+	// Note: The instance script might create items itself, so the map isn't touched before the item is created.
+	oCItem* item = oCObjectFactory::GetFactory()->CreateItem(instanceIdParserSymbolIndex);
+	if (!item) return nullptr;
+
+	auto& cached = mItemImages[instanceIdParserSymbolIndex];
+	DynInstance::captureItemImage(*item, cached.image);
+	cached.next = item->next;
+	cached.scriptGeneration = mScriptGeneration;
+
+	DII::DII_DeleteItem(item);
+
+	return &cached;
+}
+
+bool ObjectManager::getPrototypeFieldImage(int instanceIdParserSymbolIndex, DynInstance::FieldImage& image)
+{
+	const int resolvedId = resolveProxying(instanceIdParserSymbolIndex);
+
+	if (isDynamicInstance(resolvedId)) {
+		getInstanceItem(resolvedId)->getFieldImage(image);
+		return true;
+	}
+
+	const auto* cached = getItemImage(instanceIdParserSymbolIndex);
+	if (!cached) return false;
+
+	DynInstance::toFieldImage(cached->image, image);
+	return true;
+}
+
+bool ObjectManager::isInitCacheable(int instanceIdParserSymbolIndex)
+{
+	if (Configuration::getDIIInitCacheInstances().empty()) return false;
+
+	if (mInitImages.needsWhitelist(mScriptGeneration)) {
+		resolveInitCacheInstances();
+	}
+
+	return mInitImages.isWhitelisted(instanceIdParserSymbolIndex);
+}
+
+int ObjectManager::initByCachedScript(int instanceIdParserSymbolIndex, oCItem* item, const std::function<int()>& runScript)
+{
+	if (Configuration::getDIIInitCacheInstances().empty()) return runScript();
+
+	if (mInitImages.needsWhitelist(mScriptGeneration)) {
+		resolveInitCacheInstances();
+	}
+
+	return mInitImages.initialize(instanceIdParserSymbolIndex, mScriptGeneration, runScript,
+		[item](DynInstance::ItemImage& image) {
+			DynInstance::captureItemImage(*item, image);
+		},
+		[item](const DynInstance::ItemImage& image) {
+			DynInstance::applyItemImage(image, item);
+
+			// the script may set the amount, too
+			item->amount = image.fields.ints[DynInstance::FIELD_AMOUNT];
+		});
+}
+
+void ObjectManager::resolveInitCacheInstances()
+{
+	std::unordered_set<int> instanceIds;
+	zCParser* parser = zCParser::GetParser();
+	const int itemClass = util::getIndexDefaultZero("C_ITEM");
+
+	std::vector<std::string> names;
+	util::split(names, Configuration::getDIIInitCacheInstances(), ',');
+
+	for (auto& name : names) {
+		name.erase(0, name.find_first_not_of(" \t"));
+		name.erase(name.find_last_not_of(" \t") + 1);
+		if (name.empty()) continue;
+
+		std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+		const int instanceId = util::getIndexDefaultZero(name.c_str());
+
+		if (instanceId == 0 || isDynamicInstance(instanceId) || parser->GetBaseClass(instanceId) != itemClass) {
+			mLogStream << __FUNCTION__ << ": '" << name << "' isn't a static item instance; it won't be cached" << endl;
+			util::logWarning(mLogStream);
+			continue;
+		}
+
+		instanceIds.insert(instanceId);
+	}
+
+	mLogStream << __FUNCTION__ << ": cacheable instances: " << instanceIds.size() << endl;
+	mInitImages.setWhitelist(std::move(instanceIds), mScriptGeneration);
+	util::debug(mLogStream);
+}
+
 
 bool ObjectManager::initByNewInstanceId(oCItem* item) {
 	int instanceId = getDynInstanceId(item);
@@ -532,36 +654,73 @@ int ObjectManager::getDynInstanceId(oCItem* item){
 	if (item == NULL) return NULL;
 	int instanceIdParserSymbolIndex = getInstanceId(*item);
 
-	auto it = mNewInstanceMap.find(instanceIdParserSymbolIndex);
-	if (it == mNewInstanceMap.end()){return NULL;}
+	if (!isDynamicInstance(instanceIdParserSymbolIndex)){return NULL;}
 	return instanceIdParserSymbolIndex;
 }
 
 void ObjectManager::setDynInstanceId(oCItem* item, int instanceIdParserSymbolIndex){
 
-	auto it = mNewInstanceMap.find(instanceIdParserSymbolIndex);
-	if (it != mNewInstanceMap.end())
+	if (isDynamicInstance(instanceIdParserSymbolIndex))
 	{
 		setInstanceId(item, instanceIdParserSymbolIndex);
 	} else
 	{
-		mLogStream << __FUNCTION__ << ": parameter id has no assigned index. Nothing will be done." << endl;
-		util::debug(mLogStream, Logger::Warning);
+		UTIL_DEBUGF(Logger::Warning, "{}: parameter id has no assigned index. Nothing will be done.\n", __FUNCTION__);
 	}
 };
 
 DynInstance* ObjectManager::getInstanceItem(int instanceIdParserSymbolIndex){
 
-	auto it = mNewInstanceMap.find(instanceIdParserSymbolIndex);
-	if (it == mNewInstanceMap.end())
+	auto* slot = getSlot(instanceIdParserSymbolIndex);
+	if (!slot)
 	{
 		return NULL;		
 	}
-	return (*it).second.get();
+	return slot->instance.get();
 }; 
 
 
-void ObjectManager::saveNewInstances(char* directoryPath, char* filename) {
+/**
+ * Reads the CRC-32 at the end of a savegame file. Archives end with the checksum of their content
+ * and journals with the checksum of their last entry.
+ * \return false if the file couldn't be read.
+ */
+static bool readTrailingChecksum(const std::string& path, uint32_t& checksum)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.seekg(-static_cast<std::streamoff>(sizeof(checksum)), std::ios::end)) return false;
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(&checksum), sizeof(checksum)));
+}
+
+/**
+ * Copies a savegame file unless the destination has the same size and trailing checksum. A missing
+ * source removes the destination.
+ */
+static void syncSaveFile(const std::string& source, const std::string& destination)
+{
+	const auto size = util::getFileSize(source);
+	if (size == util::getFileSize(destination)) {
+		// both are missing or empty
+		if (size <= 0) return;
+
+		uint32_t sourceChecksum = 0;
+		uint32_t destinationChecksum = 0;
+		if (readTrailingChecksum(source, sourceChecksum) && readTrailingChecksum(destination, destinationChecksum)
+			&& sourceChecksum == destinationChecksum) {
+			return;
+		}
+	}
+
+	if (size == -1) {
+		DeleteFile(destination.c_str());
+	}
+	else if (!CopyFile(source.c_str(), destination.c_str(), FALSE)) {
+		throw std::runtime_error("Couldn't copy " + source + " to " + destination);
+	}
+}
+
+void ObjectManager::saveNewInstances(const std::string& directoryPath, const std::string& filename, const std::string& journalFilename,
+	const std::string& mirrorDirectoryPath) {
 	std::string dir (directoryPath);
 	if (!util::existsDir(dir)) {
 		if(!util::makePath(dir)) {
@@ -569,40 +728,85 @@ void ObjectManager::saveNewInstances(char* directoryPath, char* filename) {
 		}
 	}
 
-	string fullpath = dir + string(filename);
-	ofstream ofs(const_cast<char*>(fullpath.c_str()), std::ios::binary | std::ios::trunc);
+	const string fullpath = dir + filename;
+	const bool mirror = !mirrorDirectoryPath.empty() && mirrorDirectoryPath != dir;
 
-	try {
-		ofs.exceptions(std::ios::failbit | std::ios::badbit);
+	// The mirror directory holds the files of the last save; the savegame directory is synchronized with it first.
+	const std::string referenceDir = mirror ? mirrorDirectoryPath : dir;
 
-		std::vector<DynInstance*> instances;
-		for (auto& pair : mNewInstanceMap) {
-			auto* instance = pair.second.get();
-			
-			if (!instance->getDoNotStore())
-				instances.push_back(instance);
+	try {
+		if (mSaveFailed.exchange(false)) {
+			mBaseChecksum = 0;
 		}
 
-		// Save header for later compatibility checks
-		ARCHIVE_HEADER header;
-		util::writeValue(ofs, header);
+		// The journal can only be continued if the files written by the last save are still there.
+		// Missing journals have size 0.
+		const auto journalSize = util::getFileSize(referenceDir + journalFilename);
+		bool compact = mBaseChecksum == 0
+			|| util::getFileSize(referenceDir + filename) != mBaseSize
+			|| (journalSize == -1 ? 0 : journalSize) != mJournalSize;
+
+		// The content is serialized here; the files are written by the SaveWriter thread.
+		auto data = std::make_shared<ArchiveWriter>();
+
+		if (!compact) {
+			if (!writeJournalEntry(*data)) {
+				// nothing changed, but the savegame directory still needs the files
+				data.reset();
+			}
+			else if (mJournalSize + static_cast<long long>(data->getSize()) > static_cast<long long>(Configuration::getDIIJournalCompactionSize())) {
+				compact = true;
+				data = std::make_shared<ArchiveWriter>();
+			}
+			else {
+				mJournalSize += data->getSize();
+			}
+		}
 
-		// Save instance items
-		auto instanceSize = instances.size();
-		ofs.write((char*)&instanceSize, sizeof(instanceSize));
-		for (auto* instance : instances) {
-			instance->serialize(ofs);
+		if (compact) {
+			writeArchive(*data);
+			std::memcpy(&mBaseChecksum, data->getData() + data->getSize() - sizeof(mBaseChecksum), sizeof(mBaseChecksum));
+			mBaseSize = data->getSize();
+			mJournalSize = 0;
 		}
 
-		// Save proxies
-		auto* parser = zCParser::GetParser();
-		util::writeValue(ofs, mProxiesNames.size());
-		for (auto& pair : mProxiesNames) {
-			util::writeString(ofs, pair.first);
-			util::writeString(ofs, pair.second);
+		for (auto& slot : mSlots) {
+			if (slot.instance) slot.instance->setDirty(false);
 		}
+		mProxiesDirty = false;
+
+		std::vector<std::string> directories{ dir };
+		if (mirror) directories.push_back(mirrorDirectoryPath);
+
+		SaveWriter::getSaveWriter()->submit(directories, [=]() {
+			try {
+				for (const auto& target : directories) {
+					if (compact) {
+						util::writeFile(target + filename, data->getData(), data->getSize());
+						DeleteFile((target + journalFilename).c_str());
+						continue;
+					}
+
+					if (target != referenceDir) {
+						syncSaveFile(referenceDir + filename, target + filename);
+						syncSaveFile(referenceDir + journalFilename, target + journalFilename);
+					}
+
+					if (data) {
+						util::writeFile(target + journalFilename, data->getData(), data->getSize(), true);
+					}
+				}
+			}
+			catch (const std::exception& e) {
+				mSaveFailed = true;
+				throw std::runtime_error("Couldn't process " + fullpath + ": " + e.what());
+			}
+		});
 	}
 	catch (const std::exception & e) {
+		// the files on disk are in an unknown state now
+		mBaseChecksum = 0;
+
 		mLogStream << "exception msg: " << e.what() << std::endl;
 		util::logAlways(mLogStream);
 
@@ -611,72 +815,80 @@ void ObjectManager::saveNewInstances(char* directoryPath, char* filename) {
 	}
 }
 
+void ObjectManager::writeArchive(ArchiveWriter& archive)
+{
+	std::vector<const DiiRecord*> instances;
+	instances.reserve(mInstanceCount);
+	for (auto& slot : mSlots) {
+		auto* instance = slot.instance.get();
 
-void ObjectManager::loadNewInstances(char* filename) {
-	ifstream ifs(filename, std::ios::binary | std::ios::in);
-	if (ifs.fail()) {
-		return;
+		if (instance && !instance->getDoNotStore())
+			instances.push_back(instance);
 	}
 
-	try {
+	DiiArchive::writeArchive(archive, instances, mProxiesNames, mNextGeneratedName, mFreeGeneratedNames);
+}
 
-		ifs.exceptions(std::ios::failbit | std::ios::badbit);
+bool ObjectManager::writeJournalEntry(ArchiveWriter& entry)
+{
+	std::vector<const DiiRecord*> instances;
+	for (auto& slot : mSlots) {
+		auto* instance = slot.instance.get();
 
-		ARCHIVE_HEADER expectedHeader;
-		ARCHIVE_HEADER header;
-		util::readValue(ifs, header);
+		if (instance && instance->isDirty() && !instance->getDoNotStore())
+			instances.push_back(instance);
+	}
 
-		//check that the read header matches the expected one!
-		if (std::memcmp(&expectedHeader, &header, sizeof(ARCHIVE_HEADER)) != 0) {
-			throw std::runtime_error("Incompatible archive format");
-		}
+	if (instances.empty() && !mProxiesDirty) return false;
 
-		// archive and stream closed when destructors are called
-		size_t size = 0;
-		util::readValue(ifs, size);
+	DiiArchive::writeJournalEntry(entry, mBaseChecksum, instances, mProxiesDirty ? &mProxiesNames : nullptr,
+		mNextGeneratedName, mFreeGeneratedNames);
+	return true;
+}
 
-		for (size_t i = 0; i != size; ++i) {
-			auto instance = std::make_unique<DynInstance>();
+void ObjectManager::loadNewInstances(const std::string& filename, const std::string& journalPath) {
 
-			//ifs >> storeItem;
-			instance->deserialize(ifs);
-			//DynInstance* item = new DynInstance(*storeItem);
+	// The whole archive is read with a single read call and parsed from memory.
+	std::vector<char> content;
+	if (!util::readFile(filename, content)) {
+		return;
+	}
 
-			ParserInfo info;
-			info.newSymbolName = instance->getSymbolName().c_str();
-			info.oldSymbolName = instance->getPrototypeSymbolName().c_str();
-			info.bitfield = instance->getParserSymbolBitfield();
-			info.container = instance.get();
+	try {
 
-			auto id = createParserSymbol(info);
-			registerInstance(id, std::move(instance));
-		}
+		DiiArchive::LoadedArchive archive([] { return std::unique_ptr<DiiRecord>(new DynInstance()); },
+			static_cast<uint32_t>(DII_UserData::getIntAmount()), static_cast<uint32_t>(DII_UserData::getStringAmount()));
+		const uint32_t checksum = DiiArchive::loadArchive(content.data(), content.data() + content.size(), archive);
 
+		content.clear();
+		if (checksum != 0 && util::readFile(journalPath, content)) {
+			DiiArchive::applyJournal(content, checksum, archive);
 
-		auto* parser = zCParser::GetParser();
-		size_t proxiesSize = 0;
-		util::readValue(ifs, proxiesSize);
+			mLogStream << __FUNCTION__ << ": applied " << archive.journalEntryCount << " journal entries" << std::endl;
+			util::debug(mLogStream);
+		}
 
-		for (size_t i = 0; i != proxiesSize; ++i) {
+		for (auto& warning : archive.warnings) {
+			mLogStream << __FUNCTION__ << ": " << warning << std::endl;
+			util::logWarning(mLogStream);
+		}
 
-			std::string sourceInstanceName;
-			std::string targetInstanceName;
-			util::readAndTrim(ifs, sourceInstanceName);
-			util::readAndTrim(ifs, targetInstanceName);
+		loadNameAllocator(archive);
 
+		SymbolBatch batch(static_cast<int>(archive.instances.size() + archive.proxies.size()));
 
-			zSTRING source(sourceInstanceName.c_str());
-			zSTRING target(targetInstanceName.c_str());
+		for (auto& instance : archive.instances) {
+			// the factory of the archive creates DynInstances
+			instance->setDirty(false);
+			loadInstance(std::unique_ptr<DynInstance>(static_cast<DynInstance*>(instance.release())));
+		}
 
-			auto* symbol = createNewInstanceSymbol(parser->GetIndex(source), parser->GetSymbol(target), sourceInstanceName);
-			if (symbol) {
-				addSymbolToSymbolTable(symbol);
-			}
-			if (!addProxy(source, target)) {
-				mLogStream << __FUNCTION__ << ": Couldn't load proxy (" << sourceInstanceName << ", " << targetInstanceName << ")" << std::endl;
-				util::logFatal(mLogStream);
-			}
+		for (auto& proxy : archive.proxies) {
+			loadProxy(proxy.first, proxy.second);
 		}
+		mProxiesDirty = false;
+
+		logStringMemoryReport();
 	}
 	catch (const std::exception& e) {
 		mLogStream << "exception msg: " << e.what() << std::endl;
@@ -688,33 +900,165 @@ void ObjectManager::loadNewInstances(char* filename) {
 
 };
 
+void ObjectManager::loadInstance(std::unique_ptr<DynInstance> instance)
+{
+	ParserInfo info;
+	info.newSymbolName = instance->getSymbolName().c_str();
+	info.oldSymbolName = instance->getPrototypeSymbolName().c_str();
+	info.bitfield = instance->getParserSymbolBitfield();
+	info.container = instance.get();
+
+	auto id = createParserSymbol(info);
+	registerInstance(id, std::move(instance));
+}
+
+void ObjectManager::loadNameAllocator(const DiiArchive::LoadedArchive& archive)
+{
+	if (archive.hasNameAllocator) {
+		mNextGeneratedName = archive.nextGeneratedName;
+		mFreeGeneratedNames = archive.freeGeneratedNames;
+		return;
+	}
+
+	mNextGeneratedName = 0;
+	mFreeGeneratedNames.clear();
+
+	for (auto& instance : archive.instances) {
+		uint32_t number = 0;
+		if (parseGeneratedName(instance->getSymbolName(), number) && number >= mNextGeneratedName
+			&& number != UINT32_MAX) {
+			mNextGeneratedName = number + 1;
+		}
+	}
+}
+
+void ObjectManager::loadProxy(const std::string& sourceInstanceName, const std::string& targetInstanceName)
+{
+	auto* parser = zCParser::GetParser();
+	zSTRING source(sourceInstanceName.c_str());
+	zSTRING target(targetInstanceName.c_str());
+
+	auto* symbol = createNewInstanceSymbol(parser->GetIndex(source), parser->GetSymbol(target), sourceInstanceName);
+	if (symbol) {
+		addSymbolToSymbolTable(symbol);
+	}
+	if (!addProxy(source, target)) {
+		mLogStream << __FUNCTION__ << ": Couldn't load proxy (" << sourceInstanceName << ", " << targetInstanceName << ")" << std::endl;
+		util::logFatal(mLogStream);
+	}
+}
+
+void ObjectManager::logStringMemoryReport()
+{
+	if (!Configuration::debugEnabled()) return;
+
+	size_t unpooledBytes = 0;
+	size_t pooledBytes = 0;
+	size_t overrideCount = 0;
+	for (auto& slot : mSlots) {
+		if (!slot.instance) continue;
+		unpooledBytes += slot.instance->getUnpooledStringByteSize();
+		pooledBytes += slot.instance->getPooledStringByteSize();
+		overrideCount += slot.instance->getOverrideCount();
+	}
+
+	auto* pool = StringPool::getStringPool();
+	pooledBytes += pool->getByteSize();
+
+	mLogStream << __FUNCTION__ << ": DII text fields of " << mInstanceCount << " instances: "
+		<< unpooledBytes << " bytes as std::string, " << pooledBytes << " bytes pooled ("
+		<< pool->getSize() << " interned strings)" << endl;
+	util::debug(mLogStream);
+
+	mLogStream << __FUNCTION__ << ": DII fields: " << overrideCount << " overrides of "
+		<< DynInstance::getPrototypeImageCount() << " shared prototype images" << endl;
+	util::debug(mLogStream);
+
+	auto* arena = UserDataArena::getUserDataArena();
+	mLogStream << __FUNCTION__ << ": DII user data: " << arena->getAllocatedBlockCount() << " blocks in "
+		<< arena->getByteSize() << " bytes of arena chunks" << endl;
+	util::debug(mLogStream);
+}
+
+void ObjectManager::collectStrings()
+{
+	auto* pool = StringPool::getStringPool();
+	if (!pool->isCollectionDue()) return;
+
+	pool->beginCollection();
+
+	for (auto& slot : mSlots) {
+		if (slot.instance) slot.instance->markStrings(*pool);
+	}
+
+	DynInstance::markPrototypeImages(*pool);
+
+	for (auto& entry : mItemImages) {
+		DynInstance::markFieldImage(entry.second.image.fields, *pool);
+	}
+
+	mInitImages.forEachImage([pool](const DynInstance::ItemImage& image) {
+		DynInstance::markFieldImage(image.fields, *pool);
+	});
+
+	const auto released = pool->sweep();
+	UTIL_LOG(Logger::Info, mLogStream, __FUNCTION__ << ": released " << released << " unused strings; "
+		<< pool->getSize() << " strings are in use" << endl);
+}
+
 
 void ObjectManager::oCItemInitByScript(oCItem* item, int inst, int second)
 {
 	XCALL(0x00711BD0);
 }
 
-list<oCMobContainer*> ObjectManager::getMobContainers() {
-	list<oCMobContainer*> containerList;
-	zCWorld* world = oCGame::GetGame()->GetWorld();
-	zCListSort<zCVob>* vobList = world->GetVobList();
-	auto dummy = std::make_unique<oCMobContainer>();
+const std::unordered_set<oCMobContainer*>& ObjectManager::getMobContainers() {
+	if (mMobContainersValid) return mMobContainers;
 
-	while(vobList != NULL) {
-		zCVob* vob = vobList->GetData();
-		vobList = vobList->GetNext();
-		if (vob == NULL){
-			continue;
-		}
+	mMobContainers.clear();
+	zCWorld* world = oCGame::GetGame()->GetWorld();
 
-		if (strcmp(typeid(*vob).name(), typeid(*dummy).name()) == 0) {
-			containerList.push_back(dynamic_cast<oCMobContainer*>(vob));
+	for (zCVob* vob : zRange(world->GetVobList())) {
+		if (isMobContainer(vob)) {
+			mMobContainers.insert(reinterpret_cast<oCMobContainer*>(vob));
 		}
 	}
 
-	return containerList;
+	mMobContainersValid = true;
+
+	mLogStream << __FUNCTION__ << ": registered " << mMobContainers.size() << " containers" << std::endl;
+	util::debug(mLogStream);
+
+	return mMobContainers;
 };
 
+bool ObjectManager::isMobContainer(zCVob* vob)
+{
+	return vob && *reinterpret_cast<int*>(vob) == VOB_TYPE_VT_OCMOBCONTAINER;
+}
+
+void ObjectManager::onVobAdded(zCWorld* world, zCVob* vob)
+{
+	// vobs of other worlds (e.g. the inventory render world) don't matter
+	if (!mMobContainersValid || !isMobContainer(vob)) return;
+
+	auto* game = oCGame::GetGame();
+	if (game && game->GetWorld() == world) {
+		mMobContainers.insert(reinterpret_cast<oCMobContainer*>(vob));
+	}
+}
+
+void ObjectManager::onVobRemoved(zCWorld* world, zCVob* vob)
+{
+	if (!mMobContainersValid || !isMobContainer(vob)) return;
+	mMobContainers.erase(reinterpret_cast<oCMobContainer*>(vob));
+}
+
+void ObjectManager::onMobContainerDestroyed(oCMobContainer* container)
+{
+	mMobContainers.erase(container);
+}
+
 static void test (void* obj, void* param, oCItem* itm) {
 	if (itm == NULL) return;
 	ObjectManager* manager = (ObjectManager*)obj;
@@ -763,23 +1107,27 @@ bool ObjectManager::createNewInstanceWithoutExistingId(oCItem* item, int instanc
 			instanceBegin = parentId;
 		}*/
 	}
-	instanceItem->store(*item);
-	setPrototypeSymbolName(instanceParserSymbolID, old->name.ToChar());
+
+	// The fields are stored as overrides of the prototype's fields; the image of the prototype is only
+	// built for its first DII.
+	const std::string prototypeName = old->name.ToChar();
+	DynInstance::FieldImage prototypeImage;
+	if (DynInstance::hasPrototypeImage(prototypeName) || getPrototypeFieldImage(parentId, prototypeImage)) {
+		instanceItem->setPrototype(prototypeName, prototypeImage);
+		instanceItem->store(*item);
+	}
+	else {
+		instanceItem->store(*item);
+		setPrototypeSymbolName(instanceParserSymbolID, prototypeName);
+	}
 
 	instanceItem->setParserSymbolBitfield(symbol->bitfield);
 	instanceItem->setSymbolName(symbol->name.ToChar());
 
-	mNewInstanceToSymbolMap.insert(pair<int, zCPar_Symbol*>(instanceParserSymbolID, symbol));
+	registerSymbol(instanceParserSymbolID, symbol);
 
-	string symbolName = symbol->name.ToChar();
-	transform(symbolName.begin(), symbolName.end(), symbolName.begin(), ::toupper);
-	mNameToSymbolMap.insert(pair<string, zCPar_Symbol*>(symbolName, symbol));
-	mNameToInstanceMap.insert(pair<string, int>(symbolName, instanceParserSymbolID));
-
-	mLogStream << __FUNCTION__ << ": indexCount = " << *indexCount << endl;
-	util::debug(mLogStream);
-	mLogStream << __FUNCTION__ << ": parser symbol index = " << instanceParserSymbolID << endl;
-	util::debug(mLogStream);
+	UTIL_DEBUG(Logger::Info, mLogStream, __FUNCTION__ << ": indexCount = " << *indexCount << endl);
+	UTIL_DEBUG(Logger::Info, mLogStream, __FUNCTION__ << ": parser symbol index = " << instanceParserSymbolID << endl);
 
 	return true;
 }
@@ -817,14 +1165,13 @@ bool ObjectManager::addSymbolToSymbolTable(zCPar_Symbol* symbol)
 	int countBefore = *indexCount;
 	g2ext_extended::zCPar_SymbolTable* symbolTable = zCParserGetSymbolTable(parser);
 	symbolTable->Insert(symbol);
-	mLogStream << __FUNCTION__ << ": Name = " << symbol->name.ToChar() << endl;
-	mLogStream << __FUNCTION__ << ": Index = " << parser->GetIndex(symbol->name) << endl;
-	mLogStream << __FUNCTION__ << ": countBefore = " << countBefore << endl;
-	mLogStream << __FUNCTION__ << ": index count = " << *indexCount << endl;
-	util::debug(mLogStream);
+	requestParserCachesInvalidation();
+	UTIL_DEBUGF(Logger::Info, "{}: Name = {}\n{}: Index = {}\n{}: countBefore = {}\n{}: index count = {}\n",
+		__FUNCTION__, symbol->name.ToChar(), __FUNCTION__, parser->GetIndex(symbol->name),
+		__FUNCTION__, countBefore, __FUNCTION__, *indexCount);
 
 	// Some Ikarus functions need the correct length of the current symbol table.
-	updateIkarusSymbols();
+	requestIkarusSymbolsUpdate();
 
 	return countBefore != *indexCount;
 }
@@ -835,8 +1182,11 @@ DynInstance* ObjectManager::createNewInstanceItem(int instanceIdParserSymbolInde
 	DynInstance* result = getInstanceItem(instanceIdParserSymbolIndex);
 	if (!result)
 	{
-		result = new DynInstance();
-		mNewInstanceMap.insert(pair<int, DynInstance*>(instanceIdParserSymbolIndex, result));
+		auto& slot = acquireSlot(instanceIdParserSymbolIndex);
+		slot.instance = std::make_unique<DynInstance>();
+		slot.flags |= DynInstanceSlot::HAS_INSTANCE;
+		++mInstanceCount;
+		result = slot.instance.get();
 	}
 
 	return result;
@@ -892,7 +1242,7 @@ int ObjectManager::createParserSymbol(const ParserInfo& info)
 		if (index >= *symTableSize)
 		{
 			*symTableSize = index + 1;
-			updateIkarusSymbols();
+			requestIkarusSymbolsUpdate();
 			mLogStream << __FUNCTION__ << ": resized symbol table. symTableSize = " << *symTableSize << endl;
 			util::logInfo(mLogStream);
 		}
@@ -901,11 +1251,7 @@ int ObjectManager::createParserSymbol(const ParserInfo& info)
 	int newInstanceId = parser->GetIndex(symbol->name);
 
 	updateContainerItem(&info);
-	mNewInstanceToSymbolMap.insert(pair<int, zCPar_Symbol*>(newInstanceId, symbol));
-	string symbolName = symbol->name.ToChar();
-	transform(symbolName.begin(), symbolName.end(), symbolName.begin(), ::toupper);
-	mNameToSymbolMap.insert(pair<string, zCPar_Symbol*>(symbolName, symbol));
-	mNameToInstanceMap.insert(pair<string, int>(symbolName, newInstanceId));
+	registerSymbol(newInstanceId, symbol);
 
 	return newInstanceId;
 }
@@ -965,6 +1311,9 @@ void ObjectManager::setInstanceId(oCItem* item, int instanceParserSymbolID) {
 	int* instance = reinterpret_cast<int*>(address);
 	*instance = instanceParserSymbolID;
 
+	if (auto* manager = getObjectManager()) {
+		manager->onItemInstanceChanged(item);
+	}
 }
 
 /*
@@ -980,14 +1329,14 @@ int ObjectManager::getInstanceId(oCItem& item) {
 
 
 void ObjectManager::setPrototypeSymbolName(int instanceParserSymbolID, const std::string& protoInstanceSymbolName) {
-	auto instanceIT = mNewInstanceMap.find(instanceParserSymbolID);
-	if (instanceIT == mNewInstanceMap.end()) {
+	auto* instanceItem = getInstanceItem(instanceParserSymbolID);
+	if (!instanceItem) {
 		std::stringstream mLogStream;
 		mLogStream << __FUNCTION__ << ": instanceID not registered: " << instanceParserSymbolID << endl;
 		util::logFatal(mLogStream);
+		return;
 	}
 
-	auto& instanceItem = instanceIT->second;
 	instanceItem->setPrototypeSymbolName(protoInstanceSymbolName);
 }
 
@@ -997,10 +1346,9 @@ void ObjectManager::setPrototypeSymbolName(int instanceParserSymbolID, const std
 */
 const std::string& ObjectManager::getPrototypeSymbolName(int instanceParserSymbolID) {
 
-	auto it = mNewInstanceMap.find(instanceParserSymbolID);
+	auto* instanceItem = getInstanceItem(instanceParserSymbolID);
 	static std::string empty = "";
-	if (it == mNewInstanceMap.end()) return empty;
-	auto& instanceItem = it->second;
+	if (!instanceItem) return empty;
 	return instanceItem->getPrototypeSymbolName();
 }
 
@@ -1054,32 +1402,28 @@ bool ObjectManager::isAssignedToDII(oCItem* item)
 
 bool ObjectManager::isDynamicInstance(int instanceParserSymbolID)
 {
-	auto it = mNewInstanceMap.find(instanceParserSymbolID);
-	return it != mNewInstanceMap.end();
+	auto* slot = getSlot(instanceParserSymbolID);
+	return slot && (slot->flags & DynInstanceSlot::HAS_INSTANCE);
 }
 
 zCPar_Symbol* ObjectManager::getSymbolByIndex(int parserSymbolID)
 {
-	auto it = mNewInstanceToSymbolMap.find(parserSymbolID);
-	if (it == mNewInstanceToSymbolMap.end()) { return NULL; }
-	return it->second;
+	auto* slot = getSlot(parserSymbolID);
+	if (!slot) { return NULL; }
+	return slot->symbol;
 }
 
 zCPar_Symbol* ObjectManager::getSymbolByName(const zSTRING& symbolName)
 {
-	string name = symbolName.ToChar();
-	transform(name.begin(), name.end(),name.begin(), ::toupper);
-	auto it = mNameToSymbolMap.find(name);
-	if (it == mNameToSymbolMap.end()) { return NULL; }
-	return it->second;
+	auto it = mNameToInstanceMap.find(&symbolName);
+	if (it == mNameToInstanceMap.end()) { return NULL; }
+	return getSymbolByIndex(it->second);
 }
 
 
 int ObjectManager::getIndexByName(const zSTRING& symbolName)
 {
-	string name = symbolName.ToChar();
-	transform(name.begin(), name.end(),name.begin(), ::toupper);
-	auto it = mNameToInstanceMap.find(name);
+	auto it = mNameToInstanceMap.find(&symbolName);
 	if (it == mNameToInstanceMap.end()) { return -1; }
 	return it->second;
 }
@@ -1097,6 +1441,43 @@ void ObjectManager::updateIkarusSymbols()
 	zCParser::GetParser()->CallFunc(arg.Upper());
 }
 
+void ObjectManager::requestIkarusSymbolsUpdate()
+{
+	if (mSymbolBatchDepth > 0) {
+		mIkarusUpdatePending = true;
+		return;
+	}
+
+	updateIkarusSymbols();
+}
+
+ObjectManager::SymbolBatch::SymbolBatch(int symbolCount)
+{
+	auto* manager = getObjectManager();
+	++manager->mSymbolBatchDepth;
+	manager->reserveParserSymbols(symbolCount);
+}
+
+ObjectManager::SymbolBatch::~SymbolBatch()
+{
+	auto* manager = getObjectManager();
+	if (--manager->mSymbolBatchDepth > 0) return;
+
+	if (manager->mProxies.isPending()) {
+		manager->mProxies.rebuild();
+	}
+
+	if (manager->mParserCachesPending) {
+		manager->mParserCachesPending = false;
+		manager->invalidateParserCaches();
+	}
+
+	if (!manager->mIkarusUpdatePending) return;
+
+	manager->mIkarusUpdatePending = false;
+	manager->updateIkarusSymbols();
+}
+
 void ObjectManager::callForAllItems(bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param)
 {
 	callForAllContainerItems(func, obj, param);
@@ -1105,20 +1486,119 @@ void ObjectManager::callForAllItems(bool(*func)(void* obj, void* param, oCItem*)
 }
 
 
-void ObjectManager::callForAllNpcItems(bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param)
+void ObjectManager::callForItemsWithInstanceId(int instanceIdParserSymbolIndex, bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param)
 {
-	zCWorld* world = oCGame::GetGame()->GetWorld();
-	zCListSort<oCNpc>* npcList = world->GetNpcList();
+	if (!mItemIndexValid) rebuildItemIndex();
+
+	auto it = mItemsByInstance.find(instanceIdParserSymbolIndex);
+	if (it == mItemsByInstance.end()) return;
+
+	// 'func' might change the instance of the items and thus the index
+	const std::vector<oCItem*> items(it->second.begin(), it->second.end());
+	std::unordered_set<oCItem*> changedItems;
+
+	for (auto* item : items) {
+		if (func(obj, param, item)) changedItems.insert(item);
+	}
+
+	if (!changedItems.empty()) refreshNpcSlotItems(changedItems);
+}
+
+void ObjectManager::onItemInstanceChanged(oCItem* item)
+{
+	if (!mItemIndexValid || !item) return;
+
+	const int instanceId = getInstanceId(*item);
+	auto result = mItemInstances.insert({ item, instanceId });
+
+	if (!result.second) {
+		if (result.first->second == instanceId) return;
+
+		auto it = mItemsByInstance.find(result.first->second);
+		if (it != mItemsByInstance.end()) {
+			it->second.erase(item);
+			if (it->second.empty()) mItemsByInstance.erase(it);
+		}
+
+		result.first->second = instanceId;
+	}
+
+	mItemsByInstance[instanceId].insert(item);
+}
+
+void ObjectManager::onItemDestroyed(oCItem* item)
+{
+	if (!mItemIndexValid) return;
+
+	auto itemIt = mItemInstances.find(item);
+	if (itemIt == mItemInstances.end()) return;
+
+	auto it = mItemsByInstance.find(itemIt->second);
+	if (it != mItemsByInstance.end()) {
+		it->second.erase(item);
+		if (it->second.empty()) mItemsByInstance.erase(it);
+	}
 
+	mItemInstances.erase(itemIt);
+}
+
+void ObjectManager::invalidateItemIndex()
+{
+	mItemIndexValid = false;
+	mItemsByInstance.clear();
+	mItemInstances.clear();
+}
+
+void ObjectManager::onWorldChanged()
+{
+	invalidateItemIndex();
+
+	mMobContainersValid = false;
+	mMobContainers.clear();
+}
+
+void ObjectManager::rebuildItemIndex()
+{
+	invalidateItemIndex();
+
+	// Items created while scanning (e.g. by unpacking inventories) are indexed by the hooks.
+	mItemIndexValid = true;
+
+	callForAllItems([](void* obj, void* param, oCItem* item) -> bool {
+		static_cast<ObjectManager*>(obj)->onItemInstanceChanged(item);
+		return false;
+	}, this, nullptr);
+
+	mLogStream << __FUNCTION__ << ": indexed " << mItemInstances.size() << " items" << std::endl;
+	util::debug(mLogStream);
+}
+
+void ObjectManager::refreshNpcSlotItems(const std::unordered_set<oCItem*>& items)
+{
+	zCWorld* world = oCGame::GetGame()->GetWorld();
 	const auto slotCount = SlotInfo::getSlotCount();
 
-	while (npcList != NULL) {
-		oCNpc* npc = npcList->GetData();
+	for (oCNpc* npc : zRange(world->GetNpcList())) {
+		for (int i = 0; i < slotCount; ++i) {
+			auto& slotName = SlotInfo::getSlotName(i);
+			auto* vob = oCNpcGetSlotVob(npc, slotName);
 
-		if (npc == NULL) {
-			npcList = npcList->GetNext();
-			continue;
+			if (vob && vob->type == VOB_TYPE_ITEM && items.count((oCItem*)vob)) {
+				oCItem* itm = (oCItem*)vob;
+				oCItemSaveRemoveEffect(itm);
+				oCNpcPutInSlot(npc, slotName, itm, 1);
+				oCItemSaveInsertEffect(itm);
+			}
 		}
+	}
+}
+
+void ObjectManager::callForAllNpcItems(bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param)
+{
+	zCWorld* world = oCGame::GetGame()->GetWorld();
+	const auto slotCount = SlotInfo::getSlotCount();
+
+	for (oCNpc* npc : zRange(world->GetNpcList())) {
 
 		//if (std::string(npc->name->ToChar()) == "Ich") {
 		//	bool test = true;
@@ -1126,7 +1606,6 @@ void ObjectManager::callForAllNpcItems(bool(*func)(void* obj, void* param, oCIte
 
 		oCNpcInventory* inventory = npc->GetInventory();
 		if (inventory == NULL) {
-			npcList = npcList->GetNext();
 			continue;
 		}
 
@@ -1134,10 +1613,7 @@ void ObjectManager::callForAllNpcItems(bool(*func)(void* obj, void* param, oCIte
 		inventory->UnpackAllItems();
 		auto* inv = &inventory->inv;
 
-		std::list<oCItem*> items = util::create(inv->contents);
-		npcList = npcList->GetNext();
-
-		for (auto* item : items)
+		for (oCItem* item : zRange(inv->contents))
 		{
 			func(obj, param, item);
 		}
@@ -1169,16 +1645,16 @@ void ObjectManager::callForAllNpcItems(bool(*func)(void* obj, void* param, oCIte
 
 void ObjectManager::callForAllContainerItems(bool(*func)(void *obj, void *param, oCItem *), void * obj, void * param)
 {
-	auto containerList = getMobContainers();
+	// func might add or remove vobs
+	const auto& containers = getMobContainers();
+	const std::vector<oCMobContainer*> containerList(containers.begin(), containers.end());
 
 	for (auto* container : containerList)
 	{
 		int address = (int)container->containList_next;
-		zCListSort<oCItem>* listAddress = reinterpret_cast<zCListSort<oCItem>*>(address);
-		zCListSort<oCItem>* list = listAddress;
-		std::list<oCItem*> items = util::create(list);
-		
-		for (auto* item : items)
+		zCListSort<oCItem>* list = reinterpret_cast<zCListSort<oCItem>*>(address);
+
+		for (oCItem* item : zRange(list))
 		{
 			func(obj, param, item);
 		}
@@ -1188,10 +1664,8 @@ void ObjectManager::callForAllContainerItems(bool(*func)(void *obj, void *param,
 void ObjectManager::callForAllWorldItems(bool(*func)(void* obj, void* param, oCItem*), void* obj, void* param)
 {
 	zCWorld* world = oCGame::GetGame()->GetWorld();
-	zCListSort<oCItem>* itemList = world->GetItemList();
-	std::list<oCItem*> items = util::create(itemList);
 
-	for (auto* item : items)
+	for (oCItem* item : zRange(world->GetItemList()))
 	{
 		func(obj, param, item);
 	}
@@ -1203,53 +1677,44 @@ int* ObjectManager::getParserInstanceCount()
 	return (int*)(((BYTE*)parser) + 0x18 + 0x8);
 }
 
-bool ObjectManager::isItemInWorld(oCItem* item)
+int ObjectManager::getParserSymbolCapacity()
 {
-	zCWorld* world = oCGame::GetGame()->GetWorld();
-	auto* list = world->GetVobList();
-	return list->IsInList(item);
+	// the allocated size of the symbol array; it precedes the symbol count
+	zCParser* parser = zCParser::GetParser();
+	return *(int*)(((BYTE*)parser) + 0x18 + 0x4);
 }
 
-struct TEST2_PARAMS {
-	oCItem* result;
-	int instanceID;
-};
+void ObjectManager::reserveParserSymbols(int count)
+{
+	if (count <= 0) return;
 
-static bool test2(void* obj, void* param, oCItem* itm) {
-	if (itm == NULL) return false;
+	const int capacity = getParserSymbolCapacity();
+	const int required = *getParserInstanceCount() + count;
+	if (required <= capacity) return;
 
-	TEST2_PARAMS* params = (TEST2_PARAMS*)param;
-	if (params->result != NULL) return false;
+	const int grown = capacity + capacity / 2;
+	const int newCapacity = required > grown ? required : grown;
 
-	if (itm->GetInstance() == params->instanceID)
-	{
-		params->result = itm;
-		//logStream << "ObjectManager::getItemByInstanceId: result found" << endl;
-		//util::debug(&logStream);
-		return true;
-	}
+	zCParserGetSymbolTable(zCParser::GetParser())->SetSize(newCapacity);
 
-	return false;
+	mLogStream << __FUNCTION__ << ": symbol table capacity " << capacity << " -> " << newCapacity << endl;
+	util::debug(mLogStream);
 }
 
-oCItem* ObjectManager::getItemByInstanceId(int instanceIdParserSymbolIndex)
+bool ObjectManager::isItemInWorld(oCItem* item)
 {
-	/*auto func = [&](oCItem* itm) ->void {
-		if (itm == NULL) return;
-		if (result != NULL) return;
-		
-		if (itm->GetInstance() == instanceId)
-		{
-			result = itm;
-			logStream << "ObjectManager::getItemByInstanceId: result found" << endl;
-			util::debug(&logStream);
-		}
-	};*/
+	zCWorld* world = oCGame::GetGame()->GetWorld();
+	auto* list = world->GetVobList();
+	return list->IsInList(item);
+}
 
-	TEST2_PARAMS params = {NULL, instanceIdParserSymbolIndex };
+oCItem* ObjectManager::getItemByInstanceId(int instanceIdParserSymbolIndex)
+{
+	if (!mItemIndexValid) rebuildItemIndex();
 
-	callForAllItems(test2, NULL, &params);
-	return params.result;
+	auto it = mItemsByInstance.find(instanceIdParserSymbolIndex);
+	if (it == mItemsByInstance.end()) return nullptr;
+	return *it->second.begin();
 }
 
 void ObjectManager::oCItemSaveInsertEffect(oCItem* item)
@@ -1293,6 +1758,25 @@ int * ObjectManager::getRefCounter(oCItem * item)
 	return (int*)((BYTE*)item + 0x4);
 }
 
+ObjectManager::DynInstanceSlot* ObjectManager::getSlot(int parserSymbolIndex)
+{
+	return mSlots.get(parserSymbolIndex);
+}
+
+ObjectManager::DynInstanceSlot& ObjectManager::acquireSlot(int parserSymbolIndex)
+{
+	return mSlots.acquire(parserSymbolIndex);
+}
+
+void ObjectManager::registerSymbol(int parserSymbolIndex, zCPar_Symbol* symbol)
+{
+	auto& slot = acquireSlot(parserSymbolIndex);
+	slot.symbol = symbol;
+	slot.flags |= DynInstanceSlot::HAS_SYMBOL;
+
+	mNameToInstanceMap.insert({ &symbol->name, parserSymbolIndex });
+}
+
 int SlotInfo::getSlotCount()
 {
 	auto* symbol = UTIL_GET_SYMBOL_WITH_CHECKS(DII_SLOT_COUNT);
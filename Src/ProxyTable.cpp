@@ -0,0 +1,107 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <ProxyTable.h>
+
+int ProxyTable::resolveChain(int instanceID) const
+{
+	// Note: wouldCreateCycle is checked before adding a proxy, so all chains terminate.
+	auto it = mProxies.find(instanceID);
+	while (it != mProxies.end()) {
+		instanceID = it->second;
+		it = mProxies.find(instanceID);
+	}
+
+	return instanceID;
+}
+
+bool ProxyTable::wouldCreateCycle(int sourceInstanceID, int targetInstanceID) const
+{
+	if (sourceInstanceID == targetInstanceID) return true;
+
+	auto it = mProxies.find(targetInstanceID);
+	while (it != mProxies.end()) {
+		if (it->second == sourceInstanceID) return true;
+		it = mProxies.find(it->second);
+	}
+
+	return false;
+}
+
+void ProxyTable::add(int sourceInstanceID, int targetInstanceID)
+{
+	mProxies.insert({ sourceInstanceID, targetInstanceID });
+	mPending = true;
+}
+
+bool ProxyTable::remove(int sourceInstanceID)
+{
+	if (mProxies.erase(sourceInstanceID) == 0) return false;
+	mPending = true;
+	return true;
+}
+
+void ProxyTable::clear()
+{
+	mProxies.clear();
+	mResolved.clear();
+	mPending = false;
+}
+
+void ProxyTable::rebuild()
+{
+	mPending = false;
+	mResolved.clear();
+
+	if (mProxies.empty()) return;
+
+	const auto maxSourceID = mProxies.rbegin()->first;
+	mResolved.resize(maxSourceID + 1);
+	for (int i = 0; i <= maxSourceID; ++i) {
+		mResolved[i] = i;
+	}
+
+	for (const auto& pair : mProxies) {
+		mResolved[pair.first] = resolveChain(pair.second);
+	}
+}
+
+bool ProxyTable::isPending() const
+{
+	return mPending;
+}
+
+bool ProxyTable::empty() const
+{
+	return mProxies.empty();
+}
+
+size_t ProxyTable::size() const
+{
+	return mProxies.size();
+}
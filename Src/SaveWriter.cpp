@@ -0,0 +1,149 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <SaveWriter.h>
+#include <Util.h>
+
+std::unique_ptr<SaveWriter> SaveWriter::mInstance = std::make_unique<SaveWriter>();
+
+SaveWriter::SaveWriter() = default;
+
+SaveWriter::~SaveWriter()
+{
+	if (mThread.joinable()) {
+		std::unique_lock<std::mutex> lock(mMutex);
+		mStop = true;
+		mTaskAvailable.notify_one();
+
+		// If the process terminates, the writer thread is already gone. Otherwise we wait for the thread
+		// to finish its queue; joining isn't possible, as this might run while the loader lock is held.
+		if (WaitForSingleObject(mThread.native_handle(), 0) != WAIT_OBJECT_0) {
+			mTaskDone.wait(lock, [this] { return mStopped; });
+		}
+
+		lock.unlock();
+		mThread.detach();
+	}
+
+	// jobs left by a terminated writer thread
+	while (!mTasks.empty()) {
+		auto task = std::move(mTasks.front());
+		mTasks.pop_front();
+		execute(task);
+	}
+}
+
+SaveWriter* SaveWriter::getSaveWriter()
+{
+	return mInstance.get();
+}
+
+void SaveWriter::release()
+{
+	mInstance.reset();
+}
+
+void SaveWriter::submit(std::vector<std::string> directories, Job job)
+{
+	logErrors();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!mThread.joinable()) {
+		mThread = std::thread(&SaveWriter::run, this);
+	}
+
+	for (const auto& directory : directories) {
+		++mPending[directory];
+	}
+
+	mTasks.push_back({ std::move(directories), std::move(job) });
+	mTaskAvailable.notify_one();
+}
+
+void SaveWriter::wait(const std::string& directory)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mTaskDone.wait(lock, [&] {
+			auto it = mPending.find(directory);
+			return it == mPending.end() || it->second == 0;
+		});
+	}
+
+	logErrors();
+}
+
+void SaveWriter::run()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	while (true) {
+		mTaskAvailable.wait(lock, [this] { return mStop || !mTasks.empty(); });
+		if (mTasks.empty()) break;
+
+		auto task = std::move(mTasks.front());
+		mTasks.pop_front();
+
+		lock.unlock();
+		execute(task);
+		lock.lock();
+
+		for (const auto& directory : task.directories) {
+			--mPending[directory];
+		}
+		mTaskDone.notify_all();
+	}
+
+	mStopped = true;
+	mTaskDone.notify_all();
+}
+
+void SaveWriter::execute(Task& task)
+{
+	try {
+		task.job();
+	}
+	catch (const std::exception& e) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mErrors.push_back(e.what());
+	}
+}
+
+void SaveWriter::logErrors()
+{
+	std::vector<std::string> errors;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		errors.swap(mErrors);
+	}
+
+	for (const auto& error : errors) {
+		mLogStream << __FUNCTION__ << ": savegame job failed: " << error << std::endl;
+		util::logFatal(mLogStream);
+	}
+}
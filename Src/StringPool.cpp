@@ -0,0 +1,164 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <StringPool.h>
+#include <algorithm>
+
+constexpr size_t StringPool::MIN_COLLECTION_GROWTH;
+
+std::unique_ptr<StringPool> StringPool::mInstance = std::make_unique<StringPool>();
+
+StringPool::StringPool()
+{
+	clear();
+}
+
+StringPool* StringPool::getStringPool()
+{
+	return mInstance.get();
+}
+
+StringPool::Handle StringPool::intern(const std::string& str)
+{
+	auto it = mLookup.find(str);
+	if (it != mLookup.end()) return it->second;
+
+	Handle handle;
+	if (mFreeHandles.empty()) {
+		handle = static_cast<Handle>(mStrings.size());
+		mStrings.push_back(nullptr);
+	}
+	else {
+		handle = mFreeHandles.back();
+		mFreeHandles.pop_back();
+	}
+
+	it = mLookup.insert({ str, handle }).first;
+	mStrings[handle] = &it->first;
+	++mInternedSinceCollection;
+	return handle;
+}
+
+StringPool::Handle StringPool::intern(const char* str)
+{
+	if (!str || !*str) return EMPTY;
+	return intern(std::string(str));
+}
+
+const std::string& StringPool::resolve(Handle handle) const
+{
+	if (handle >= mStrings.size() || !mStrings[handle]) return *mStrings[EMPTY];
+	return *mStrings[handle];
+}
+
+const char* StringPool::c_str(Handle handle) const
+{
+	return resolve(handle).c_str();
+}
+
+void StringPool::clear()
+{
+	mStrings.clear();
+	mFreeHandles.clear();
+	mMarks.clear();
+	mLookup.clear();
+
+	// the empty string always gets handle EMPTY
+	intern(std::string());
+
+	mSizeAfterCollection = getSize();
+	mInternedSinceCollection = 0;
+}
+
+void StringPool::beginCollection()
+{
+	mMarks.assign(mStrings.size(), false);
+	mMarks[EMPTY] = true;
+}
+
+void StringPool::mark(Handle handle)
+{
+	if (handle < mMarks.size()) mMarks[handle] = true;
+}
+
+size_t StringPool::sweep()
+{
+	size_t released = 0;
+
+	// strings interned during the collection are kept
+	for (Handle handle = 0; handle < mMarks.size(); ++handle) {
+		if (mMarks[handle] || !mStrings[handle]) continue;
+
+		mLookup.erase(mLookup.find(*mStrings[handle]));
+		mStrings[handle] = nullptr;
+		mFreeHandles.push_back(handle);
+		++released;
+	}
+
+	mMarks.clear();
+	mMarks.shrink_to_fit();
+
+	mSizeAfterCollection = getSize();
+	mInternedSinceCollection = 0;
+	return released;
+}
+
+bool StringPool::isCollectionDue() const
+{
+	return mInternedSinceCollection >= std::max(mSizeAfterCollection, MIN_COLLECTION_GROWTH);
+}
+
+size_t StringPool::getSize() const
+{
+	return mStrings.size() - mFreeHandles.size();
+}
+
+size_t StringPool::getByteSize() const
+{
+	// map node: key, value and next/prev pointers; plus one bucket pointer and the handle table entry
+	constexpr size_t nodeOverhead = sizeof(Handle) + 2 * sizeof(void*);
+	constexpr size_t perString = nodeOverhead + sizeof(void*) + sizeof(const std::string*);
+
+	size_t result = sizeof(StringPool);
+	for (const auto* str : mStrings) {
+		if (str) result += perString + getUnpooledByteSize(*str);
+	}
+	result += mFreeHandles.capacity() * sizeof(Handle);
+
+	return result;
+}
+
+size_t StringPool::getUnpooledByteSize(const std::string& str)
+{
+	// strings fitting into the small string buffer don't need any heap memory
+	static const size_t smallStringCapacity = std::string().capacity();
+
+	size_t result = sizeof(std::string);
+	if (str.size() > smallStringCapacity) result += str.size() + 1;
+	return result;
+}
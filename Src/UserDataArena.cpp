@@ -0,0 +1,120 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include <UserDataArena.h>
+#include <cstring>
+
+std::unique_ptr<UserDataArena> UserDataArena::mInstance = std::make_unique<UserDataArena>();
+
+UserDataArena::UserDataArena() = default;
+
+UserDataArena* UserDataArena::getUserDataArena()
+{
+	return mInstance.get();
+}
+
+void UserDataArena::release()
+{
+	mInstance.reset();
+}
+
+void* UserDataArena::allocate(size_t size)
+{
+	const auto blockSize = getBlockSize(size);
+	auto& sizeClass = mSizeClasses[blockSize];
+	char* block = nullptr;
+
+	if (sizeClass.freeList) {
+		block = reinterpret_cast<char*>(sizeClass.freeList);
+		sizeClass.freeList = sizeClass.freeList->next;
+	}
+	else {
+		if (sizeClass.cursor == sizeClass.end) {
+			const auto blocksPerChunk = blockSize < CHUNK_BYTE_SIZE ? CHUNK_BYTE_SIZE / blockSize : 1;
+			sizeClass.chunks.emplace_back(new char[blocksPerChunk * blockSize]);
+			sizeClass.chunkByteSize = blocksPerChunk * blockSize;
+			sizeClass.cursor = sizeClass.chunks.back().get();
+			sizeClass.end = sizeClass.cursor + sizeClass.chunkByteSize;
+		}
+
+		block = sizeClass.cursor;
+		sizeClass.cursor += blockSize;
+	}
+
+	++sizeClass.allocatedBlocks;
+	std::memset(block, 0, blockSize);
+	return block;
+}
+
+void UserDataArena::deallocate(void* block, size_t size)
+{
+	if (!block) return;
+
+	auto& sizeClass = mSizeClasses[getBlockSize(size)];
+	auto* freeBlock = static_cast<FreeBlock*>(block);
+	freeBlock->next = sizeClass.freeList;
+	sizeClass.freeList = freeBlock;
+	--sizeClass.allocatedBlocks;
+}
+
+void UserDataArena::trim()
+{
+	for (auto it = mSizeClasses.begin(); it != mSizeClasses.end();) {
+		if (it->second.allocatedBlocks == 0) {
+			it = mSizeClasses.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+size_t UserDataArena::getAllocatedBlockCount() const
+{
+	size_t count = 0;
+	for (const auto& entry : mSizeClasses) {
+		count += entry.second.allocatedBlocks;
+	}
+	return count;
+}
+
+size_t UserDataArena::getByteSize() const
+{
+	size_t size = 0;
+	for (const auto& entry : mSizeClasses) {
+		size += entry.second.chunks.size() * entry.second.chunkByteSize;
+	}
+	return size;
+}
+
+size_t UserDataArena::getBlockSize(size_t size)
+{
+	constexpr size_t alignment = alignof(FreeBlock);
+	if (size < sizeof(FreeBlock)) size = sizeof(FreeBlock);
+	return (size + alignment - 1) & ~(alignment - 1);
+}
@@ -38,12 +38,14 @@ Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
 #include <direct.h>   // _mkdir
 #endif
 #include <sstream>
+#include <fstream>
 #include <Configuration.h>
 #include "api/g2/ztypes.h"
 #include <zCPar_SymbolTable.h>
 #include <ObjectManager.h>
 #include <api/g2/zcparser.h>
 #include <Util_Constants.h>
+#include <Archive.h>
 #include <random>
 
 
@@ -143,6 +145,16 @@ void util::debug(std::stringstream& ss, Logger::LogLevel level)
 }
 
 
+bool util::isLogLevelActive(Logger::LogLevel level)
+{
+	return Logger::getLogger()->isLogLevelActive(level);
+}
+
+bool util::isDebugLogActive(Logger::LogLevel level)
+{
+	return Configuration::debugEnabled() && isLogLevelActive(level);
+}
+
 void util::logAlways(std::stringstream& ss)
 {
 	Logger::getLogger()->logAlways(ss);
@@ -214,18 +226,7 @@ std::string util::trimFromRight(const std::string& str)
 
 void util::readString(std::istream& is, std::string& data)
 {
-	size_t size = 0;
-	readValue(is, size);
-	if (size)
-	{
-		data.resize(size);
-		is.read((char*)data.data(), size);
-	}
-	else
-	{
-		data = "";
-	}
-	data = trimFromRight(data);
+	StreamArchive::readString(is, data);
 }
 
 void util::readzSTRING(std::istream& is, zSTRING& data)
@@ -250,11 +251,7 @@ void util::readAndTrim(std::istream& is, zSTRING& data)
 
 void util::writeString(std::ostream& os, const std::string& data)
 {
-	// c-strings avoid Nullbytes to be written
-	char const* content = data.c_str();
-	size_t size = std::strlen(content);
-	writeValue(os, size);
-	os.write(content, size);
+	StreamArchive::writeString(os, data);
 }
 
 void util::writezSTRING(std::ostream& os, const zSTRING& data)
@@ -385,35 +382,6 @@ void util::split(std::vector<std::string> &tokens, const std::string &text, char
 
 
 
-void util::copyContentTo(std::string source, std::string dest, std::string pattern) {
-
-	std::string sourceFinal = source + pattern;
-	sourceFinal.append(1,'\0');
-	std::string destFinal = dest;// + std::string(1,'\0');
-	destFinal.append(1,'\0');
-
-	SHFILEOPSTRUCT s = { 0 };
-	s.wFunc = FO_COPY;
-	s.fFlags = FOF_NOCONFIRMATION | FOF_NOCONFIRMMKDIR | FOF_SILENT | FOF_NOERRORUI;
-	s.pTo = destFinal.c_str();//(LPWSTR)(destFinal.c_str());
-	s.pFrom = sourceFinal.c_str();//(LPWSTR)(sourceFinal.c_str());
-	int error = SHFileOperation(&s);
-
-	if (error)
-	{
-		mLogStream << __FUNCTION__ << ": Couldn't copy files from " << source << " to "
-			<< dest << std::endl;
-		logWarning(mLogStream);
-	}
-
-	if (s.fAnyOperationsAborted)
-	{
-		mLogStream << __FUNCTION__ << ": Any operation was aborted while copying " << source << " to "
-			<< dest << std::endl;
-		logWarning(mLogStream);
-	}
-}
-
 void util::deleteAllFiles(std::string folder, std::string pattern)
 {
 	std::string sourceFinal = folder + pattern;
@@ -440,50 +408,35 @@ void util::deleteAllFiles(std::string folder, std::string pattern)
 	}
 };
 
-void util::copyFileTo(std::string from, std::string to){
-
-	//do not copy if source and destination are equal
-	if (from.compare(to) == 0)
-	{
-		mLogStream << __FUNCTION__ << ": No copying is done, as source and destination are equal:" << std::endl;
-		mLogStream << "\tsource: " << from << std::endl;
-		mLogStream << "\tdestination: " << to << std::endl;
-		logWarning(mLogStream);
-		return;
+bool util::readFile(const std::string& path, std::vector<char>& content)
+{
+	std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+	if (ifs.fail()) {
+		return false;
 	}
 
-	BOOL success = CopyFile( from.c_str(), to.c_str(), FALSE );
+	const auto size = static_cast<size_t>(ifs.tellg());
+	content.resize(size);
+	ifs.seekg(0, std::ios::beg);
+	ifs.read(content.data(), size);
+
+	return !ifs.fail();
+}
+
+void util::writeFile(const std::string& path, const char* data, size_t size, bool append)
+{
+	std::ofstream ofs(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+	ofs.exceptions(std::ios::failbit | std::ios::badbit);
+	ofs.write(data, size);
+}
 
-	if (!success)
+long long util::getFileSize(const std::string& path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &data))
 	{
-		DWORD errorCode = GetLastError();
-
-		LPTSTR errorText = NULL;
-
-		FormatMessage(
-			// use system message tables to retrieve error text
-			FORMAT_MESSAGE_FROM_SYSTEM
-			// allocate buffer on local heap for error text
-			| FORMAT_MESSAGE_ALLOCATE_BUFFER
-			// Important! will fail otherwise, since we're not 
-			// (and CANNOT) pass insertion parameters
-			| FORMAT_MESSAGE_IGNORE_INSERTS,
-			NULL,    // unused with FORMAT_MESSAGE_FROM_SYSTEM
-			errorCode,
-			MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-			(LPTSTR)&errorText,  // output 
-			0, // minimum size for output buffer
-			NULL);   // arguments - see note 
-
-		if (NULL != errorText)
-		{
-			mLogStream << __FUNCTION__ << ": While copying from " << from << " to " << to <<
-				" an error occured: " << errorText << std::endl;
-			logWarning(mLogStream);
-
-			// release memory allocated by FormatMessage()
-			LocalFree(errorText);
-			errorText = NULL;
-		}
+		return -1;
 	}
-};
\ No newline at end of file
+
+	return (static_cast<long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+}
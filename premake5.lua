@@ -13,7 +13,7 @@ project "neclib"
 	targetdir "build/bin/%{cfg.buildcfg}"
 	
 	files { "**.h", "**.hpp", "**.c", "**.cpp", "**.def"}
-	excludes { "Levitation/**", "boost-1.67.0/**" }
+	excludes { "Levitation/**", "boost-1.67.0/**", "tools/**", "tests/**" }
 	
 	filter "configurations:Debug"
 		defines {"DEBUG", "WIN32", "_DEBUG", "_WINDOWS", "_USRDLL", "DYNITEMINST_EXPORTS"}
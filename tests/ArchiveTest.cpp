@@ -0,0 +1,697 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <Archive.h>
+#include <DiiArchive.h>
+#include <DiiRecord.h>
+#include <istream>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+
+TEST_CASE(archiveChecksumMatchesCrc32)
+{
+	const char* check = "123456789";
+	CHECK_EQUAL(0xCBF43926u, archiveChecksum(check, std::strlen(check)));
+	CHECK_EQUAL(0u, archiveChecksum(check, 0));
+
+	// the table driven checksum processes eight bytes at once; compare it with the bitwise definition
+	// for all lengths and alignments of the tail
+	unsigned char data[67];
+	for (size_t i = 0; i < sizeof(data); ++i) data[i] = static_cast<unsigned char>(i * 37 + 11);
+
+	for (size_t offset = 0; offset < 4; ++offset) {
+		for (size_t size = 0; size + offset <= sizeof(data); ++size) {
+			uint32_t crc = 0xFFFFFFFFu;
+			for (size_t i = 0; i < size; ++i) {
+				crc ^= data[offset + i];
+				for (int k = 0; k < 8; ++k) crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+			}
+			CHECK_EQUAL(crc ^ 0xFFFFFFFFu, archiveChecksum(data + offset, size));
+		}
+	}
+}
+
+TEST_CASE(archiveWriterGrowsBeyondTheReservedSize)
+{
+	ArchiveWriter writer;
+	writer.reserve(6);
+	CHECK_EQUAL(size_t(0), writer.getSize());
+
+	for (int i = 0; i < 1000; ++i) writer.write(i);
+	CHECK_EQUAL(1000 * sizeof(int), writer.getSize());
+
+	ArchiveReader reader(writer.getData(), writer.getData() + writer.getSize());
+	for (int i = 0; i < 1000; ++i) {
+		int value = -1;
+		reader.read(value);
+		CHECK_EQUAL(i, value);
+	}
+}
+
+TEST_CASE(archiveWriterReaderRoundTrip)
+{
+	ArchiveWriter writer;
+	writer.write(static_cast<uint32_t>(0xDEADBEEF));
+	writer.write(-42);
+	writer.write(2.5f);
+	writer.writeString("ITMW_1H_SWORD");
+	writer.writeString("");
+
+	ArchiveWriter tail;
+	tail.write(static_cast<uint16_t>(7));
+	writer.append(tail);
+
+	ArchiveReader reader(writer.getData(), writer.getData() + writer.getSize());
+	uint32_t u = 0;
+	int i = 0;
+	float f = 0;
+	std::string a;
+	std::string b = "not empty";
+	uint16_t s = 0;
+
+	reader.read(u);
+	reader.read(i);
+	reader.read(f);
+	reader.readString(a);
+	reader.readString(b);
+	reader.read(s);
+
+	CHECK_EQUAL(0xDEADBEEFu, u);
+	CHECK_EQUAL(-42, i);
+	CHECK_EQUAL(2.5f, f);
+	CHECK_EQUAL(std::string("ITMW_1H_SWORD"), a);
+	CHECK(b.empty());
+	CHECK_EQUAL(7, s);
+	CHECK_EQUAL(size_t(0), reader.getRemaining());
+}
+
+TEST_CASE(archiveReaderRejectsReadsBeyondTheEnd)
+{
+	ArchiveWriter writer;
+	writer.write(static_cast<uint32_t>(100));
+	writer.write("abc", 3);
+
+	ArchiveReader reader(writer.getData(), writer.getData() + writer.getSize());
+	std::string str;
+
+	// the string claims 100 characters, but only 3 are left
+	CHECK_THROWS(reader.readString(str));
+
+	ArchiveReader reader2(writer.getData(), writer.getData() + writer.getSize());
+	reader2.skip(4);
+	CHECK_EQUAL(size_t(3), reader2.getRemaining());
+	CHECK_THROWS(reader2.require(4));
+	CHECK_THROWS(reader2.skip(4));
+
+	uint64_t value = 0;
+	CHECK_THROWS(reader2.read(value));
+}
+
+TEST_CASE(archiveReaderCountChecksDontOverflow)
+{
+	ArchiveWriter writer;
+	writer.write(static_cast<uint64_t>(1));
+	ArchiveReader reader(writer.getData(), writer.getData() + writer.getSize());
+
+	// count * sizeof(uint64_t) wraps around to 8
+	const size_t count = SIZE_MAX / sizeof(uint64_t) + 2;
+	CHECK_EQUAL(size_t(8), count * sizeof(uint64_t));
+	CHECK_THROWS(reader.requireCount<uint64_t>(count));
+
+	reader.requireCount<uint64_t>(1);
+	CHECK_THROWS(reader.requireCount<uint64_t>(2));
+	CHECK_THROWS(reader.requireCount<char>(9));
+
+	// a string table can't claim more strings than there are bytes for their lengths
+	std::vector<StringPool::Handle> handles;
+	CHECK_THROWS(ArchiveStringTable::read(reader, 0xFFFFFFFF, handles));
+}
+
+TEST_CASE(archiveStringTableRoundTrip)
+{
+	auto* pool = StringPool::getStringPool();
+	const auto sword = pool->intern("ITMW_SWORD");
+
+	ArchiveStringTable table;
+	CHECK_EQUAL(0u, table.add(sword));
+	CHECK_EQUAL(1u, table.add(std::string("ITMW_AXE")));
+	CHECK_EQUAL(0u, table.add(std::string("ITMW_SWORD")));
+	CHECK_EQUAL(1u, table.add(pool->intern("ITMW_AXE")));
+
+	// unique strings aren't looked up, but are still found by their handle
+	const std::string symbolName("DII_1");
+	CHECK_EQUAL(2u, table.addUnique(symbolName));
+	CHECK_EQUAL(size_t(3), table.getSize());
+
+	ArchiveWriter writer;
+	table.write(writer);
+	CHECK_EQUAL(table.getByteSize(), writer.getSize());
+
+	std::vector<StringPool::Handle> handles;
+	ArchiveReader reader(writer.getData(), writer.getData() + writer.getSize());
+	ArchiveStringTable::read(reader, static_cast<uint32_t>(table.getSize()), handles);
+
+	CHECK_EQUAL(size_t(3), handles.size());
+	CHECK_EQUAL(sword, handles[0]);
+	CHECK_EQUAL(std::string("ITMW_AXE"), pool->resolve(handles[1]));
+	CHECK_EQUAL(symbolName, pool->resolve(handles[2]));
+}
+
+TEST_CASE(archiveChecksumDetectsCorruption)
+{
+	ArchiveWriter writer;
+	for (uint32_t i = 0; i < 1000; ++i) {
+		writer.write(i);
+	}
+	writer.write(archiveChecksum(writer.getData(), writer.getSize()));
+
+	std::vector<char> content(writer.getData(), writer.getData() + writer.getSize());
+	const auto bodySize = content.size() - sizeof(uint32_t);
+
+	uint32_t stored = 0;
+	std::memcpy(&stored, content.data() + bodySize, sizeof(stored));
+	CHECK_EQUAL(stored, archiveChecksum(content.data(), bodySize));
+
+	content[1234] ^= 0x10;
+	CHECK(stored != archiveChecksum(content.data(), bodySize));
+}
+
+TEST_CASE(memoryStreamBufferReadsTheBlock)
+{
+	const char data[] = { 'a', 'b', '\n', 'c' };
+	MemoryStreamBuffer buffer(data, data + sizeof(data));
+	std::istream is(&buffer);
+
+	char read[4] = {};
+	is.read(read, sizeof(read));
+	CHECK(is.good());
+	CHECK(std::memcmp(read, data, sizeof(data)) == 0);
+
+	is.get();
+	CHECK(is.eof());
+}
+
+
+namespace {
+
+	const int INSTANCE_COUNT = 50000;
+	const int PROTOTYPE_COUNT = 40;
+	const int USER_DATA_INTS = 4;
+	const int USER_DATA_STRINGS = 2;
+
+	/**
+	 * User data with std::strings in place of the engine strings of DII_UserData. It holds a fixed number of
+	 * values like DII_UserData: stored values exceeding them are skipped, missing values stay zero / empty.
+	 */
+	class TestUserData : public IUserDataRecord {
+	public:
+
+		TestUserData() : ints(USER_DATA_INTS), strings(USER_DATA_STRINGS) {}
+
+		virtual void serialize(std::ostream& os) const override
+		{
+			StreamArchive::writeValue(os, static_cast<int>(ints.size()));
+			StreamArchive::writeValue(os, static_cast<int>(strings.size()));
+			for (auto value : ints) StreamArchive::writeValue(os, value);
+			for (const auto& str : strings) StreamArchive::writeString(os, str);
+		}
+
+		virtual void deserialize(std::istream& is) override
+		{
+			int intAmount = 0;
+			int strAmount = 0;
+			StreamArchive::readValue(is, intAmount);
+			StreamArchive::readValue(is, strAmount);
+
+			for (int i = 0; i < intAmount; ++i) {
+				int value = 0;
+				StreamArchive::readValue(is, value);
+				if (i < getIntCount()) ints[i] = value;
+			}
+
+			for (int i = 0; i < strAmount; ++i) {
+				std::string str;
+				StreamArchive::readString(is, str);
+				if (i < getStringCount()) strings[i] = str;
+			}
+		}
+
+		virtual void writeRecord(ArchiveWriter& writer, ArchiveStringTable& table, int intAmount, int strAmount) const override
+		{
+			for (int i = 0; i < intAmount; ++i) writer.write(i < getIntCount() ? ints[i] : 0);
+			for (int i = 0; i < strAmount; ++i) writer.write(table.add(i < getStringCount() ? strings[i] : std::string()));
+		}
+
+		virtual void readRecord(ArchiveReader& reader, const std::vector<StringPool::Handle>& table, int intAmount, int strAmount) override
+		{
+			for (int i = 0; i < intAmount; ++i) {
+				int value = 0;
+				reader.read(value);
+				if (i < getIntCount()) ints[i] = value;
+			}
+
+			for (int i = 0; i < strAmount; ++i) {
+				uint32_t index = 0;
+				reader.read(index);
+				if (index >= table.size()) throw std::runtime_error("Invalid string table index in archive record");
+				if (i < getStringCount()) strings[i] = StringPool::getStringPool()->resolve(table[index]);
+			}
+		}
+
+		virtual int getIntCount() const override { return static_cast<int>(ints.size()); }
+		virtual int getStringCount() const override { return static_cast<int>(strings.size()); }
+
+		std::vector<int> ints;
+		std::vector<std::string> strings;
+	};
+
+	/**
+	 * A dynamic instance without the engine: the production DiiRecord with TestUserData.
+	 */
+	class TestInstance : public DiiRecord {
+	public:
+
+		virtual IUserDataRecord& getUserDataRecord() override { return userData; }
+		virtual const IUserDataRecord& getUserDataRecord() const override { return userData; }
+
+		TestUserData userData;
+	};
+
+	DiiArchive::LoadedArchive createLoadedArchive()
+	{
+		return DiiArchive::LoadedArchive([] { return std::unique_ptr<DiiRecord>(new TestInstance()); },
+			USER_DATA_INTS, USER_DATA_STRINGS);
+	}
+
+	DiiRecord::FieldImage createPrototypeImage(int prototype)
+	{
+		auto* pool = StringPool::getStringPool();
+		DiiRecord::FieldImage image = {};
+		image.ints[DiiRecord::FIELD_VALUE] = 10 * prototype;
+		image.ints[DiiRecord::FIELD_DAMAGE_TOTAL] = 20 + prototype;
+		image.strings[DiiRecord::FIELD_NAME] = pool->intern("Sword " + std::to_string(prototype));
+		image.strings[DiiRecord::FIELD_VISUAL] = pool->intern("ItMw_Sword_" + std::to_string(prototype) + ".3DS");
+		image.strings[DiiRecord::FIELD_ON_EQUIP] = pool->intern("EQUIP_SWORD");
+		return image;
+	}
+
+	/**
+	 * Creates the i-th instance as the ObjectManager does: its prototype is assigned before its fields are set,
+	 * so only the value, the damage and the description are stored as overrides.
+	 */
+	std::unique_ptr<TestInstance> createInstance(int i)
+	{
+		auto* pool = StringPool::getStringPool();
+		const int prototype = i % PROTOTYPE_COUNT;
+		auto instance = std::unique_ptr<TestInstance>(new TestInstance());
+		instance->setSymbolName("DII_" + std::to_string(i));
+		instance->zCPar_Symbol_Bitfield = 0x1000 + i % 7;
+
+		auto image = createPrototypeImage(prototype);
+		instance->setPrototype("ITMW_PROTOTYPE_" + std::to_string(prototype), image);
+		image.ints[DiiRecord::FIELD_VALUE] = 100 + i % 50;
+		image.ints[DiiRecord::FIELD_DAMAGE] = i % 3;
+		image.strings[DiiRecord::FIELD_DESCRIPTION] = pool->intern("Upgraded weapon level " + std::to_string(i % 10));
+		instance->setFieldImage(image);
+
+		for (int k = 0; k < USER_DATA_INTS; ++k) instance->userData.ints[k] = i * k;
+		instance->userData.strings[0] = "OWNER_" + std::to_string(i % 100);
+		return instance;
+	}
+
+	std::vector<std::unique_ptr<TestInstance>> createInstances(int count)
+	{
+		DiiRecord::releasePrototypeImages();
+		std::vector<std::unique_ptr<TestInstance>> instances;
+		instances.reserve(count);
+		for (int i = 0; i < count; ++i) instances.push_back(createInstance(i));
+		return instances;
+	}
+
+	std::vector<const DiiRecord*> toRecords(const std::vector<std::unique_ptr<TestInstance>>& instances)
+	{
+		std::vector<const DiiRecord*> records;
+		for (auto& instance : instances) records.push_back(instance.get());
+		return records;
+	}
+
+	bool equals(TestInstance& a, TestInstance& b)
+	{
+		DiiRecord::FieldImage imageA;
+		DiiRecord::FieldImage imageB;
+		a.getFieldImage(imageA);
+		b.getFieldImage(imageB);
+
+		return a.getSymbolName() == b.getSymbolName() && a.getPrototypeSymbolName() == b.getPrototypeSymbolName()
+			&& a.getParserSymbolBitfield() == b.getParserSymbolBitfield()
+			&& std::memcmp(&imageA, &imageB, sizeof(imageA)) == 0
+			&& a.userData.ints == b.userData.ints && a.userData.strings == b.userData.strings;
+	}
+
+	void checkInstances(std::vector<std::unique_ptr<TestInstance>>& expected, DiiArchive::LoadedArchive& archive)
+	{
+		CHECK_EQUAL(expected.size(), archive.instances.size());
+		for (size_t i = 0; i < expected.size(); ++i) {
+			if (!equals(*expected[i], static_cast<TestInstance&>(*archive.instances[i]))) {
+				test::fail(__FILE__, __LINE__, "instance " + std::to_string(i) + " differs after the round trip");
+			}
+		}
+	}
+
+	bool hasWarning(const DiiArchive::LoadedArchive& archive, const std::string& part)
+	{
+		for (auto& warning : archive.warnings) {
+			if (warning.find(part) != std::string::npos) return true;
+		}
+		return false;
+	}
+
+	uint32_t loadArchive(const ArchiveWriter& writer, DiiArchive::LoadedArchive& archive)
+	{
+		return DiiArchive::loadArchive(writer.getData(), writer.getData() + writer.getSize(), archive);
+	}
+
+	/**
+	 * Writes a version 1.1 archive like the versions before the block structured format did: the header,
+	 * the instance count, the serialized instances, the proxy count and the proxy names.
+	 */
+	std::string writeArchive_1_1(const std::vector<std::unique_ptr<TestInstance>>& instances, const DiiArchive::ProxyList& proxies)
+	{
+		std::ostringstream os;
+		DiiArchive::ARCHIVE_HEADER header;
+		header.version = DiiArchive::ARCHIVE_HEADER::VERSION_1_1;
+		StreamArchive::writeValue(os, header);
+
+		StreamArchive::writeValue(os, static_cast<uint32_t>(instances.size()));
+		for (auto& instance : instances) instance->serialize(os);
+
+		StreamArchive::writeValue(os, static_cast<uint32_t>(proxies.size()));
+		for (auto& proxy : proxies) {
+			StreamArchive::writeString(os, proxy.first);
+			StreamArchive::writeString(os, proxy.second);
+		}
+		return os.str();
+	}
+}
+
+TEST_CASE(deltaRecordRoundTrip)
+{
+	auto instances = createInstances(3);
+	auto& instance = *instances[1];
+	CHECK_EQUAL(size_t(3), instance.getOverrideCount());
+
+	ArchiveStringTable strings;
+	ArchiveWriter images;
+	ArchiveWriter records;
+	DiiRecord::writeFieldImage(images, strings, *instance.getPrototypeImage());
+	instance.writeDeltaRecord(records, strings, 0);
+	CHECK_EQUAL(instance.getDeltaRecordSize(), records.getSize());
+
+	ArchiveWriter table;
+	strings.write(table);
+
+	std::vector<StringPool::Handle> handles;
+	ArchiveReader tableReader(table.getData(), table.getData() + table.getSize());
+	ArchiveStringTable::read(tableReader, static_cast<uint32_t>(strings.getSize()), handles);
+
+	auto image = std::make_shared<DiiRecord::FieldImage>();
+	ArchiveReader imageReader(images.getData(), images.getData() + images.getSize());
+	DiiRecord::readFieldImage(imageReader, handles, *image);
+	CHECK(std::memcmp(image.get(), instance.getPrototypeImage().get(), sizeof(DiiRecord::FieldImage)) == 0);
+
+	TestInstance loaded;
+	ArchiveReader recordReader(records.getData(), records.getData() + records.getSize());
+	loaded.readDeltaRecord(recordReader, handles, { image });
+	loaded.userData = instance.userData;
+	CHECK_EQUAL(size_t(0), recordReader.getRemaining());
+	CHECK(equals(instance, loaded));
+	CHECK_EQUAL(instance.getOverrideCount(), loaded.getOverrideCount());
+
+	// the record refers to an image that isn't in the image block
+	ArchiveReader invalidImage(records.getData(), records.getData() + records.getSize());
+	CHECK_THROWS(loaded.readDeltaRecord(invalidImage, handles, {}));
+}
+
+TEST_CASE(diiArchiveRoundTrip)
+{
+	auto instances = createInstances(100);
+	DiiArchive::ProxyMap proxies = { { "DII_1", "DII_2" }, { "DII_3", "DII_4" } };
+	const std::vector<uint32_t> freeNames = { 5, 17 };
+
+	ArchiveWriter writer;
+	DiiArchive::writeArchive(writer, toRecords(instances), proxies, 100, freeNames);
+
+	auto archive = createLoadedArchive();
+	const auto checksum = loadArchive(writer, archive);
+	CHECK(checksum != 0);
+	checkInstances(instances, archive);
+
+	// all instances of a prototype share the loaded image
+	CHECK_EQUAL(archive.instances[0]->getPrototypeImage(), archive.instances[PROTOTYPE_COUNT]->getPrototypeImage());
+
+	CHECK_EQUAL(proxies.size(), archive.proxies.size());
+	for (auto& proxy : archive.proxies) {
+		CHECK_EQUAL(proxies[proxy.first], proxy.second);
+	}
+
+	CHECK(archive.hasNameAllocator);
+	CHECK_EQUAL(100u, archive.nextGeneratedName);
+	CHECK(freeNames == archive.freeGeneratedNames);
+	CHECK(archive.warnings.empty());
+}
+
+TEST_CASE(diiArchiveRejectsCorruptArchives)
+{
+	auto instances = createInstances(10);
+	ArchiveWriter writer;
+	DiiArchive::writeArchive(writer, toRecords(instances), {}, 0, {});
+	std::vector<char> content(writer.getData(), writer.getData() + writer.getSize());
+
+	auto load = [](std::vector<char>& data) {
+		auto archive = createLoadedArchive();
+		DiiArchive::loadArchive(data.data(), data.data() + data.size(), archive);
+	};
+
+	auto flipped = content;
+	flipped[flipped.size() / 2] ^= 0x01;
+	CHECK_THROWS(load(flipped));
+
+	auto truncated = content;
+	truncated.resize(sizeof(DiiArchive::ARCHIVE_HEADER) + 8);
+	CHECK_THROWS(load(truncated));
+
+	auto otherFormat = content;
+	otherFormat[0] = 'X';
+	CHECK_THROWS(load(otherFormat));
+
+	auto otherVersion = content;
+	const float version = 3.0f;
+	std::memcpy(&otherVersion[offsetof(DiiArchive::ARCHIVE_HEADER, version)], &version, sizeof(version));
+	CHECK_THROWS(load(otherVersion));
+}
+
+TEST_CASE(diiArchiveWarnsAboutChangedUserDataAmounts)
+{
+	auto instances = createInstances(3);
+	ArchiveWriter writer;
+	DiiArchive::writeArchive(writer, toRecords(instances), {}, 0, {});
+
+	// the scripts define more integers now: the loaded instances keep the stored values
+	DiiArchive::LoadedArchive archive([] { return std::unique_ptr<DiiRecord>(new TestInstance()); },
+		USER_DATA_INTS + 1, USER_DATA_STRINGS);
+	loadArchive(writer, archive);
+	checkInstances(instances, archive);
+	CHECK(hasWarning(archive, "user data amounts"));
+}
+
+TEST_CASE(diiArchiveAppliesJournalEntries)
+{
+	auto instances = createInstances(10);
+	const DiiArchive::ProxyMap proxies = { { "DII_1", "DII_2" } };
+
+	ArchiveWriter base;
+	DiiArchive::writeArchive(base, toRecords(instances), proxies, 10, {});
+	const auto baseChecksum = archiveChecksum(base.getData(), base.getSize() - sizeof(uint32_t));
+
+	// first save: one changed and one new instance, the proxies are unchanged
+	instances[3]->userData.ints[0] = -3;
+	instances.push_back(createInstance(10));
+	ArchiveWriter journal;
+	DiiArchive::writeJournalEntry(journal, baseChecksum, { instances[3].get(), instances[10].get() }, nullptr, 11, {});
+
+	// second save: a new proxy replaces all proxies
+	const DiiArchive::ProxyMap newProxies = { { "DII_5", "DII_6" } };
+	DiiArchive::writeJournalEntry(journal, baseChecksum, {}, &newProxies, 11, { 7 });
+	std::vector<char> content(journal.getData(), journal.getData() + journal.getSize());
+
+	{
+		auto archive = createLoadedArchive();
+		CHECK_EQUAL(baseChecksum, loadArchive(base, archive));
+		DiiArchive::applyJournal(content, baseChecksum, archive);
+
+		CHECK_EQUAL(2, archive.journalEntryCount);
+		CHECK(archive.warnings.empty());
+		checkInstances(instances, archive);
+		CHECK_EQUAL(size_t(1), archive.proxies.size());
+		CHECK_EQUAL(std::string("DII_5"), archive.proxies[0].first);
+		CHECK_EQUAL(11u, archive.nextGeneratedName);
+		CHECK(archive.freeGeneratedNames == std::vector<uint32_t>{ 7 });
+	}
+
+	// an interrupted save truncates the last entry: the complete entries are kept
+	{
+		auto truncated = content;
+		truncated.resize(truncated.size() - 6);
+
+		auto archive = createLoadedArchive();
+		loadArchive(base, archive);
+		DiiArchive::applyJournal(truncated, baseChecksum, archive);
+
+		CHECK_EQUAL(1, archive.journalEntryCount);
+		CHECK(hasWarning(archive, "incomplete entry"));
+		checkInstances(instances, archive);
+		CHECK_EQUAL(std::string("DII_1"), archive.proxies[0].first);
+	}
+}
+
+TEST_CASE(diiArchiveIgnoresJournalsOfOtherArchives)
+{
+	auto instances = createInstances(10);
+
+	ArchiveWriter base;
+	DiiArchive::writeArchive(base, toRecords(instances), {}, 10, {});
+
+	// the journal was left over by an older archive that couldn't be replaced
+	auto changed = createInstance(3);
+	changed->userData.ints[0] = -3;
+	ArchiveWriter journal;
+	DiiArchive::writeJournalEntry(journal, 0x12345678, { changed.get() }, nullptr, 42, {});
+	std::vector<char> content(journal.getData(), journal.getData() + journal.getSize());
+
+	auto archive = createLoadedArchive();
+	const auto checksum = loadArchive(base, archive);
+	CHECK(checksum != 0x12345678);
+	DiiArchive::applyJournal(content, checksum, archive);
+
+	CHECK_EQUAL(0, archive.journalEntryCount);
+	CHECK(hasWarning(archive, "ignored " + std::to_string(content.size()) + " journal bytes"));
+	checkInstances(instances, archive);
+	CHECK_EQUAL(10u, archive.nextGeneratedName);
+}
+
+TEST_CASE(diiArchiveLoadsVersion_1_1)
+{
+	auto instances = createInstances(20);
+	instances[0]->userData.strings[1] = "trailing spaces  ";
+
+	// the same instance twice: the later one replaces the earlier one
+	auto replaced = createInstance(5);
+	replaced->userData.ints[1] = -1;
+	std::vector<std::unique_ptr<TestInstance>> stored;
+	for (auto& instance : instances) stored.push_back(std::unique_ptr<TestInstance>(new TestInstance(*instance)));
+	stored.push_back(std::unique_ptr<TestInstance>(new TestInstance(*replaced)));
+
+	const auto content = writeArchive_1_1(stored, { { "DII_1  ", "DII_2" } });
+
+	auto archive = createLoadedArchive();
+	CHECK_EQUAL(0u, DiiArchive::loadArchive(content.data(), content.data() + content.size(), archive));
+
+	// version 1.1 strings are trimmed on the right
+	instances[0]->userData.strings[1] = "trailing spaces";
+	instances[5] = std::move(replaced);
+	checkInstances(instances, archive);
+
+	CHECK_EQUAL(size_t(1), archive.proxies.size());
+	CHECK_EQUAL(std::string("DII_1"), archive.proxies[0].first);
+	CHECK_EQUAL(std::string("DII_2"), archive.proxies[0].second);
+	CHECK(!archive.hasNameAllocator);
+
+	// a truncated version 1.1 archive isn't loaded
+	auto truncated = createLoadedArchive();
+	CHECK_THROWS(DiiArchive::loadArchive(content.data(), content.data() + content.size() - 3, truncated));
+}
+
+TEST_CASE(diiArchiveRoundTripOf50kInstances)
+{
+	auto instances = createInstances(INSTANCE_COUNT);
+	ArchiveWriter writer;
+	DiiArchive::writeArchive(writer, toRecords(instances), {}, INSTANCE_COUNT, {});
+
+	auto archive = createLoadedArchive();
+	loadArchive(writer, archive);
+	checkInstances(instances, archive);
+}
+
+BENCHMARK(archiveThroughputAt50kInstances)
+{
+	auto instances = createInstances(INSTANCE_COUNT);
+	const auto records = toRecords(instances);
+
+	// version 1.1: every field is written separately to a stream
+	std::string content_1_1;
+	{
+		test::Stopwatch stopwatch;
+		content_1_1 = writeArchive_1_1(instances, {});
+		test::report("write field by field to a stream (v1.1)", instances.size(), stopwatch.getSeconds(), "instances");
+	}
+
+	{
+		auto archive = createLoadedArchive();
+		test::Stopwatch stopwatch;
+		DiiArchive::loadArchive(content_1_1.data(), content_1_1.data() + content_1_1.size(), archive);
+		test::report("read field by field from a stream (v1.1)", archive.instances.size(), stopwatch.getSeconds(), "instances");
+	}
+
+	ArchiveWriter writer;
+	{
+		test::Stopwatch stopwatch;
+		DiiArchive::writeArchive(writer, records, {}, INSTANCE_COUNT, {});
+		test::report("write archive with string table and CRC (v2)", instances.size(), stopwatch.getSeconds(), "instances");
+	}
+
+	auto archive = createLoadedArchive();
+	{
+		test::Stopwatch stopwatch;
+		loadArchive(writer, archive);
+		test::report("verify CRC and read archive (v2)", archive.instances.size(), stopwatch.getSeconds(), "instances");
+	}
+
+	{
+		test::Stopwatch stopwatch;
+		const auto checksum = archiveChecksum(writer.getData(), writer.getSize());
+		const auto seconds = stopwatch.getSeconds();
+		test::report("CRC-32", writer.getSize() / 1024, seconds, "KiB");
+		CHECK(checksum != 0);
+	}
+
+	std::printf("  archive size: %zu bytes (v1.1: %zu bytes) for %d instances\n", writer.getSize(), content_1_1.size(),
+		INSTANCE_COUNT);
+	CHECK_EQUAL(instances.size(), archive.instances.size());
+}
@@ -0,0 +1,202 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <InitImageCache.h>
+#include <cstring>
+#include <string>
+
+namespace {
+
+	/**
+	 * Stand-ins for oCItem and DynInstance::ItemImage: the fields an instance script sets.
+	 */
+	struct Item {
+		int fields[64];
+		std::string description;
+	};
+
+	struct Image {
+		int fields[64];
+		std::string description;
+	};
+
+	const int WHITELISTED_ID = 5;
+	const int OTHER_ID = 6;
+
+	/**
+	 * A stand-in for the instance scripts: counts its runs and sets fields depending on the instance id
+	 * and the script generation.
+	 */
+	struct Scripts {
+		int runs = 0;
+		unsigned int generation = 1;
+
+		int run(int instanceId, Item& item)
+		{
+			++runs;
+			for (int i = 0; i < 64; ++i) item.fields[i] = instanceId * 1000 + i + static_cast<int>(generation) * 100000;
+			item.description = "Item " + std::to_string(instanceId) + " of generation " + std::to_string(generation);
+			return 1;
+		}
+	};
+
+	int initialize(InitImageCache<Image>& cache, Scripts& scripts, int instanceId, Item& item)
+	{
+		return cache.initialize(instanceId, scripts.generation,
+			[&] { return scripts.run(instanceId, item); },
+			[&](Image& image) {
+				std::memcpy(image.fields, item.fields, sizeof(image.fields));
+				image.description = item.description;
+			},
+			[&](const Image& image) {
+				std::memcpy(item.fields, image.fields, sizeof(item.fields));
+				item.description = image.description;
+			});
+	}
+
+	bool isInitializedBy(const Item& item, const Scripts& scripts, int instanceId)
+	{
+		Scripts reference;
+		reference.generation = scripts.generation;
+		Item expected;
+		reference.run(instanceId, expected);
+		return std::memcmp(item.fields, expected.fields, sizeof(item.fields)) == 0 && item.description == expected.description;
+	}
+}
+
+TEST_CASE(initImageCacheRunsTheScriptOncePerGeneration)
+{
+	InitImageCache<Image> cache;
+	Scripts scripts;
+	CHECK(cache.needsWhitelist(scripts.generation));
+	cache.setWhitelist({ WHITELISTED_ID }, scripts.generation);
+	CHECK(!cache.needsWhitelist(scripts.generation));
+
+	for (int i = 0; i < 3; ++i) {
+		Item item = {};
+		CHECK_EQUAL(1, initialize(cache, scripts, WHITELISTED_ID, item));
+		CHECK(isInitializedBy(item, scripts, WHITELISTED_ID));
+	}
+	CHECK_EQUAL(1, scripts.runs);
+	CHECK_EQUAL(size_t(1), cache.getImageCount());
+}
+
+TEST_CASE(initImageCacheIsInvalidatedByAGenerationBump)
+{
+	InitImageCache<Image> cache;
+	Scripts scripts;
+	cache.setWhitelist({ WHITELISTED_ID }, scripts.generation);
+
+	Item item = {};
+	initialize(cache, scripts, WHITELISTED_ID, item);
+	CHECK(cache.find(WHITELISTED_ID, scripts.generation) != nullptr);
+
+	// e.g. a proxy changed the script the instance id runs
+	++scripts.generation;
+	CHECK(cache.find(WHITELISTED_ID, scripts.generation) == nullptr);
+	CHECK(cache.needsWhitelist(scripts.generation));
+
+	// the stale image isn't applied even before the whitelist is resolved again
+	Item stale = {};
+	initialize(cache, scripts, WHITELISTED_ID, stale);
+	CHECK_EQUAL(2, scripts.runs);
+	CHECK(isInitializedBy(stale, scripts, WHITELISTED_ID));
+
+	// resolving the whitelist for the new generation releases all images
+	cache.setWhitelist({ WHITELISTED_ID }, scripts.generation);
+	CHECK_EQUAL(size_t(0), cache.getImageCount());
+
+	Item fresh = {};
+	initialize(cache, scripts, WHITELISTED_ID, fresh);
+	initialize(cache, scripts, WHITELISTED_ID, fresh);
+	CHECK_EQUAL(3, scripts.runs);
+	CHECK(isInitializedBy(fresh, scripts, WHITELISTED_ID));
+}
+
+TEST_CASE(initImageCacheAlwaysRunsScriptsOfOtherInstances)
+{
+	InitImageCache<Image> cache;
+	Scripts scripts;
+	cache.setWhitelist({ WHITELISTED_ID }, scripts.generation);
+
+	for (int i = 0; i < 3; ++i) {
+		Item item = {};
+		CHECK_EQUAL(1, initialize(cache, scripts, OTHER_ID, item));
+		CHECK(isInitializedBy(item, scripts, OTHER_ID));
+	}
+	CHECK_EQUAL(3, scripts.runs);
+	CHECK_EQUAL(size_t(0), cache.getImageCount());
+	CHECK(!cache.isWhitelisted(OTHER_ID));
+
+	// an empty whitelist caches nothing
+	cache.setWhitelist({}, scripts.generation);
+	Item item = {};
+	initialize(cache, scripts, WHITELISTED_ID, item);
+	initialize(cache, scripts, WHITELISTED_ID, item);
+	CHECK_EQUAL(5, scripts.runs);
+}
+
+TEST_CASE(initImageCacheDoesntCacheFailedScripts)
+{
+	InitImageCache<Image> cache;
+	cache.setWhitelist({ WHITELISTED_ID }, 1);
+
+	int runs = 0;
+	auto failingScript = [&] { ++runs; return 0; };
+	auto capture = [](Image&) {};
+	auto apply = [](const Image&) {};
+
+	CHECK_EQUAL(0, cache.initialize(WHITELISTED_ID, 1, failingScript, capture, apply));
+	CHECK_EQUAL(0, cache.initialize(WHITELISTED_ID, 1, failingScript, capture, apply));
+	CHECK_EQUAL(2, runs);
+	CHECK(cache.find(WHITELISTED_ID, 1) == nullptr);
+}
+
+BENCHMARK(initImageCacheVersusScript)
+{
+	const int itemCount = 200000;
+	Scripts scripts;
+	Item item = {};
+
+	{
+		test::Stopwatch stopwatch;
+		for (int i = 0; i < itemCount; ++i) scripts.run(WHITELISTED_ID, item);
+		test::report("init by stand-in script", itemCount, stopwatch.getSeconds(), "items");
+	}
+
+	InitImageCache<Image> cache;
+	cache.setWhitelist({ WHITELISTED_ID }, scripts.generation);
+	scripts.runs = 0;
+	{
+		test::Stopwatch stopwatch;
+		for (int i = 0; i < itemCount; ++i) initialize(cache, scripts, WHITELISTED_ID, item);
+		test::report("init from cached image", itemCount, stopwatch.getSeconds(), "items");
+	}
+	CHECK_EQUAL(1, scripts.runs);
+}
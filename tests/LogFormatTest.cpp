@@ -0,0 +1,186 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <LogFormat.h>
+
+namespace {
+
+	template<class... Args>
+	std::string formatArgs(const std::string& format, const Args&... args)
+	{
+		std::string encoded;
+		LogFormat::appendArgs(encoded, args...);
+
+		std::string out;
+		if (!LogFormat::format(format, encoded.data(), encoded.size(), out)) {
+			test::fail(__FILE__, __LINE__, "malformed arguments for '" + format + "'");
+		}
+		return out;
+	}
+}
+
+TEST_CASE(logFormatRoundTripsAllArgumentTypes)
+{
+	const int* pointer = reinterpret_cast<const int*>(0x1234ABCD);
+
+	CHECK_EQUAL(std::string("-42 42 -5000000000 5000000000"), formatArgs("{} {} {} {}", -42, 42u, -5000000000LL, 5000000000ULL));
+	CHECK_EQUAL(std::string("1.5 0.25 1 x"), formatArgs("{} {} {} {}", 1.5, 0.25f, true, 'x'));
+	CHECK_EQUAL(std::string("ITMW_SWORD, (null), "), formatArgs("{}, {}, {}", "ITMW_SWORD", static_cast<const char*>(nullptr), std::string()));
+	CHECK_EQUAL(std::string("1234ABCD"), formatArgs("{}", static_cast<const void*>(pointer)));
+	CHECK_EQUAL(std::string("no placeholders"), formatArgs("no placeholders"));
+}
+
+TEST_CASE(logFormatStringsKeepEmbeddedBytes)
+{
+	std::string value("a\0{}\n", 5);
+	CHECK_EQUAL("<" + value + ">", formatArgs("<{}>", value));
+}
+
+TEST_CASE(logFormatHandlesMissingAndSurplusArguments)
+{
+	CHECK_EQUAL(std::string("1 {} {}"), formatArgs("{} {} {}", 1));
+	CHECK_EQUAL(std::string("1"), formatArgs("{}", 1, 2, 3));
+}
+
+TEST_CASE(logFormatRejectsMalformedArguments)
+{
+	std::string encoded;
+	LogFormat::appendArgs(encoded, 12345, std::string("text"));
+	std::string out;
+
+	// truncated values
+	for (size_t size = 1; size < encoded.size(); ++size) {
+		if (size == 1 + sizeof(int32_t)) continue;
+		out.clear();
+		CHECK(!LogFormat::format("{} {}", encoded.data(), size, out));
+	}
+
+	// unknown type tag
+	const char unknown[] = { 'x', 1, 0, 0, 0 };
+	CHECK(!LogFormat::format("{}", unknown, sizeof(unknown), out));
+
+	// a string length beyond the end
+	std::string huge;
+	huge += static_cast<char>(LogFormat::STRING);
+	LogFormat::appendRaw(huge, static_cast<uint32_t>(0xFFFFFFFF));
+	CHECK(!LogFormat::format("{}", huge.data(), huge.size(), out));
+}
+
+TEST_CASE(logFormatWallClockAndPrefix)
+{
+	char wallClock[LogFormat::WALL_CLOCK_SIZE];
+	LogFormat::formatWallClock(13 * 3600 + 5 * 60 + 42, wallClock, sizeof(wallClock));
+	CHECK_EQUAL(std::string("13:5:42"), std::string(wallClock));
+
+	LogFormat::formatWallClock(24 * 3600 - 1, wallClock, sizeof(wallClock));
+	CHECK_EQUAL(std::string("23:59:59"), std::string(wallClock));
+
+	std::string prefix;
+	LogFormat::appendPrefix(prefix, "13:5:42", 1, 1042337);
+	CHECK_EQUAL(std::string("[13:5:42, 1042337us, INFO]    "), prefix);
+
+	prefix.clear();
+	LogFormat::appendPrefix(prefix, "0:0:0", 0, 0);
+	CHECK_EQUAL(std::string("[0:0:0, 0us]    "), prefix);
+
+	CHECK_EQUAL(std::string("FATAL"), std::string(LogFormat::getLevelName(4)));
+	CHECK_EQUAL(std::string(), std::string(LogFormat::getLevelName(9)));
+}
+
+TEST_CASE(logFormatRawValuesAndFileHeader)
+{
+	std::string out;
+	const LogFormat::FILE_HEADER header;
+	LogFormat::appendRaw(out, header);
+	LogFormat::appendRaw(out, static_cast<uint8_t>(LogFormat::MESSAGE));
+	LogFormat::appendRaw(out, static_cast<uint64_t>(1) << 40);
+
+	const char* current = out.data();
+	const char* end = current + out.size();
+
+	LogFormat::FILE_HEADER readHeader;
+	std::memset(readHeader.magic, 0, sizeof(readHeader.magic));
+	uint8_t type = 0;
+	uint64_t microseconds = 0;
+
+	CHECK(LogFormat::readRaw(current, end, readHeader));
+	CHECK(std::memcmp(header.magic, readHeader.magic, sizeof(header.magic)) == 0);
+	CHECK_EQUAL(header.version, readHeader.version);
+	CHECK(LogFormat::readRaw(current, end, type));
+	CHECK_EQUAL(static_cast<uint8_t>(LogFormat::MESSAGE), type);
+	CHECK(LogFormat::readRaw(current, end, microseconds));
+	CHECK_EQUAL(static_cast<uint64_t>(1) << 40, microseconds);
+
+	// nothing left; the position stays
+	CHECK(!LogFormat::readRaw(current, end, type));
+	CHECK(current == end);
+}
+
+BENCHMARK(logFormatEncodingVersusText)
+{
+	const int count = 500000;
+	const std::string format = "Levitation: collision of {} with {} at height {}";
+	const std::string vobName = "PC_HERO";
+	size_t bytes = 0;
+
+	// text logging: the message is formatted at the call site
+	{
+		test::Stopwatch stopwatch;
+		for (int i = 0; i < count; ++i) {
+			std::stringstream ss;
+			ss << "Levitation: collision of " << vobName << " with " << i << " at height " << 1.5f * i;
+			bytes += ss.str().size();
+		}
+		test::report("format text via stringstream", count, stopwatch.getSeconds(), "messages");
+	}
+
+	std::string encoded;
+	{
+		test::Stopwatch stopwatch;
+		for (int i = 0; i < count; ++i) {
+			encoded.clear();
+			LogFormat::appendArgs(encoded, vobName, i, 1.5f * i);
+			bytes += encoded.size();
+		}
+		test::report("encode arguments (binary log)", count, stopwatch.getSeconds(), "messages");
+	}
+
+	{
+		std::string out;
+		test::Stopwatch stopwatch;
+		for (int i = 0; i < count; ++i) {
+			out.clear();
+			LogFormat::format(format, encoded.data(), encoded.size(), out);
+			bytes += out.size();
+		}
+		test::report("decode arguments (log decoder)", count, stopwatch.getSeconds(), "messages");
+	}
+
+	CHECK(bytes > 0);
+}
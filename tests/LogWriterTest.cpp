@@ -0,0 +1,270 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <LogWriter.h>
+#include <Windows.h>
+#include <io.h>
+#include <unistd.h>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+namespace {
+
+	/**
+	 * A log file in the temp directory; removed when the object is destroyed.
+	 */
+	class TempLogFile {
+	public:
+		explicit TempLogFile(const char* name)
+		{
+			const char* dir = std::getenv("TMPDIR");
+			mPath = std::string(dir ? dir : "/tmp") + "/neclib-" + name + "-" + std::to_string(getpid()) + ".log";
+			std::remove(mPath.c_str());
+		}
+
+		~TempLogFile() { std::remove(mPath.c_str()); }
+
+		const std::string& getPath() const { return mPath; }
+
+		std::string read() const
+		{
+			std::ifstream file(mPath, std::ios::binary);
+			return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+	private:
+		std::string mPath;
+	};
+
+	std::vector<std::string> splitLines(const std::string& content)
+	{
+		std::vector<std::string> lines;
+		std::stringstream ss(content);
+		std::string line;
+		while (std::getline(ss, line)) lines.push_back(line);
+		return lines;
+	}
+
+	/**
+	 * Pushes 'count' messages "<producer>:<index>" from each producer thread.
+	 */
+	void pushConcurrently(LogWriter& writer, int producers, int count)
+	{
+		std::vector<std::thread> threads;
+		for (int producer = 0; producer < producers; ++producer) {
+			threads.emplace_back([&writer, producer, count] {
+				for (int i = 0; i < count; ++i) {
+					writer.push(Logger::Info, std::to_string(producer) + ":" + std::to_string(i) + "\n");
+				}
+			});
+		}
+		for (auto& thread : threads) thread.join();
+	}
+}
+
+TEST_CASE(logWriterKeepsTheOrderOfEachProducer)
+{
+	const int producers = 4;
+	const int count = 20000;
+	TempLogFile file("order");
+
+	{
+		LogWriter writer(file.getPath(), LogWriter::FlushPolicy::Never);
+		writer.start();
+		pushConcurrently(writer, producers, count);
+	}
+
+	const auto lines = splitLines(file.read());
+	CHECK_EQUAL(size_t(producers * count), lines.size());
+
+	std::vector<int> next(producers, 0);
+	for (const auto& line : lines) {
+		const auto separator = line.find(':');
+		const int producer = std::stoi(line.substr(0, separator));
+		const int index = std::stoi(line.substr(separator + 1));
+		CHECK(producer >= 0 && producer < producers);
+		CHECK_EQUAL(next[producer], index);
+		++next[producer];
+	}
+}
+
+TEST_CASE(logWriterWithoutThreadWritesWhenFull)
+{
+	TempLogFile file("unstarted");
+	LogWriter writer(file.getPath(), LogWriter::FlushPolicy::Never);
+	const int count = static_cast<int>(LogWriter::CAPACITY) + 10;
+
+	for (int i = 0; i < count; ++i) {
+		writer.push(Logger::Info, std::to_string(i) + "\n");
+	}
+
+	// the producer wrote the full ring buffer itself
+	CHECK_EQUAL(LogWriter::CAPACITY, splitLines(file.read()).size());
+
+	writer.flush();
+	const auto lines = splitLines(file.read());
+	CHECK_EQUAL(size_t(count), lines.size());
+	CHECK_EQUAL(std::to_string(count - 1), lines.back());
+}
+
+TEST_CASE(logWriterWritesBytesUnchanged)
+{
+	TempLogFile file("binary");
+	std::string record("\x02\x0A\x0D\x0A", 4);
+	record += '\0';
+	record += "text\r\n";
+
+	{
+		std::ofstream(file.getPath(), std::ios::binary) << "existing\n";
+		LogWriter writer(file.getPath(), LogWriter::FlushPolicy::Batch);
+		writer.start();
+		writer.push(Logger::Info, record);
+	}
+
+	// appended to the existing content without LF -> CR LF translation
+	CHECK_EQUAL("existing\n" + record, file.read());
+}
+
+TEST_CASE(logWriterReleasesItsModuleReference)
+{
+	TempLogFile file("module");
+	const int references = compat::getModuleReferences();
+
+	{
+		LogWriter writer(file.getPath(), LogWriter::FlushPolicy::Never);
+		writer.start();
+		writer.start();
+		CHECK_EQUAL(references + 1, compat::getModuleReferences().load());
+	}
+
+	for (int i = 0; i < 20; ++i) {
+		LogWriter writer(file.getPath(), LogWriter::FlushPolicy::Never);
+		writer.start();
+		writer.push(Logger::Info, "message\n");
+	}
+
+	// the writer threads release the reference when they exit, shortly after the writers are destroyed
+	for (int i = 0; i < 1000 && compat::getModuleReferences() != references; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK_EQUAL(references, compat::getModuleReferences().load());
+	CHECK_EQUAL(size_t(20), splitLines(file.read()).size());
+}
+
+TEST_CASE(logWriterCommitsAccordingToTheFlushPolicy)
+{
+	TempLogFile file("policy");
+	auto commitsOf = [&](LogWriter::FlushPolicy policy, Logger::LogLevel level) {
+		const int before = compat::getCommitCount();
+		{
+			LogWriter writer(file.getPath(), policy);
+			writer.start();
+			writer.push(Logger::Info, "info\n");
+			writer.push(level, "message\n");
+		}
+		return compat::getCommitCount() - before;
+	};
+
+	CHECK_EQUAL(0, commitsOf(LogWriter::FlushPolicy::Never, Logger::Fatal));
+	CHECK(commitsOf(LogWriter::FlushPolicy::Batch, Logger::Info) > 0);
+	CHECK_EQUAL(0, commitsOf(LogWriter::FlushPolicy::Fatal, Logger::Warning));
+	CHECK(commitsOf(LogWriter::FlushPolicy::Fatal, Logger::Fatal) > 0);
+
+	// flush() always commits
+	LogWriter writer(file.getPath(), LogWriter::FlushPolicy::Never);
+	writer.push(Logger::Info, "info\n");
+	const int before = compat::getCommitCount();
+	writer.flush();
+	CHECK_EQUAL(before + 1, compat::getCommitCount().load());
+}
+
+TEST_CASE(logWriterParsesFlushPolicies)
+{
+	CHECK(LogWriter::parseFlushPolicy("never") == LogWriter::FlushPolicy::Never);
+	CHECK(LogWriter::parseFlushPolicy("FATAL") == LogWriter::FlushPolicy::Fatal);
+	CHECK(LogWriter::parseFlushPolicy("Batch") == LogWriter::FlushPolicy::Batch);
+	CHECK(LogWriter::parseFlushPolicy("sometimes") == LogWriter::FlushPolicy::Batch);
+}
+
+BENCHMARK(logWriterThroughput)
+{
+	const std::string message = "[13:5:42, INFO]    Levitation: collision with a static polygon\n";
+
+	// previous Logger::writeToFile(): opens, writes, commits and closes the file per message
+	{
+		TempLogFile file("bench-direct");
+		const int count = 500;
+		test::Stopwatch stopwatch;
+		for (int i = 0; i < count; ++i) {
+			FILE* pFile;
+			fopen_s(&pFile, file.getPath().c_str(), "a");
+			fputs(message.c_str(), pFile);
+			fflush(pFile);
+			_commit(_fileno(pFile));
+			fclose(pFile);
+		}
+		test::report("open/write/commit/close per message", count, stopwatch.getSeconds(), "messages");
+	}
+
+	const int count = 200000;
+	const struct {
+		const char* name;
+		LogWriter::FlushPolicy policy;
+		int producers;
+	} runs[] = {
+		{ "writer thread, 1 producer, flush policy batch", LogWriter::FlushPolicy::Batch, 1 },
+		{ "writer thread, 4 producers, flush policy batch", LogWriter::FlushPolicy::Batch, 4 },
+		{ "writer thread, 4 producers, flush policy never", LogWriter::FlushPolicy::Never, 4 },
+	};
+
+	for (const auto& run : runs) {
+		TempLogFile file("bench-writer");
+		test::Stopwatch stopwatch;
+		double pushSeconds;
+		{
+			LogWriter writer(file.getPath(), run.policy);
+			writer.start();
+
+			std::vector<std::thread> threads;
+			for (int producer = 0; producer < run.producers; ++producer) {
+				threads.emplace_back([&] {
+					for (int i = 0; i < count / run.producers; ++i) writer.push(Logger::Info, message);
+				});
+			}
+			for (auto& thread : threads) thread.join();
+			pushSeconds = stopwatch.getSeconds();
+		}
+
+		// including the time until the last message is written
+		test::report(run.name, count, stopwatch.getSeconds(), "messages");
+		std::printf("  %-50s %10.3f ms until the last push returned\n", "", pushSeconds * 1000.0);
+		CHECK_EQUAL(message.size() * count, file.read().size());
+	}
+}
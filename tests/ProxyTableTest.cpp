@@ -0,0 +1,203 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <ProxyTable.h>
+#include <cstdint>
+
+namespace {
+
+	const int SYMBOL_COUNT = 50000;
+
+	/**
+	 * Proxies as mods create them: sources among the DIIs at the end of the symbol table, each chain
+	 * up to four proxies long and ending at a script instance.
+	 */
+	void addProxies(ProxyTable& table, int count)
+	{
+		for (int i = 0; i < count; ++i) {
+			const int source = SYMBOL_COUNT - 1 - i;
+			const int target = i % 4 == 3 ? i : source - 1;
+			table.add(source, target);
+		}
+	}
+
+	std::vector<int> createLookups(size_t count)
+	{
+		std::vector<int> lookups(count);
+		uint32_t random = 12345;
+		for (auto& index : lookups) {
+			random = random * 1664525u + 1013904223u;
+			index = static_cast<int>((random >> 8) % SYMBOL_COUNT);
+		}
+		return lookups;
+	}
+}
+
+TEST_CASE(proxyTableResolvesChains)
+{
+	ProxyTable table;
+	CHECK_EQUAL(7, table.resolve(7));
+
+	// 1 -> 2 -> 3 and 10 -> 3
+	table.add(1, 2);
+	table.add(2, 3);
+	table.add(10, 3);
+
+	// the chains are walked until the table is rebuilt
+	CHECK(table.isPending());
+	CHECK_EQUAL(3, table.resolve(1));
+	CHECK_EQUAL(3, table.resolve(2));
+
+	table.rebuild();
+	CHECK(!table.isPending());
+	CHECK_EQUAL(3, table.resolve(1));
+	CHECK_EQUAL(3, table.resolve(2));
+	CHECK_EQUAL(3, table.resolve(3));
+	CHECK_EQUAL(3, table.resolve(10));
+	CHECK_EQUAL(5, table.resolve(5));
+
+	// outside of the resolved table
+	CHECK_EQUAL(11, table.resolve(11));
+	CHECK_EQUAL(-1, table.resolve(-1));
+	CHECK_EQUAL(size_t(3), table.size());
+}
+
+TEST_CASE(proxyTableDetectsCycles)
+{
+	ProxyTable table;
+	table.add(1, 2);
+	table.add(2, 3);
+
+	CHECK(table.wouldCreateCycle(3, 1));
+	CHECK(table.wouldCreateCycle(3, 2));
+	CHECK(table.wouldCreateCycle(2, 1));
+	CHECK(table.wouldCreateCycle(4, 4));
+	CHECK(!table.wouldCreateCycle(4, 1));
+	CHECK(!table.wouldCreateCycle(3, 4));
+
+	// rejected proxies leave the table unchanged, so all chains still terminate
+	table.add(4, 1);
+	table.rebuild();
+	CHECK_EQUAL(3, table.resolve(4));
+	CHECK(!table.wouldCreateCycle(0, 4));
+}
+
+TEST_CASE(proxyTableRebuildsAfterRemovingAProxy)
+{
+	ProxyTable table;
+	table.add(1, 2);
+	table.add(2, 3);
+	table.add(8, 1);
+	table.rebuild();
+	CHECK_EQUAL(3, table.resolve(8));
+
+	// the chain now ends at 2
+	CHECK(table.remove(2));
+	CHECK(!table.remove(2));
+	CHECK(table.isPending());
+	CHECK_EQUAL(2, table.resolve(8));
+
+	table.rebuild();
+	CHECK_EQUAL(2, table.resolve(1));
+	CHECK_EQUAL(2, table.resolve(2));
+	CHECK_EQUAL(2, table.resolve(8));
+
+	// a proxy to the former chain end is allowed now
+	CHECK(!table.wouldCreateCycle(3, 8));
+
+	// removing the proxy with the highest source shrinks the resolved table
+	CHECK(table.remove(8));
+	table.rebuild();
+	CHECK_EQUAL(8, table.resolve(8));
+
+	table.clear();
+	CHECK(table.empty());
+	CHECK(!table.isPending());
+	CHECK_EQUAL(1, table.resolve(1));
+}
+
+TEST_CASE(proxyTableMatchesTheChainWalk)
+{
+	ProxyTable table;
+	addProxies(table, 1000);
+	table.rebuild();
+
+	for (int i = 0; i < SYMBOL_COUNT; ++i) {
+		if (table.resolve(i) != table.resolveChain(i)) {
+			test::fail(__FILE__, __LINE__, "symbol " + std::to_string(i) + " resolves to another target");
+		}
+	}
+}
+
+BENCHMARK(proxyTableVersusChainWalk)
+{
+	const int proxyCount = 10000;
+	const size_t lookupCount = 4000000;
+	const auto lookups = createLookups(lookupCount);
+
+	ProxyTable table;
+	addProxies(table, proxyCount);
+	table.rebuild();
+
+	// previous path: every lookup walks the chain in the ordered proxy map
+	int64_t walkSum = 0;
+	{
+		test::Stopwatch stopwatch;
+		for (auto index : lookups) walkSum += table.resolveChain(index);
+		test::report("resolve by walking the proxy chain", lookupCount, stopwatch.getSeconds(), "lookups");
+	}
+
+	int64_t tableSum = 0;
+	{
+		test::Stopwatch stopwatch;
+		for (auto index : lookups) tableSum += table.resolve(index);
+		test::report("resolve via path compressed table", lookupCount, stopwatch.getSeconds(), "lookups");
+	}
+	CHECK_EQUAL(walkSum, tableSum);
+
+	// loading a savegame: a rebuild per proxy against a single rebuild at the end of the batch
+	const int loadCount = 2000;
+	{
+		ProxyTable loaded;
+		test::Stopwatch stopwatch;
+		for (int i = 0; i < loadCount; ++i) {
+			loaded.add(SYMBOL_COUNT - 1 - i, i % 4 == 3 ? i : SYMBOL_COUNT - 2 - i);
+			loaded.rebuild();
+		}
+		test::report("load 2k proxies, rebuild per proxy", loadCount, stopwatch.getSeconds(), "proxies");
+	}
+
+	{
+		ProxyTable loaded;
+		test::Stopwatch stopwatch;
+		addProxies(loaded, loadCount);
+		loaded.rebuild();
+		test::report("load 2k proxies, rebuild once", loadCount, stopwatch.getSeconds(), "proxies");
+	}
+}
@@ -0,0 +1,205 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <SlotTable.h>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+namespace {
+
+	/**
+	 * Stand-ins for DynInstance and zCPar_Symbol. The slot has the layout of ObjectManager::DynInstanceSlot.
+	 */
+	struct Instance {
+		int value;
+	};
+
+	struct Symbol {
+		int index;
+	};
+
+	struct Slot {
+
+		enum Flags {
+			HAS_INSTANCE = 1 << 0,
+			HAS_SYMBOL = 1 << 1,
+		};
+
+		std::unique_ptr<Instance> instance;
+		Symbol* symbol = nullptr;
+		int flags = 0;
+		int padding = 0;
+	};
+
+	// the script symbols of Gothic 2 precede the DIIs in the parser symbol table
+	const int FIRST_DII_INDEX = 30000;
+	const int DII_COUNT = 20000;
+
+	/**
+	 * The lookups of the parser hooks: mostly script instances, every fourth one a DII.
+	 */
+	std::vector<int> createLookups(size_t count)
+	{
+		std::vector<int> lookups(count);
+		uint32_t random = 12345;
+		for (auto& index : lookups) {
+			random = random * 1664525u + 1013904223u;
+			index = (random >> 8) % 4 == 0
+				? FIRST_DII_INDEX + static_cast<int>((random >> 12) % DII_COUNT)
+				: static_cast<int>((random >> 12) % FIRST_DII_INDEX);
+		}
+		return lookups;
+	}
+}
+
+TEST_CASE(slotTableGetOutsideOfTheTable)
+{
+	SlotTable<Slot> table;
+	CHECK(table.get(0) == nullptr);
+	CHECK(table.empty());
+
+	table.acquire(10).flags = Slot::HAS_SYMBOL;
+	CHECK_EQUAL(10, table.getFirstIndex());
+	CHECK_EQUAL(size_t(1), table.size());
+	CHECK(table.get(9) == nullptr);
+	CHECK(table.get(11) == nullptr);
+	CHECK(table.get(-5) == nullptr);
+	CHECK(table.get(INT32_MIN) == nullptr);
+	CHECK(table.get(INT32_MAX) == nullptr);
+	CHECK_EQUAL(int(Slot::HAS_SYMBOL), table.get(10)->flags);
+}
+
+TEST_CASE(slotTableGrowsInBothDirections)
+{
+	SlotTable<Slot> table;
+	Symbol symbols[3] = { { 100 }, { 105 }, { 98 } };
+
+	auto& first = table.acquire(100);
+	first.instance.reset(new Instance{ 1 });
+	first.symbol = &symbols[0];
+
+	// appended: the slots in between stay empty
+	table.acquire(105).symbol = &symbols[1];
+	CHECK_EQUAL(size_t(6), table.size());
+	CHECK(table.get(103)->symbol == nullptr);
+	CHECK(!table.get(103)->instance);
+
+	// prepended: the existing slots keep their content
+	table.acquire(98).symbol = &symbols[2];
+	CHECK_EQUAL(98, table.getFirstIndex());
+	CHECK_EQUAL(size_t(8), table.size());
+	CHECK_EQUAL(1, table.get(100)->instance->value);
+	CHECK_EQUAL(&symbols[0], table.get(100)->symbol);
+	CHECK_EQUAL(&symbols[1], table.get(105)->symbol);
+	CHECK_EQUAL(&symbols[2], table.get(98)->symbol);
+	CHECK_EQUAL(&table.acquire(100), table.get(100));
+
+	int symbolCount = 0;
+	for (auto& slot : table) {
+		if (slot.symbol) ++symbolCount;
+	}
+	CHECK_EQUAL(3, symbolCount);
+
+	table.clear();
+	CHECK(table.empty());
+	CHECK(table.get(100) == nullptr);
+	table.acquire(7);
+	CHECK_EQUAL(7, table.getFirstIndex());
+}
+
+BENCHMARK(slotTableVersusHashMaps)
+{
+	const size_t lookupCount = 4000000;
+	const int iterationRounds = 200;
+	const auto lookups = createLookups(lookupCount);
+	std::vector<Symbol> symbols(DII_COUNT);
+
+	// previous storage: a hash map for the instances and one for the symbols
+	std::unordered_map<int, std::unique_ptr<Instance>> instanceMap;
+	std::unordered_map<int, Symbol*> symbolMap;
+	SlotTable<Slot> table;
+	for (int i = 0; i < DII_COUNT; ++i) {
+		const int index = FIRST_DII_INDEX + i;
+		symbols[i].index = index;
+		instanceMap[index].reset(new Instance{ i });
+		symbolMap[index] = &symbols[i];
+
+		auto& slot = table.acquire(index);
+		slot.instance.reset(new Instance{ i });
+		slot.symbol = &symbols[i];
+		slot.flags = Slot::HAS_INSTANCE | Slot::HAS_SYMBOL;
+	}
+
+	// isDynamicInstance and getInstanceItem: membership test, then the instance and its symbol
+	int64_t mapSum = 0;
+	{
+		test::Stopwatch stopwatch;
+		for (auto index : lookups) {
+			auto it = instanceMap.find(index);
+			if (it == instanceMap.end()) continue;
+			mapSum += it->second->value + symbolMap.find(index)->second->index;
+		}
+		test::report("lookup in hash maps", lookupCount, stopwatch.getSeconds(), "lookups");
+	}
+
+	int64_t tableSum = 0;
+	{
+		test::Stopwatch stopwatch;
+		for (auto index : lookups) {
+			auto* slot = table.get(index);
+			if (!slot || !(slot->flags & Slot::HAS_INSTANCE)) continue;
+			tableSum += slot->instance->value + slot->symbol->index;
+		}
+		test::report("lookup in slot table", lookupCount, stopwatch.getSeconds(), "lookups");
+	}
+	CHECK_EQUAL(mapSum, tableSum);
+
+	// saving and the string collection visit all instances
+	mapSum = 0;
+	{
+		test::Stopwatch stopwatch;
+		for (int round = 0; round < iterationRounds; ++round) {
+			for (auto& pair : instanceMap) mapSum += pair.second->value;
+		}
+		test::report("iterate hash map", size_t(iterationRounds) * DII_COUNT, stopwatch.getSeconds(), "instances");
+	}
+
+	tableSum = 0;
+	{
+		test::Stopwatch stopwatch;
+		for (int round = 0; round < iterationRounds; ++round) {
+			for (auto& slot : table) {
+				if (slot.instance) tableSum += slot.instance->value;
+			}
+		}
+		test::report("iterate slot table", size_t(iterationRounds) * DII_COUNT, stopwatch.getSeconds(), "instances");
+	}
+	CHECK_EQUAL(mapSum, tableSum);
+}
@@ -0,0 +1,186 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <StringPool.h>
+
+TEST_CASE(stringPoolInternsEqualStringsOnce)
+{
+	StringPool pool;
+	const auto a = pool.intern("ITMW_1H_SWORD");
+	const auto b = pool.intern(std::string("ITMW_1H_SWORD"));
+	const auto c = pool.intern("ITMW_2H_AXE");
+
+	CHECK_EQUAL(a, b);
+	CHECK(a != c);
+	CHECK_EQUAL(std::string("ITMW_1H_SWORD"), pool.resolve(a));
+	CHECK_EQUAL(std::string("ITMW_2H_AXE"), std::string(pool.c_str(c)));
+
+	// the two strings and the empty string
+	CHECK_EQUAL(size_t(3), pool.getSize());
+}
+
+TEST_CASE(stringPoolEmptyAndInvalidHandles)
+{
+	StringPool pool;
+	CHECK_EQUAL(StringPool::EMPTY, pool.intern(""));
+	CHECK_EQUAL(StringPool::EMPTY, pool.intern(static_cast<const char*>(nullptr)));
+	CHECK_EQUAL(StringPool::EMPTY, pool.intern(std::string()));
+	CHECK(pool.resolve(12345).empty());
+
+	pool.intern("A");
+	pool.clear();
+	CHECK_EQUAL(size_t(1), pool.getSize());
+	CHECK(pool.resolve(1).empty());
+}
+
+TEST_CASE(stringPoolSweepReleasesUnmarkedStrings)
+{
+	StringPool pool;
+	const auto kept = pool.intern("KEPT");
+	const auto released = pool.intern("RELEASED");
+
+	pool.beginCollection();
+	pool.mark(kept);
+
+	// strings interned during a collection survive the sweep
+	const auto internedDuringCollection = pool.intern("NEW");
+
+	CHECK_EQUAL(size_t(1), pool.sweep());
+	CHECK_EQUAL(std::string("KEPT"), pool.resolve(kept));
+	CHECK_EQUAL(std::string("NEW"), pool.resolve(internedDuringCollection));
+	CHECK(pool.resolve(released).empty());
+	CHECK_EQUAL(size_t(3), pool.getSize());
+
+	// the released handle is reused and the released string can be interned again
+	const auto reused = pool.intern("OTHER");
+	CHECK_EQUAL(released, reused);
+	CHECK(pool.intern("RELEASED") != reused);
+}
+
+TEST_CASE(stringPoolCollectionIsDueAfterGrowth)
+{
+	StringPool pool;
+	CHECK(!pool.isCollectionDue());
+
+	for (int i = 0; i < 5000; ++i) {
+		pool.intern("STRING_" + std::to_string(i));
+	}
+	CHECK(pool.isCollectionDue());
+
+	pool.beginCollection();
+	CHECK_EQUAL(size_t(5000), pool.sweep());
+	CHECK(!pool.isCollectionDue());
+	CHECK_EQUAL(size_t(1), pool.getSize());
+}
+
+namespace {
+
+	// the text fields of a DynInstance: name, nameID, visual, visual_change, effect, scemeName, description,
+	// text[6], on_state[4], owner, munition, ... (25 fields)
+	const int TEXT_FIELD_COUNT = 25;
+
+	/**
+	 * Provides the content of a text field of a synthetic DII. The DIIs are created from a few prototypes,
+	 * so most fields are shared; the name differs per DII and the text fields per upgrade level.
+	 */
+	std::string getFieldContent(int dii, int field)
+	{
+		const int prototype = dii % 40;
+		switch (field) {
+		case 0: return "Enchanted weapon of the sword master " + std::to_string(dii);
+		case 1: return "ITMW_PROTOTYPE_" + std::to_string(prototype);
+		case 2: return "ITMW_PROTOTYPE_" + std::to_string(prototype) + ".3DS";
+		case 7: case 8: case 9:
+			return "Damage bonus of upgrade level " + std::to_string(dii % 10) + " against armored targets";
+		default:
+			if (field > 12) return std::string();
+			return "Text field " + std::to_string(field) + " of the prototype " + std::to_string(prototype);
+		}
+	}
+}
+
+BENCHMARK(stringPoolMemoryReport)
+{
+	const int diiCount = 20000;
+	StringPool pool;
+
+	size_t unpooledBytes = 0;
+	std::vector<StringPool::Handle> handles;
+	handles.reserve(diiCount * TEXT_FIELD_COUNT);
+
+	test::Stopwatch stopwatch;
+	for (int dii = 0; dii < diiCount; ++dii) {
+		for (int field = 0; field < TEXT_FIELD_COUNT; ++field) {
+			const auto content = getFieldContent(dii, field);
+			unpooledBytes += StringPool::getUnpooledByteSize(content);
+			handles.push_back(pool.intern(content));
+		}
+	}
+	test::report("intern 20k DIIs x 25 text fields", handles.size(), stopwatch.getSeconds(), "strings");
+
+	const size_t pooledBytes = handles.size() * sizeof(StringPool::Handle) + pool.getByteSize();
+	std::printf("  text field memory of %d DIIs: std::string members %zu bytes, pooled %zu bytes (%zu distinct strings), %.1f%%\n",
+		diiCount, unpooledBytes, pooledBytes, pool.getSize(), 100.0 * pooledBytes / unpooledBytes);
+}
+
+BENCHMARK(stringPoolCopyCost)
+{
+	const int diiCount = 20000;
+	StringPool pool;
+	std::vector<std::vector<std::string>> strings(diiCount);
+	std::vector<std::vector<StringPool::Handle>> handles(diiCount);
+
+	for (int dii = 0; dii < diiCount; ++dii) {
+		for (int field = 0; field < TEXT_FIELD_COUNT; ++field) {
+			strings[dii].push_back(getFieldContent(dii, field));
+			handles[dii].push_back(pool.intern(strings[dii].back()));
+		}
+	}
+
+	size_t checksum = 0;
+	{
+		test::Stopwatch stopwatch;
+		for (const auto& fields : strings) {
+			std::vector<std::string> copy(fields);
+			checksum += copy[1].size();
+		}
+		test::report("copy 20k DIIs (std::string fields)", diiCount, stopwatch.getSeconds(), "DIIs");
+	}
+
+	{
+		test::Stopwatch stopwatch;
+		for (const auto& fields : handles) {
+			std::vector<StringPool::Handle> copy(fields);
+			checksum += copy[1];
+		}
+		test::report("copy 20k DIIs (pooled handles)", diiCount, stopwatch.getSeconds(), "DIIs");
+	}
+
+	CHECK(checksum != 0);
+}
@@ -0,0 +1,126 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+
+/**
+ * A minimal test and benchmark harness for the parts of neclib that don't depend on the engine or on Windows.
+ * Tests are registered with TEST_CASE and run by default; benchmarks are registered with BENCHMARK and run with
+ * the "--bench" argument (see main.cpp).
+ */
+namespace test {
+
+	struct Failure {
+		std::string message;
+	};
+
+	struct Case {
+		const char* name;
+		void(*function)();
+		bool benchmark;
+	};
+
+	inline std::vector<Case>& getCases()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	struct Registration {
+		Registration(const char* name, void(*function)(), bool benchmark)
+		{
+			getCases().push_back({ name, function, benchmark });
+		}
+	};
+
+	inline void fail(const char* file, int line, const std::string& expression)
+	{
+		std::stringstream ss;
+		ss << file << ":" << line << ": check failed: " << expression;
+		throw Failure{ ss.str() };
+	}
+
+	/**
+	 * Measures the wall clock time of a benchmark section.
+	 */
+	class Stopwatch {
+	public:
+		Stopwatch() : mStart(std::chrono::steady_clock::now()) {}
+
+		double getSeconds() const
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+		}
+
+	private:
+		std::chrono::steady_clock::time_point mStart;
+	};
+
+	/**
+	 * Prints a benchmark result line: the name, the elapsed time and the resulting rate.
+	 */
+	inline void report(const char* name, size_t operations, double seconds, const char* unit = "ops")
+	{
+		std::printf("  %-48s %10.3f ms %14.0f %s/s\n", name, seconds * 1000.0, operations / seconds, unit);
+	}
+}
+
+#define TEST_REGISTER(name, benchmark) \
+	static void name(); \
+	static test::Registration name##Registration(#name, &name, benchmark); \
+	static void name()
+
+#define TEST_CASE(name) TEST_REGISTER(name, false)
+#define BENCHMARK(name) TEST_REGISTER(name, true)
+
+#define CHECK(expression) \
+	do { if (!(expression)) test::fail(__FILE__, __LINE__, #expression); } while (false)
+
+#define CHECK_EQUAL(expected, actual) \
+	do { \
+		const auto& checkExpected = (expected); \
+		const auto& checkActual = (actual); \
+		if (!(checkExpected == checkActual)) { \
+			std::stringstream checkStream; \
+			checkStream << #actual << " == " << checkActual << ", expected " << checkExpected; \
+			test::fail(__FILE__, __LINE__, checkStream.str()); \
+		} \
+	} while (false)
+
+#define CHECK_THROWS(expression) \
+	do { \
+		bool checkThrown = false; \
+		try { expression; } catch (const std::exception&) { checkThrown = true; } \
+		if (!checkThrown) test::fail(__FILE__, __LINE__, "expected exception: " #expression); \
+	} while (false)
@@ -0,0 +1,173 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <UserDataArena.h>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+	// DII_USER_DATA_INTEGER_AMOUNT = 4 and DII_USER_DATA_STRING_AMOUNT = 2 with 20 byte zSTRINGs
+	const size_t BLOCK_SIZE = 4 * sizeof(int) + 2 * 20;
+
+	bool isZeroed(const void* block, size_t size)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(block);
+		for (size_t i = 0; i < size; ++i) {
+			if (bytes[i] != 0) return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE(userDataArenaProvidesZeroedBlocks)
+{
+	UserDataArena arena;
+	void* a = arena.allocate(BLOCK_SIZE);
+	void* b = arena.allocate(BLOCK_SIZE);
+
+	CHECK(a != b);
+	CHECK(isZeroed(a, BLOCK_SIZE));
+	CHECK(isZeroed(b, BLOCK_SIZE));
+	CHECK_EQUAL(size_t(2), arena.getAllocatedBlockCount());
+
+	// a released block is zeroed again when it is reused
+	std::memset(a, 0xAB, BLOCK_SIZE);
+	arena.deallocate(a, BLOCK_SIZE);
+	void* c = arena.allocate(BLOCK_SIZE);
+	CHECK_EQUAL(a, c);
+	CHECK(isZeroed(c, BLOCK_SIZE));
+}
+
+TEST_CASE(userDataArenaReusesReleasedBlocks)
+{
+	UserDataArena arena;
+	std::vector<void*> blocks;
+	for (int i = 0; i < 1000; ++i) {
+		blocks.push_back(arena.allocate(BLOCK_SIZE));
+	}
+	const auto byteSize = arena.getByteSize();
+	CHECK(byteSize >= 1000 * BLOCK_SIZE);
+
+	for (auto* block : blocks) {
+		arena.deallocate(block, BLOCK_SIZE);
+	}
+	CHECK_EQUAL(size_t(0), arena.getAllocatedBlockCount());
+
+	for (int i = 0; i < 1000; ++i) {
+		arena.allocate(BLOCK_SIZE);
+	}
+	CHECK_EQUAL(byteSize, arena.getByteSize());
+	CHECK_EQUAL(size_t(1000), arena.getAllocatedBlockCount());
+}
+
+TEST_CASE(userDataArenaSeparatesSizeClasses)
+{
+	UserDataArena arena;
+	void* small = arena.allocate(1);
+	void* large = arena.allocate(BLOCK_SIZE);
+	void* huge = arena.allocate(UserDataArena::CHUNK_BYTE_SIZE * 2);
+
+	CHECK(isZeroed(huge, UserDataArena::CHUNK_BYTE_SIZE * 2));
+	CHECK_EQUAL(size_t(3), arena.getAllocatedBlockCount());
+	// a chunk each for the two small classes (rounded down to whole blocks) and one for the huge block
+	CHECK(arena.getByteSize() > UserDataArena::CHUNK_BYTE_SIZE * 3);
+
+	// a released small block mustn't be handed out for a larger size
+	arena.deallocate(small, 1);
+	void* other = arena.allocate(BLOCK_SIZE);
+	CHECK(other != small);
+	CHECK(other != large);
+
+	arena.deallocate(nullptr, BLOCK_SIZE);
+	CHECK_EQUAL(size_t(3), arena.getAllocatedBlockCount());
+}
+
+TEST_CASE(userDataArenaTrimFreesUnusedSizeClasses)
+{
+	UserDataArena arena;
+	void* kept = arena.allocate(BLOCK_SIZE);
+	void* released = arena.allocate(UserDataArena::CHUNK_BYTE_SIZE * 2);
+	const auto keptClassSize = UserDataArena::CHUNK_BYTE_SIZE / BLOCK_SIZE * BLOCK_SIZE;
+
+	arena.deallocate(released, UserDataArena::CHUNK_BYTE_SIZE * 2);
+	arena.trim();
+
+	CHECK_EQUAL(keptClassSize, arena.getByteSize());
+	CHECK_EQUAL(size_t(1), arena.getAllocatedBlockCount());
+
+	arena.deallocate(kept, BLOCK_SIZE);
+	arena.trim();
+	CHECK_EQUAL(size_t(0), arena.getByteSize());
+}
+
+BENCHMARK(userDataArenaChurn)
+{
+	const int blockCount = 20000;
+	const int rounds = 20;
+	std::vector<void*> blocks(blockCount);
+
+	// previous path: the engine's operator new (a malloc) followed by a memset per block
+	{
+		test::Stopwatch stopwatch;
+		for (auto& block : blocks) {
+			block = std::malloc(BLOCK_SIZE);
+			std::memset(block, 0, BLOCK_SIZE);
+		}
+		for (int round = 0; round < rounds; ++round) {
+			for (int i = round % 2; i < blockCount; i += 2) {
+				std::free(blocks[i]);
+				blocks[i] = std::malloc(BLOCK_SIZE);
+				std::memset(blocks[i], 0, BLOCK_SIZE);
+			}
+		}
+		for (auto* block : blocks) std::free(block);
+		test::report("churn 20k user data blocks via malloc", blockCount / 2 * rounds + blockCount,
+			stopwatch.getSeconds(), "blocks");
+	}
+
+	{
+		UserDataArena arena;
+		test::Stopwatch stopwatch;
+		for (auto& block : blocks) {
+			block = arena.allocate(BLOCK_SIZE);
+		}
+		for (int round = 0; round < rounds; ++round) {
+			for (int i = round % 2; i < blockCount; i += 2) {
+				arena.deallocate(blocks[i], BLOCK_SIZE);
+				blocks[i] = arena.allocate(BLOCK_SIZE);
+			}
+		}
+		const auto seconds = stopwatch.getSeconds();
+		test::report("churn 20k user data blocks via arena", blockCount / 2 * rounds + blockCount, seconds, "blocks");
+		std::printf("  arena: %zu bytes in chunks for %zu blocks of %zu bytes\n", arena.getByteSize(),
+			arena.getAllocatedBlockCount(), BLOCK_SIZE);
+		CHECK_EQUAL(size_t(blockCount), arena.getAllocatedBlockCount());
+	}
+}
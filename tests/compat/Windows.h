@@ -0,0 +1,151 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <pthread.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+
+/**
+ * Stand-ins for the parts of the Win32 API used by the engine independent sources (e.g. LogWriter.cpp), so that
+ * they build on Linux. Threads are pthreads; module references are only counted, which allows tests to check
+ * that each reference is released.
+ */
+
+typedef void* HANDLE;
+typedef void* HMODULE;
+typedef const char* LPCTSTR;
+typedef unsigned long DWORD;
+typedef int BOOL;
+
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS 0x4
+
+namespace compat {
+
+	struct Thread {
+		unsigned long(*start)(void*);
+		void* param;
+		std::atomic<bool> finished{ false };
+
+		// the handle and the running thread
+		std::atomic<int> references{ 2 };
+	};
+
+	inline std::atomic<int>& getModuleReferences()
+	{
+		static std::atomic<int> references{ 0 };
+		return references;
+	}
+
+	inline Thread*& getCurrentThread()
+	{
+		static thread_local Thread* thread = nullptr;
+		return thread;
+	}
+
+	inline void releaseThread(Thread* thread)
+	{
+		if (--thread->references == 0) delete thread;
+	}
+
+	inline void finishThread()
+	{
+		auto* thread = getCurrentThread();
+		if (!thread) return;
+
+		getCurrentThread() = nullptr;
+		thread->finished = true;
+		releaseThread(thread);
+	}
+
+	inline void* threadMain(void* param)
+	{
+		auto* thread = static_cast<Thread*>(param);
+		getCurrentThread() = thread;
+		thread->start(thread->param);
+		finishThread();
+		return nullptr;
+	}
+}
+
+inline HANDLE CreateThread(void*, size_t, unsigned long(*start)(void*), void* param, DWORD, DWORD*)
+{
+	auto* thread = new compat::Thread();
+	thread->start = start;
+	thread->param = param;
+
+	pthread_t id;
+	if (pthread_create(&id, nullptr, &compat::threadMain, thread) != 0) {
+		delete thread;
+		return nullptr;
+	}
+
+	pthread_detach(id);
+	return thread;
+}
+
+inline DWORD WaitForSingleObject(HANDLE handle, DWORD)
+{
+	return static_cast<compat::Thread*>(handle)->finished ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+}
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+	compat::releaseThread(static_cast<compat::Thread*>(handle));
+	return 1;
+}
+
+inline BOOL GetModuleHandleEx(DWORD, LPCTSTR, HMODULE* module)
+{
+	++compat::getModuleReferences();
+	*module = &compat::getModuleReferences();
+	return 1;
+}
+
+inline BOOL FreeLibrary(HMODULE)
+{
+	--compat::getModuleReferences();
+	return 1;
+}
+
+inline void FreeLibraryAndExitThread(HMODULE module, DWORD)
+{
+	FreeLibrary(module);
+	compat::finishThread();
+	pthread_exit(nullptr);
+}
+
+inline int fopen_s(FILE** file, const char* path, const char* mode)
+{
+	*file = fopen(path, mode);
+	return *file ? 0 : errno;
+}
@@ -0,0 +1,58 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#pragma once
+
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+
+/**
+ * Stand-ins for the MSVC low level I/O functions (see Windows.h). Commits are counted, so that tests can check
+ * the flush policies.
+ */
+
+namespace compat {
+
+	inline std::atomic<int>& getCommitCount()
+	{
+		static std::atomic<int> count{ 0 };
+		return count;
+	}
+}
+
+inline int _fileno(FILE* file)
+{
+	return fileno(file);
+}
+
+inline int _commit(int fd)
+{
+	++compat::getCommitCount();
+	return fsync(fd);
+}
@@ -0,0 +1,74 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <iostream>
+#include <cstring>
+#include <exception>
+
+/**
+ * Usage: neclib-tests [--bench] [name filter]
+ * Runs all tests (or all benchmarks with --bench) whose name contains the filter.
+ */
+int main(int argc, char** argv)
+{
+	bool benchmarks = false;
+	const char* filter = "";
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--bench") == 0) {
+			benchmarks = true;
+		}
+		else {
+			filter = argv[i];
+		}
+	}
+
+	int run = 0;
+	int failed = 0;
+	for (const auto& testCase : test::getCases()) {
+		if (testCase.benchmark != benchmarks || !std::strstr(testCase.name, filter)) continue;
+
+		std::cout << (benchmarks ? "[ BENCH ] " : "[ RUN   ] ") << testCase.name << std::endl;
+		++run;
+
+		try {
+			testCase.function();
+		}
+		catch (const test::Failure& failure) {
+			std::cout << "[ FAIL  ] " << failure.message << std::endl;
+			++failed;
+		}
+		catch (const std::exception& e) {
+			std::cout << "[ FAIL  ] " << testCase.name << ": unexpected exception: " << e.what() << std::endl;
+			++failed;
+		}
+	}
+
+	std::cout << run - failed << " of " << run << (benchmarks ? " benchmarks" : " tests") << " passed" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
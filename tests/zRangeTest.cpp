@@ -0,0 +1,243 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+#include "Test.h"
+#include <api/g2/zrange.h>
+#include <list>
+#include <memory>
+
+/**
+ * Stand-ins with the memory layout of the engine containers in ztypes.h; zrange.h only needs
+ * the data/next members of the list nodes and begin()/end() of the array.
+ */
+template<class T>
+class zCList
+{
+public:
+	T* data;
+	zCList<T>* next;
+};
+
+template<class T>
+class zCListSort
+{
+public:
+	int(*compare)(T* ele1, T* ele2);
+	T* data;
+	zCListSort<T>* next;
+};
+
+template<class T>
+class zCArray
+{
+public:
+	T* m_array;
+	int m_numAlloc;
+	int m_numInArray;
+
+	T* begin() { return m_array; }
+	T* end() { return m_array + m_numInArray; }
+};
+
+namespace {
+
+	struct Item {
+		int instance;
+		int amount;
+	};
+
+	/**
+	 * Builds an engine style list: a head node without data followed by a node per item.
+	 * Null entries become nodes without data.
+	 */
+	template<class Node>
+	class SyntheticList
+	{
+	public:
+		explicit SyntheticList(std::vector<Item*> items)
+		{
+			nodes.resize(items.size() + 1);
+			for (size_t i = 0; i < nodes.size(); ++i) {
+				nodes[i].data = i == 0 ? nullptr : items[i - 1];
+				nodes[i].next = i + 1 < nodes.size() ? &nodes[i + 1] : nullptr;
+			}
+		}
+
+		Node* getHead() { return &nodes[0]; }
+
+	private:
+		std::vector<Node> nodes;
+	};
+
+	std::vector<Item> createItems(int count)
+	{
+		std::vector<Item> items(count);
+		for (int i = 0; i < count; ++i) {
+			items[i].instance = i;
+			items[i].amount = i % 5 + 1;
+		}
+		return items;
+	}
+
+	std::vector<Item*> getPointers(std::vector<Item>& items)
+	{
+		std::vector<Item*> pointers;
+		for (auto& item : items) pointers.push_back(&item);
+		return pointers;
+	}
+}
+
+TEST_CASE(zRangeSkipsTheHeadNodeAndEmptyNodes)
+{
+	auto items = createItems(4);
+	auto pointers = getPointers(items);
+	pointers.insert(pointers.begin() + 2, nullptr);
+	pointers.push_back(nullptr);
+	SyntheticList<zCList<Item>> list(pointers);
+
+	std::vector<int> visited;
+	for (Item* item : zRange(list.getHead())) {
+		visited.push_back(item->instance);
+	}
+
+	CHECK_EQUAL(size_t(4), visited.size());
+	for (int i = 0; i < 4; ++i) {
+		CHECK_EQUAL(i, visited[i]);
+	}
+}
+
+TEST_CASE(zRangeOverEmptyLists)
+{
+	SyntheticList<zCList<Item>> onlyHead(std::vector<Item*>{});
+	SyntheticList<zCListSort<Item>> onlyEmptyNodes(std::vector<Item*>{ nullptr, nullptr });
+
+	auto range = zRange(onlyHead.getHead());
+	CHECK(range.begin() == range.end());
+	CHECK(zSnapshot(onlyEmptyNodes.getHead()).empty());
+	CHECK(zSnapshot(static_cast<zCList<Item>*>(nullptr)).empty());
+}
+
+TEST_CASE(zRangeOverSortedLists)
+{
+	auto items = createItems(3);
+	SyntheticList<zCListSort<Item>> list(getPointers(items));
+
+	auto it = zRange(list.getHead()).begin();
+	CHECK_EQUAL(&items[0], *it);
+	CHECK_EQUAL(&items[0], *it++);
+	CHECK_EQUAL(&items[1], *it);
+	++it;
+	CHECK_EQUAL(&items[2], *it);
+	CHECK(++it == zRange(list.getHead()).end());
+}
+
+TEST_CASE(zRangeOverArrays)
+{
+	auto items = createItems(3);
+	auto pointers = getPointers(items);
+	zCArray<Item*> array;
+	array.m_array = pointers.data();
+	array.m_numAlloc = static_cast<int>(pointers.capacity());
+	array.m_numInArray = 2;
+
+	int sum = 0;
+	for (Item* item : zRange(array)) {
+		sum += item->amount;
+	}
+	CHECK_EQUAL(items[0].amount + items[1].amount, sum);
+
+	const auto snapshot = zSnapshot(array);
+	CHECK_EQUAL(size_t(2), snapshot.size());
+	CHECK_EQUAL(&items[1], snapshot[1]);
+}
+
+TEST_CASE(zSnapshotSurvivesModifyingTheList)
+{
+	auto items = createItems(3);
+	SyntheticList<zCList<Item>> list(getPointers(items));
+
+	const auto snapshot = zSnapshot(list.getHead());
+
+	// unlink the second node as the engine does when an item is removed from the world
+	list.getHead()->next->next = list.getHead()->next->next->next;
+
+	CHECK_EQUAL(size_t(3), snapshot.size());
+	CHECK_EQUAL(&items[1], snapshot[1]);
+
+	size_t count = 0;
+	for (Item* item : zRange(list.getHead())) {
+		CHECK(item != &items[1]);
+		++count;
+	}
+	CHECK_EQUAL(size_t(2), count);
+}
+
+BENCHMARK(zRangeVersusListCopy)
+{
+	const int itemCount = 10000;
+	const int sweeps = 200;
+	auto items = createItems(itemCount);
+	SyntheticList<zCList<Item>> list(getPointers(items));
+	long long expected = 0;
+	for (const auto& item : items) expected += item.amount;
+
+	// previous util::create(): copies the engine list into a heap allocated std::list per sweep
+	{
+		long long sum = 0;
+		test::Stopwatch stopwatch;
+		for (int sweep = 0; sweep < sweeps; ++sweep) {
+			std::unique_ptr<std::list<Item*>> copy(new std::list<Item*>());
+			for (auto* node = list.getHead(); node; node = node->next) {
+				if (node->data) copy->push_back(node->data);
+			}
+			for (Item* item : *copy) sum += item->amount;
+		}
+		test::report("sweep 10k items via std::list copy", sweeps, stopwatch.getSeconds(), "sweeps");
+		CHECK_EQUAL(expected * sweeps, sum);
+	}
+
+	{
+		long long sum = 0;
+		test::Stopwatch stopwatch;
+		for (int sweep = 0; sweep < sweeps; ++sweep) {
+			for (Item* item : zRange(list.getHead())) sum += item->amount;
+		}
+		test::report("sweep 10k items via zRange", sweeps, stopwatch.getSeconds(), "sweeps");
+		CHECK_EQUAL(expected * sweeps, sum);
+	}
+
+	{
+		long long sum = 0;
+		test::Stopwatch stopwatch;
+		for (int sweep = 0; sweep < sweeps; ++sweep) {
+			for (Item* item : zSnapshot(list.getHead())) sum += item->amount;
+		}
+		test::report("sweep 10k items via zSnapshot", sweeps, stopwatch.getSeconds(), "sweeps");
+		CHECK_EQUAL(expected * sweeps, sum);
+	}
+}
@@ -0,0 +1,152 @@
+/*////////////////////////////////////////////////////////////////////////////
+
+This file is part of neclib.
+
+Copyright  2015-2020 David Goeth
+
+All Rights reserved.
+
+THE WORK (AS DEFINED BELOW) IS PROVIDED
+UNDER THE TERMS OF THIS CREATIVE COMMONS
+PUBLIC LICENSE ("CCPL" OR "LICENSE").
+THE WORK IS PROTECTED BY COPYRIGHT AND/OR
+OTHER APPLICABLE LAW. ANY USE OF THE WORK
+OTHER THAN AS AUTHORIZED UNDER THIS LICENSE
+OR COPYRIGHT LAW IS PROHIBITED.
+
+BY EXERCISING ANY RIGHTS TO THE WORK PROVIDED
+HERE, YOU ACCEPT AND AGREE TO BE BOUND BY THE
+TERMS OF THIS LICENSE. TO THE EXTENT THIS
+LICENSE MAY BE CONSIDERED TO BE A CONTRACT,
+THE LICENSOR GRANTS YOU THE RIGHTS CONTAINED
+HERE IN CONSIDERATION OF YOUR ACCEPTANCE OF
+SUCH TERMS AND CONDITIONS.
+
+Full license at http://creativecommons.org/licenses/by-nc/3.0/legalcode
+
+/////////////////////////////////////////////////////////////////////////////**/
+
+/**
+ * Converts a binary neclib log file (LOGGING.logBinary = true in neclib.ini) into the text format of the
+ * text log files.
+ *
+ * Build (Linux, from the repository root):
+ *   g++ -std=c++14 -O2 -IInc -o neclib-logdecoder tools/LogDecoder/LogDecoder.cpp
+ *
+ * Usage: neclib-logdecoder <binary log file> [text output file]
+ * Without an output file, the text is written to stdout.
+ */
+
+#include <LogFormat.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+static bool decode(const std::vector<char>& content, std::ostream& out)
+{
+	const char* current = content.data();
+	const char* end = current + content.size();
+
+	LogFormat::FILE_HEADER header;
+	const LogFormat::FILE_HEADER expected;
+	if (!LogFormat::readRaw(current, end, header)
+		|| std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+		std::cerr << "Not a binary neclib log file" << std::endl;
+		return false;
+	}
+
+	if (header.version != expected.version) {
+		std::cerr << "Unsupported log version " << header.version << std::endl;
+		return false;
+	}
+
+	// <format id, format>
+	std::unordered_map<uint32_t, std::string> formats;
+	formats[LogFormat::TEXT_FORMAT_ID] = "{}";
+
+	std::string message;
+	char wallClock[LogFormat::WALL_CLOCK_SIZE];
+
+	while (current != end) {
+		uint8_t type;
+		LogFormat::readRaw(current, end, type);
+
+		if (type == LogFormat::FORMAT) {
+			uint32_t id, length;
+			if (!LogFormat::readRaw(current, end, id) || !LogFormat::readRaw(current, end, length)
+				|| static_cast<size_t>(end - current) < length) {
+				break;
+			}
+
+			formats[id].assign(current, length);
+			current += length;
+		}
+		else if (type == LogFormat::MESSAGE) {
+			uint8_t level;
+			uint32_t secondsOfDay, id, size;
+			uint64_t microseconds;
+			if (!LogFormat::readRaw(current, end, level) || !LogFormat::readRaw(current, end, secondsOfDay)
+				|| !LogFormat::readRaw(current, end, microseconds)
+				|| !LogFormat::readRaw(current, end, id) || !LogFormat::readRaw(current, end, size)
+				|| static_cast<size_t>(end - current) < size) {
+				break;
+			}
+
+			auto it = formats.find(id);
+			LogFormat::formatWallClock(secondsOfDay, wallClock, sizeof(wallClock));
+			message.clear();
+			LogFormat::appendPrefix(message, wallClock, level, microseconds);
+			if (it == formats.end()) {
+				message += "<unknown format " + std::to_string(id) + ">\n";
+			}
+			else if (!LogFormat::format(it->second, current, size, message)) {
+				message += "<malformed arguments>\n";
+			}
+
+			out << message;
+			current += size;
+		}
+		else {
+			std::cerr << "Unknown record type " << static_cast<int>(type) << " at offset "
+				<< (current - 1 - content.data()) << std::endl;
+			return false;
+		}
+	}
+
+	if (current != end) {
+		// the game was terminated while writing the last record
+		std::cerr << "Truncated record at the end of the log" << std::endl;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3) {
+		std::cerr << "Usage: " << argv[0] << " <binary log file> [text output file]" << std::endl;
+		return 2;
+	}
+
+	std::ifstream in(argv[1], std::ios::binary);
+	if (!in) {
+		std::cerr << "Couldn't open " << argv[1] << std::endl;
+		return 1;
+	}
+
+	std::vector<char> content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	if (argc == 3) {
+		std::ofstream out(argv[2], std::ios::binary);
+		if (!out) {
+			std::cerr << "Couldn't open " << argv[2] << std::endl;
+			return 1;
+		}
+
+		return decode(content, out) ? 0 : 1;
+	}
+
+	return decode(content, std::cout) ? 0 : 1;
+}